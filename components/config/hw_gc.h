@@ -53,6 +53,8 @@
 #define HW_LCD_OFFSETX 0
 #define HW_LCD_OFFSETY 0
 
+#define HW_LCD_SCROLL_LINES 240 // panel memory rows for hardware scroll, 0 if none
+
 #define HW_LCD_DRIVER 0
 
 //---------- SD card ----------//
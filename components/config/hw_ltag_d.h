@@ -47,6 +47,8 @@
 #define HW_LCD_OFFSETX 0
 #define HW_LCD_OFFSETY 0
 
+#define HW_LCD_SCROLL_LINES 320 // panel memory rows for hardware scroll, 0 if none
+
 #define HW_LCD_DRIVER 1
 
 //---------- Laser tag ----------//
@@ -1,6 +1,7 @@
 
 #include <stdlib.h> // abs
 
+#include "fixmath.h"
 #include "joy.h"
 #include "cursor.h"
 
@@ -9,9 +10,9 @@
 #define CLIP(x,lo,hi) ((x) < (lo) ? (lo) : ((x) > (hi) ? (hi) : (x)))
 
 static uint32_t uperiod; // Update period in milliseconds.
-static float sfactor; // Joystick sensitivity factor.
+static q16_t sfactor; // Joystick sensitivity factor.
 static uint32_t thresh; // Joystick displacement threshold.
-static float xpos, ypos; // Current cursor position as a float.
+static q16_t xpos, ypos; // Current cursor position in Q16.16.
 
 
 // Initialize the cursor. Must be called before use.
@@ -27,8 +28,8 @@ int32_t cursor_init(uint32_t per)
 	cursor_set_sensitivity(SEN_DEFAULT);
 	cursor_set_threshold(THRESH_DEFAULT);
 	// Initialize the cursor position to the center of the screen.
-	xpos = LCD_W/2;
-	ypos = LCD_H/2;
+	xpos = q16_from_int(LCD_W/2);
+	ypos = q16_from_int(LCD_H/2);
 	return 0;
 }
 
@@ -49,8 +50,8 @@ void cursor_tick(void)
 	ypos += dcy*sfactor;
 
 	// Clip new position to screen.
-	xpos = CLIP(xpos, 0, LCD_W-1);
-	ypos = CLIP(ypos, 0, LCD_H-1);
+	xpos = CLIP(xpos, 0, q16_from_int(LCD_W-1));
+	ypos = CLIP(ypos, 0, q16_from_int(LCD_H-1));
 }
 
 // Set the sensitivity (speed) of the cursor relative to joystick movement.
@@ -60,7 +61,7 @@ void cursor_tick(void)
 void cursor_set_sensitivity(float sens)
 {
 	float rate = sens*LCD_W; // Convert to pixels per second
-	sfactor = ((rate < 1.0f) ? 1.0f : rate) / JOY_MAX_DISP * uperiod / 1000;
+	sfactor = Q16(((rate < 1.0f) ? 1.0f : rate) / JOY_MAX_DISP * uperiod / 1000);
 }
 
 // Set the threshold of joystick displacement needed before moving the cursor.
@@ -79,8 +80,8 @@ void cursor_set_threshold(float thr)
 // *y: pointer to y coordinate.
 void cursor_get_pos(coord_t *x, coord_t *y)
 {
-	*x = xpos+0.5f;
-	*y = ypos+0.5f;
+	*x = q16_round(xpos);
+	*y = q16_round(ypos);
 }
 
 // Set the cursor position in screen coordinates.
@@ -90,6 +91,6 @@ void cursor_get_pos(coord_t *x, coord_t *y)
 void cursor_set_pos(coord_t x, coord_t y)
 {
 	// Clip new position to screen.
-	xpos = CLIP(x, 0, LCD_W-1);
-	ypos = CLIP(y, 0, LCD_H-1);
+	xpos = q16_from_int(CLIP(x, 0, LCD_W-1));
+	ypos = q16_from_int(CLIP(y, 0, LCD_H-1));
 }
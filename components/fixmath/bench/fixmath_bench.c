@@ -0,0 +1,142 @@
+// Host benchmark: compares fixmath with libm. For each function it prints
+// the largest error over its input range and the time per call of both
+// versions as CSV. Exits non-zero if an error exceeds its limit.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+
+#include "fixmath.h"
+
+#define CALLS 10000000 // per throughput measurement
+#define TRIG_LIMIT 2.0 // LSB of Q1.15
+#define ROT_LIMIT 0.6 // pixels, rounding plus table error
+
+static volatile int32_t sink; // keeps timed results live
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+static void row(const char *name, double err, double limit, double fx_ns, double libm_ns)
+{
+	printf("%s,%.3f,%.3f,%.2f,%.2f\n", name, err, limit, fx_ns, libm_ns);
+}
+
+// Sine and cosine over every binary angle, error in Q1.15 LSB.
+static bool bench_trig(void)
+{
+	double es = 0, ec = 0;
+	for (uint32_t a = 0; a < 65536; a++) {
+		double r = a*(2*M_PI/65536);
+		double ds = fabs(fx_sin(a) - sin(r)*32768);
+		double dc = fabs(fx_cos(a) - cos(r)*32768);
+		if (ds > es) es = ds;
+		if (dc > ec) ec = dc;
+	}
+
+	int64_t t0 = now_ns();
+	int32_t acc = 0;
+	for (uint32_t i = 0; i < CALLS; i++) acc += fx_sin(i*40503);
+	int64_t t1 = now_ns();
+	float facc = 0;
+	for (uint32_t i = 0; i < CALLS; i++) facc += sinf((i*40503 & 0xFFFF)*(2*(float)M_PI/65536));
+	int64_t t2 = now_ns();
+	for (uint32_t i = 0; i < CALLS; i++) acc += fx_cos(i*40503);
+	int64_t t3 = now_ns();
+	for (uint32_t i = 0; i < CALLS; i++) facc += cosf((i*40503 & 0xFFFF)*(2*(float)M_PI/65536));
+	int64_t t4 = now_ns();
+	sink = acc + (int32_t)facc;
+
+	row("sin", es, TRIG_LIMIT, (double)(t1-t0)/CALLS, (double)(t2-t1)/CALLS);
+	row("cos", ec, TRIG_LIMIT, (double)(t3-t2)/CALLS, (double)(t4-t3)/CALLS);
+	return es <= TRIG_LIMIT && ec <= TRIG_LIMIT;
+}
+
+// Square root of random 48-bit values and of every value near a square,
+// which must be exact.
+static bool bench_isqrt(void)
+{
+	uint64_t x = 88172645463325252ULL;
+	uint32_t bad = 0;
+	for (uint32_t i = 0; i < 1000000; i++) {
+		x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+		uint64_t n = x >> 16;
+		uint64_t r = fx_isqrt(n);
+		if (r*r > n || (r+1)*(r+1) <= n) bad++;
+	}
+	for (uint64_t r = 1; r < 100000; r++) {
+		if (fx_isqrt(r*r) != r || fx_isqrt(r*r-1) != r-1) bad++;
+	}
+
+	int64_t t0 = now_ns();
+	uint32_t acc = 0;
+	for (uint32_t i = 0; i < CALLS; i++) acc += fx_isqrt((uint64_t)i*i*7);
+	int64_t t1 = now_ns();
+	float facc = 0;
+	for (uint32_t i = 0; i < CALLS; i++) facc += sqrtf((float)i*i*7);
+	int64_t t2 = now_ns();
+	sink = acc + (int32_t)facc;
+
+	row("isqrt", bad, 0, (double)(t1-t0)/CALLS, (double)(t2-t1)/CALLS);
+	return bad == 0;
+}
+
+// Rotation of screen-sized points by integer degrees, error in pixels.
+static bool bench_rotate(void)
+{
+	double err = 0;
+	for (int32_t deg = -360; deg <= 360; deg += 7) {
+		fx_angle_t a = fx_deg(deg);
+		q15_t c = fx_cos(a), s = fx_sin(a);
+		double rd = deg*M_PI/180;
+		for (int32_t x = -160; x <= 160; x += 5) {
+			for (int32_t y = -120; y <= 120; y += 5) {
+				int32_t xr, yr;
+				fx_rotate(x, y, c, s, &xr, &yr);
+				double ex = fabs(xr - (x*cos(rd) - y*sin(rd)));
+				double ey = fabs(yr - (x*sin(rd) + y*cos(rd)));
+				if (ex > err) err = ex;
+				if (ey > err) err = ey;
+			}
+		}
+	}
+
+	int64_t t0 = now_ns();
+	int32_t acc = 0;
+	for (uint32_t i = 0; i < CALLS; i++) {
+		int32_t xr, yr;
+		fx_angle_t a = fx_deg(i % 360);
+		fx_rotate(i & 0xFF, 100, fx_cos(a), fx_sin(a), &xr, &yr);
+		acc += xr + yr;
+	}
+	int64_t t1 = now_ns();
+	float facc = 0;
+	for (uint32_t i = 0; i < CALLS; i++) {
+		float rd = (i % 360) * (float)M_PI / 180.0f;
+		float xd = i & 0xFF, yd = 100;
+		facc += (xd*cosf(rd) - yd*sinf(rd)) + (xd*sinf(rd) + yd*cosf(rd));
+	}
+	int64_t t2 = now_ns();
+	sink = acc + (int32_t)facc;
+
+	row("rotate", err, ROT_LIMIT, (double)(t1-t0)/CALLS, (double)(t2-t1)/CALLS);
+	return err <= ROT_LIMIT;
+}
+
+int main(void)
+{
+	bool ok = true;
+
+	printf("function,max_error,limit,fx_ns,libm_ns\n");
+	ok &= bench_trig();
+	ok &= bench_isqrt();
+	ok &= bench_rotate();
+	return ok ? 0 : 1;
+}
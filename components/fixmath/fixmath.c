@@ -0,0 +1,64 @@
+// Fixed-point trigonometry and integer square root.
+
+#include "fixmath.h"
+
+#define TABLE_BITS 8 // quarter wave intervals, log2
+#define FRAC_BITS (14-TABLE_BITS) // angle bits interpolated between entries
+
+// The quarter wave table is evaluated by the compiler: entry i is
+// sin(i*pi/2/256) in Q1.15 from a Taylor series to x^15, which is exact to
+// well below one LSB. Entry 256 is 1.0 (32768), so the table is unsigned.
+#define TX(i) ((i)*(1.5707963267948966/(1 << TABLE_BITS)))
+#define TX2(i) (TX(i)*TX(i))
+#define TSIN(i) (TX(i)*(1-TX2(i)/6*(1-TX2(i)/20*(1-TX2(i)/42*(1-TX2(i)/72* \
+	(1-TX2(i)/110*(1-TX2(i)/156*(1-TX2(i)/210))))))))
+#define T1(i) (uint16_t)(TSIN(i)*32768+0.5),
+#define T4(i) T1(i) T1((i)+1) T1((i)+2) T1((i)+3)
+#define T16(i) T4(i) T4((i)+4) T4((i)+8) T4((i)+12)
+#define T64(i) T16(i) T16((i)+16) T16((i)+32) T16((i)+48)
+#define T256(i) T64(i) T64((i)+64) T64((i)+128) T64((i)+192)
+
+static const uint16_t sin_table[(1 << TABLE_BITS)+1] = {
+	T256(0) T1(256)
+};
+
+fx_angle_t fx_deg(int32_t deg)
+{
+	deg %= 360;
+	if (deg < 0) deg += 360;
+	return (fx_angle_t)((deg*65536 + 180)/360);
+}
+
+q15_t fx_sin(fx_angle_t a)
+{
+	uint32_t i = a & (FX_QUARTER-1);
+	if (a & FX_QUARTER) i = FX_QUARTER - i; // second and fourth quarters mirror
+	uint32_t k = i >> FRAC_BITS, f = i & ((1 << FRAC_BITS)-1);
+	int32_t s = sin_table[k];
+	if (f) s += ((sin_table[k+1]-s)*(int32_t)f + (1 << (FRAC_BITS-1))) >> FRAC_BITS;
+	if (s > Q15_ONE) s = Q15_ONE;
+	return (a & 0x8000) ? -s : s;
+}
+
+q15_t fx_cos(fx_angle_t a)
+{
+	return fx_sin(a + FX_QUARTER);
+}
+
+uint32_t fx_isqrt(uint64_t n)
+{
+	if (n == 0) return 0;
+	// Start from the highest even bit at or below the top set bit.
+	uint64_t r = 0, bit = (uint64_t)1 << ((63-__builtin_clzll(n)) & ~1);
+
+	while (bit) {
+		if (n >= r + bit) {
+			n -= r + bit;
+			r = (r >> 1) + bit;
+		} else {
+			r >>= 1;
+		}
+		bit >>= 2;
+	}
+	return (uint32_t)r;
+}
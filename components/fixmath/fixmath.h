@@ -0,0 +1,93 @@
+#ifndef FIXMATH_H_
+#define FIXMATH_H_
+/**
+ * @file
+ * @brief Fixed-point arithmetic, trigonometry and integer square root.
+ * @details Values are Q16.16 (q16_t) for positions and rates, and Q1.15
+ * (q15_t) for sine and cosine. Angles are binary (fx_angle_t), 65536 per
+ * turn, so they wrap without a modulo. Sine and cosine come from a quarter
+ * wave table generated by the compiler, with linear interpolation. No
+ * floating point is used at run time.
+ */
+
+#include <stdint.h>
+
+/** @brief Signed Q16.16 fixed-point value. */
+typedef int32_t q16_t;
+
+/** @brief Signed Q1.15 fixed-point value, -1 to 1-2^-15. */
+typedef int16_t q15_t;
+
+/** @brief Binary angle, 65536 per turn, counterclockwise. */
+typedef uint16_t fx_angle_t;
+
+#define Q16_ONE  ((q16_t)1 << 16) /**< 1.0 in Q16.16. */
+#define Q16_HALF ((q16_t)1 << 15) /**< 0.5 in Q16.16. */
+#define Q15_ONE  INT16_MAX        /**< Largest Q1.15 value, 1-2^-15. */
+
+/** @brief Convert a constant to Q16.16, rounded to nearest. */
+#define Q16(x) ((q16_t)((x)*65536.0f + (((x) < 0) ? -0.5f : 0.5f)))
+
+/** @brief Quarter turn as a binary angle. */
+#define FX_QUARTER ((fx_angle_t)0x4000)
+
+/** @brief Convert an integer to Q16.16. */
+static inline q16_t q16_from_int(int32_t i) {return i*Q16_ONE;}
+
+/** @brief Convert Q16.16 to an integer, rounding down. */
+static inline int32_t q16_floor(q16_t a) {return a >> 16;}
+
+/** @brief Convert Q16.16 to an integer, rounding to nearest. */
+static inline int32_t q16_round(q16_t a) {return (a + Q16_HALF) >> 16;}
+
+/** @brief Multiply two Q16.16 values. */
+static inline q16_t q16_mul(q16_t a, q16_t b) {return ((int64_t)a*b) >> 16;}
+
+/** @brief Divide two Q16.16 values. b must not be zero. */
+static inline q16_t q16_div(q16_t a, q16_t b) {return ((int64_t)a*Q16_ONE)/b;}
+
+/**
+ * @brief Convert degrees to a binary angle.
+ * @param deg Angle in degrees, any value.
+ * @returns Binary angle, rounded to nearest.
+ */
+fx_angle_t fx_deg(int32_t deg);
+
+/**
+ * @brief Sine of a binary angle.
+ * @param a Angle.
+ * @returns Sine in Q1.15. 1.0 is returned as Q15_ONE.
+ */
+q15_t fx_sin(fx_angle_t a);
+
+/**
+ * @brief Cosine of a binary angle.
+ * @param a Angle.
+ * @returns Cosine in Q1.15. 1.0 is returned as Q15_ONE.
+ */
+q15_t fx_cos(fx_angle_t a);
+
+/**
+ * @brief Integer square root.
+ * @param n Value.
+ * @returns Largest r with r*r <= n.
+ */
+uint32_t fx_isqrt(uint64_t n);
+
+/**
+ * @brief Rotate an integer point about the origin.
+ * @details xr = x*cos - y*sin, yr = x*sin + y*cos, rounded to nearest.
+ * @param x  X coordinate.
+ * @param y  Y coordinate.
+ * @param c  Cosine of the angle from fx_cos().
+ * @param s  Sine of the angle from fx_sin().
+ * @param xr Rotated X coordinate.
+ * @param yr Rotated Y coordinate.
+ */
+static inline void fx_rotate(int32_t x, int32_t y, q15_t c, q15_t s, int32_t *xr, int32_t *yr)
+{
+	*xr = ((int64_t)x*c - (int64_t)y*s + (1 << 14)) >> 15;
+	*yr = ((int64_t)x*s + (int64_t)y*c + (1 << 14)) >> 15;
+}
+
+#endif // FIXMATH_H_
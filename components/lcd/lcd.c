@@ -5,19 +5,25 @@
 //   https://github.com/adafruit/TFTLCD-Library
 //   https://github.com/adafruit/Adafruit_ILI9341
 
+#include <stdlib.h> // abs
 #include <string.h> // strlen, memcpy
-#include <math.h> // cosf, sinf
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 
 #include "driver/spi_master.h"
 #include "driver/gpio.h"
+#include "esp_attr.h"
 #include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
+#include "fixmath.h"
 #include "hw.h"
 #include "lcd.h"
+#include "lcd_pix.h"
+#include "lcd_tile.h"
 
 #define _DEBUG_ 0
 
@@ -35,14 +41,17 @@
 #define LCD_OFFSETX HW_LCD_OFFSETX
 #define LCD_OFFSETY HW_LCD_OFFSETY
 
+#define LCD_SCROLL_LINES HW_LCD_SCROLL_LINES
+
 #define LCD_DRIVER HW_LCD_DRIVER
 
 #define swap(T,a,b) {T t = (a); (a) = (b); (b) = t;}
 
-#define M_PIf 3.14159265358979323846f
-
 #define SWAP16(c) (((c) << 8) | ((c) >> 8))
 
+// Color as stored in the frame buffer (native or display wire order).
+#define FB_COLOR(c) ((color_t)(dev->fb_native ? SWAP16(c) : (c)))
+
 typedef struct {
 	coord_t     width;
 	coord_t     height;
@@ -58,6 +67,13 @@ typedef struct {
 	spi_device_handle_t SPIHandle;
 	bool        use_frame_buffer;
 	color_t   *frame_buffer;
+	color_t   *frame_back; // second buffer for asynchronous writes
+	bool        fb_native; // frame buffer pixels are in display byte order
+	bool        fb_half; // frame buffer at half resolution, doubled on write
+	bool        use_tiles; // record draw calls, rasterize in bands on write
+	bool        use_palette; // 8-bit palette indices, expanded on write
+	coord_t     clip_x0, clip_y0; // drawing limits, inclusive
+	coord_t     clip_x1, clip_y1;
 } TFT_t;
 
 typedef enum {
@@ -65,11 +81,26 @@ typedef enum {
 	SPI_Data_Mode = 1
 } spi_mode_t;
 
+// Offscreen drawing target, a frame buffer without a display.
+struct lcd_canvas {
+	TFT_t ctx;
+};
+
 static TFT_t device;
-static TFT_t *dev = &device;
+// Drawing context of the calling task, the screen or a canvas.
+static _Thread_local TFT_t *dev = &device;
 
 static const char *TAG = "lcd";
 
+// Display, mode and frame functions act on the screen only. Logs an error
+// and returns false if the calling task has a canvas selected.
+static bool screen_selected(const char *fn)
+{
+	if (dev == &device) return true;
+	ESP_LOGE(TAG, "%s with a canvas selected", fn);
+	return false;
+}
+
 static int32_t clock_freq_hz = LCD_SPI_FREQ;
 
 #include "glcdfont.c" // unsigned char font[];
@@ -84,6 +115,79 @@ static int32_t clock_freq_hz = LCD_SPI_FREQ;
 #define BUF_LEN 512
 static uint16_t buffer[BUF_LEN];
 
+// Asynchronous frame writes queue DMA transactions from a pool. The
+// transaction user field selects the DC level in the pre-transfer callback.
+#define DMA_MAX_BYTES (LCD_W*40*sizeof(color_t)) // largest single transfer
+#define TRANS_POOL 80 // ring of transactions, oldest reaped when full
+
+#define TRANS_DC_CMD  1 // set DC to command mode
+#define TRANS_DC_DATA 2 // set DC to data mode
+#define TRANS_END     4 // last transaction of a frame
+
+static spi_transaction_t trans_pool[TRANS_POOL];
+static uint32_t trans_queued; // transactions queued since start
+static uint32_t trans_reaped; // transactions completed and reaped
+static lcd_frame_cb_t frame_cb;
+static void *frame_cb_arg;
+
+// Address window last sent by the command stream. Rows always extend to
+// the bottom of the screen so a write can continue on the next row.
+static struct {
+	bool valid;         // display window matches the fields below
+	coord_t x0, x1, y0; // window in display coordinates
+	coord_t cx, cy;     // RAM write cursor
+} win;
+
+// Traffic counters, charged to the outermost public primitive of a call.
+static lcd_stat_counts_t stat[LCD_STAT_COUNT];
+static lcd_stat_t stat_cur = LCD_STAT_OTHER;
+static uint32_t stat_frames;
+static spi_mode_t bus_mode; // DC level for polling transfers
+
+static const char *stat_names[LCD_STAT_COUNT] = {
+	"other", "fillScreen", "pixel", "hvline", "line", "rect", "fillRect",
+	"triangle", "fillTriangle", "circle", "fillCircle", "roundRect",
+	"fillRoundRect", "arrow", "polygon", "bitmap", "rgbBitmap", "text",
+	"scroll", "frame",
+};
+
+// Draws on canvases are not counted, so tasks drawing on their own
+// canvases never share these counters.
+static inline lcd_stat_t stat_enter(lcd_stat_t prim)
+{
+	if (dev != &device) return LCD_STAT_COUNT;
+	lcd_stat_t prev = stat_cur;
+	if (prev == LCD_STAT_OTHER) {
+		stat_cur = prim;
+		stat[prim].calls++;
+	}
+	return prev;
+}
+
+static inline void stat_leave(const lcd_stat_t *prev)
+{
+	if (*prev != LCD_STAT_COUNT) stat_cur = *prev;
+}
+
+// Charge traffic until the end of the enclosing block to a primitive.
+#define STAT(prim) \
+	lcd_stat_t stat_prev __attribute__((cleanup(stat_leave))) = stat_enter(prim)
+
+// Count pixels drawn after clipping.
+#define STAT_PIXELS(n) ((dev == &device) ? (void)(stat[stat_cur].pixels += (n)) : (void)0)
+
+static void IRAM_ATTR spi_pre_transfer_cb(spi_transaction_t *t)
+{
+	uintptr_t user = (uintptr_t)t->user;
+	if (user & TRANS_DC_CMD) gpio_set_level(LCD_DC, SPI_Command_Mode);
+	else if (user & TRANS_DC_DATA) gpio_set_level(LCD_DC, SPI_Data_Mode);
+}
+
+static void IRAM_ATTR spi_post_transfer_cb(spi_transaction_t *t)
+{
+	if (((uintptr_t)t->user & TRANS_END) && frame_cb != NULL) frame_cb(frame_cb_arg);
+}
+
 static void spi_master_init(TFT_t *dev, int16_t GPIO_MOSI, int16_t GPIO_SCLK, int16_t GPIO_CS, int16_t GPIO_DC, int16_t GPIO_RST, int16_t GPIO_BL)
 {
 	esp_err_t ret;
@@ -122,7 +226,7 @@ static void spi_master_init(TFT_t *dev, int16_t GPIO_MOSI, int16_t GPIO_SCLK, in
 		.sclk_io_num = GPIO_SCLK,
 		.quadwp_io_num = -1,
 		.quadhd_io_num = -1,
-		.max_transfer_sz = 0,
+		.max_transfer_sz = DMA_MAX_BYTES,
 		.flags = 0
 	};
 
@@ -133,9 +237,11 @@ static void spi_master_init(TFT_t *dev, int16_t GPIO_MOSI, int16_t GPIO_SCLK, in
 	spi_device_interface_config_t devcfg;
 	memset(&devcfg, 0, sizeof(devcfg));
 	devcfg.clock_speed_hz = clock_freq_hz;
-	devcfg.queue_size = 7;
+	devcfg.queue_size = TRANS_POOL;
 	devcfg.mode = 3;
 	devcfg.flags = SPI_DEVICE_NO_DUMMY;
+	devcfg.pre_cb = spi_pre_transfer_cb;
+	devcfg.post_cb = spi_post_transfer_cb;
 
 	if ( GPIO_CS >= 0 ) {
 		devcfg.spics_io_num = GPIO_CS;
@@ -162,22 +268,39 @@ static bool spi_master_write_bytes(spi_device_handle_t SPIHandle, const uint8_t*
 		memset( &SPITransaction, 0, sizeof( spi_transaction_t ) );
 		SPITransaction.length = DataLength * 8;
 		SPITransaction.tx_buffer = Data;
+		int64_t start = esp_timer_get_time();
 #if 0
 		ret = spi_device_transmit( SPIHandle, &SPITransaction );
 #else
 		ret = spi_device_polling_transmit( SPIHandle, &SPITransaction );
 #endif
 		assert(ret==ESP_OK);
+		lcd_stat_counts_t *st = &stat[stat_cur];
+		st->wait_us += esp_timer_get_time() - start;
+		st->transactions++;
+		if (bus_mode == SPI_Command_Mode) st->cmd_bytes += DataLength;
+		else st->data_bytes += DataLength;
 	}
 
 	return true;
 }
 
+// Set the DC line for a polling transfer. The bus is shared with queued
+// frame transactions, so those must finish before DC can change.
+static inline void spi_master_set_dc(TFT_t *dev, spi_mode_t mode)
+{
+	if (trans_queued != trans_reaped) lcd_waitFrame();
+	gpio_set_level(dev->dc, mode);
+	bus_mode = mode;
+}
+
 static bool spi_master_write_command(TFT_t *dev, uint8_t cmd)
 {
 	static uint8_t Byte = 0;
 	Byte = cmd;
-	gpio_set_level( dev->dc, SPI_Command_Mode );
+	win.valid = false; // command may change the address window
+	if (cmd == 0x2A || cmd == 0x2B) stat[stat_cur].windows++;
+	spi_master_set_dc(dev, SPI_Command_Mode);
 	return spi_master_write_bytes( dev->SPIHandle, &Byte, 1 );
 }
 
@@ -185,20 +308,18 @@ static bool spi_master_write_data_byte(TFT_t *dev, uint8_t data)
 {
 	static uint8_t Byte = 0;
 	Byte = data;
-	gpio_set_level( dev->dc, SPI_Data_Mode );
+	spi_master_set_dc(dev, SPI_Data_Mode);
 	return spi_master_write_bytes( dev->SPIHandle, &Byte, 1 );
 }
 
-#if 0
 static bool spi_master_write_data_word(TFT_t *dev, uint16_t data)
 {
 	static uint8_t Byte[2];
 	Byte[0] = (data >> 8) & 0xFF;
 	Byte[1] = data & 0xFF;
-	gpio_set_level( dev->dc, SPI_Data_Mode );
+	spi_master_set_dc(dev, SPI_Data_Mode);
 	return spi_master_write_bytes( dev->SPIHandle, Byte, 2);
 }
-#endif
 
 static bool spi_master_write_addr(TFT_t *dev, uint16_t addr1, uint16_t addr2)
 {
@@ -207,1172 +328,3666 @@ static bool spi_master_write_addr(TFT_t *dev, uint16_t addr1, uint16_t addr2)
 	Byte[1] = addr1 & 0xFF;
 	Byte[2] = (addr2 >> 8) & 0xFF;
 	Byte[3] = addr2 & 0xFF;
-	gpio_set_level( dev->dc, SPI_Data_Mode );
+	spi_master_set_dc(dev, SPI_Data_Mode);
 	return spi_master_write_bytes( dev->SPIHandle, Byte, 4);
 }
 
 // size is number of color elements, not bytes.
-inline static bool spi_master_write_color(TFT_t *dev, color_t color, size_t size)
+inline static bool spi_master_write_colors(TFT_t *dev, const color_t *colors, size_t size)
 {
-	uint16_t temp = SWAP16(color);
-	size_t n = (size < BUF_LEN) ? size : BUF_LEN;
-	for (size_t i = 0; i < n; i++) buffer[i] = temp;
-	gpio_set_level(dev->dc, SPI_Data_Mode);
+	spi_master_set_dc(dev, SPI_Data_Mode);
 	while (size) {
-		n = (size < BUF_LEN) ? size : BUF_LEN;
+		size_t n = (size < BUF_LEN) ? size : BUF_LEN;
+		lcd_pix_copySwap(buffer, colors, n);
 		spi_master_write_bytes(dev->SPIHandle, (uint8_t *)buffer, n*sizeof(uint16_t));
+		colors += n;
 		size -= n;
 	}
 	return true;
 }
 
-// size is number of color elements, not bytes.
-inline static bool spi_master_write_colors(TFT_t *dev, const color_t *colors, size_t size)
+// Stream a rectangle of the frame buffer (inclusive corners). In display
+// byte order, full-width rectangles are contiguous and wide rows go out
+// straight from the frame buffer. Otherwise rows are gathered into the
+// bounce buffer so narrow rectangles still go out in BUF_LEN transactions.
+static bool spi_master_write_frame_rect(TFT_t *dev, coord_t x0, coord_t y0, coord_t x1, coord_t y1)
 {
-	gpio_set_level(dev->dc, SPI_Data_Mode);
-	while (size) {
-		size_t n = (size < BUF_LEN) ? size : BUF_LEN;
-		for (size_t i = 0; i < n; i++) buffer[i] = SWAP16(colors[i]);
-		spi_master_write_bytes(dev->SPIHandle, (uint8_t *)buffer, n*sizeof(uint16_t));
-		colors += n;
-		size -= n;
+	coord_t w = x1-x0+1;
+	size_t n = 0;
+
+	spi_master_set_dc(dev, SPI_Data_Mode);
+	if (dev->fb_native && w == dev->width) {
+		const uint8_t *ptr = (const uint8_t *)(dev->frame_buffer + (size_t)y0*dev->width);
+		size_t bytes = (size_t)(y1-y0+1)*w*sizeof(color_t);
+		while (bytes) {
+			n = (bytes < DMA_MAX_BYTES) ? bytes : DMA_MAX_BYTES;
+			spi_master_write_bytes(dev->SPIHandle, ptr, n);
+			ptr += n; bytes -= n;
+		}
+		return true;
+	}
+	for (coord_t j = y0; j <= y1; j++) {
+		const color_t *row = dev->frame_buffer + (size_t)j*dev->width + x0;
+		if (dev->fb_native && w >= BUF_LEN/2) {
+			spi_master_write_bytes(dev->SPIHandle, (const uint8_t *)row, w*sizeof(color_t));
+		} else if (dev->fb_native) {
+			// Gather narrow rows with a plain copy.
+			if (n+w > BUF_LEN) {
+				spi_master_write_bytes(dev->SPIHandle, (uint8_t *)buffer, n*sizeof(uint16_t));
+				n = 0;
+			}
+			lcd_pix_copy(buffer+n, row, w);
+			n += w;
+		} else {
+			for (coord_t i = 0; i < w; ) {
+				size_t k = BUF_LEN-n;
+				if ((size_t)(w-i) < k) k = w-i;
+				lcd_pix_copySwap(buffer+n, row+i, k);
+				n += k; i += k;
+				if (n == BUF_LEN) {
+					spi_master_write_bytes(dev->SPIHandle, (uint8_t *)buffer, n*sizeof(uint16_t));
+					n = 0;
+				}
+			}
+		}
 	}
+	spi_master_write_bytes(dev->SPIHandle, (uint8_t *)buffer, n*sizeof(uint16_t));
 	return true;
 }
 
 
 //----------------------------------------------------------------------------//
-// LCD
+// Dirty rectangle tracking
 //----------------------------------------------------------------------------//
 
-void lcd_init(void)
-{
-	spi_master_init(dev,
-		LCD_MOSI,
-		LCD_SCLK,
-		LCD_CS,
-		LCD_DC,
-		LCD_RST,
-		LCD_BL);
-
-	if (dev->res >= 0) {
-		gpio_set_level(dev->res, 0);
-		delayMS(20);
-		gpio_set_level(dev->res, 1);
-		delayMS(120);
-	}
-
-	dev->width = LCD_W;
-	dev->height = LCD_H;
-	dev->offsetx = LCD_OFFSETX;
-	dev->offsety = LCD_OFFSETY;
-	dev->font_direction = DIRECTION0;
-	dev->font_size = 1;
-	dev->font_back_en = false;
-	dev->font_back_color = BLACK;
-	dev->use_frame_buffer = false;
-	dev->frame_buffer = NULL;
-
-#if LCD_DRIVER == 0
-	// spi_master_write_command(dev, 0x01);    // ILI:Software Reset (01h), ST:SWRESET (01h): Software Reset
-	// delayMS(5);
-
-	spi_master_write_command(dev, 0x3A);    // ILI:COLMOD: Pixel Format Set (3Ah), ST:COLMOD (3Ah): Interface Pixel Format
-	spi_master_write_data_byte(dev, 0x55);
-	// delayMS(10);
-
-	spi_master_write_command(dev, 0x36);    // ILI:Memory Access Control (36h), ST:MADCTL (36h): Memory Data Access Control
-	spi_master_write_data_byte(dev, 0x08);  // 0x00
+// Frame buffer writes are recorded in two lists of inclusive rectangles:
+//   pend  - regions changed since the last lcd_writeFrame(), these are sent.
+//   drawn - regions that differ from the last lcd_fillScreen() color.
+// When a frame is cleared with the same color as the previous clear, only
+// the drawn regions change, so a clear-and-redraw loop (e.g. lab06) sends
+// just the objects that moved instead of the whole screen.
 
-	spi_master_write_command(dev, 0xCF);    // ILI:Power control B (CFh), ILI9341 only
-	spi_master_write_data_byte(dev, 0x00);
-	spi_master_write_data_byte(dev, 0xc3);
-	spi_master_write_data_byte(dev, 0x30);
-	spi_master_write_command(dev, 0xED);    // ILI:Power on sequence control (EDh), ILI9341 only
-	spi_master_write_data_byte(dev, 0x64);
-	spi_master_write_data_byte(dev, 0x03);
-	spi_master_write_data_byte(dev, 0x12);
-	spi_master_write_data_byte(dev, 0x81);
-	spi_master_write_command(dev, 0xE8);    // ILI:Driver timing control A (E8h), ST:PWCTRL2 (E8h): Power Control 2
-	spi_master_write_data_byte(dev, 0x85);
-	spi_master_write_data_byte(dev, 0x00);
-	spi_master_write_data_byte(dev, 0x78);
-	spi_master_write_command(dev, 0xCB);    // ILI:Power control A (CBh), ILI9341 only
-	spi_master_write_data_byte(dev, 0x39);
-	spi_master_write_data_byte(dev, 0x2c);
-	spi_master_write_data_byte(dev, 0x00);
-	spi_master_write_data_byte(dev, 0x34);
-	spi_master_write_data_byte(dev, 0x02);
-	spi_master_write_command(dev, 0xF7);    // ILI:Pump ratio control (F7h), ILI9341 only
-	spi_master_write_data_byte(dev, 0x20);
-	spi_master_write_command(dev, 0xEA);    // ILI:Driver timing control B (EAh), ILI9341 only
-	spi_master_write_data_byte(dev, 0x00);
-	spi_master_write_data_byte(dev, 0x00);
-	spi_master_write_command(dev, 0xC0);    // ILI:Power Control 1 (C0h), ST:LCMCTRL (C0h): LCM Control
-	spi_master_write_data_byte(dev, 0x1B);
-	spi_master_write_command(dev, 0xC1);    // ILI:Power Control 2 (C1h), ST:IDSET (C1h): ID Code Setting
-	spi_master_write_data_byte(dev, 0x12);
-	spi_master_write_command(dev, 0xC5);    // ILI:VCOM Control 1(C5h), ST:VCMOFSET (C5h): VCOM Offset Set
-	spi_master_write_data_byte(dev, 0x32);
-	spi_master_write_data_byte(dev, 0x3C);
-	spi_master_write_command(dev, 0xC7);    // ILI:VCOM Control 2(C7h), ST:CABCCTRL (C7h): CABC Control
-	spi_master_write_data_byte(dev, 0x91);
-	spi_master_write_command(dev, 0xB1);    // ILI:Frame Rate Control (In Normal Mode/Full Colors) (B1h), ST:RGBCTRL (B1h): RGB Interface Control
-	spi_master_write_data_byte(dev, 0x00);
-	spi_master_write_data_byte(dev, 0x10);
-	spi_master_write_command(dev, 0xB6);    // ILI:Display Function Control (B6h), ILI9341 only
-	spi_master_write_data_byte(dev, 0x0A);
-	spi_master_write_data_byte(dev, 0xA2);
-	spi_master_write_command(dev, 0xF6);    // ILI:Interface Control (F6h), ILI9341 only
-	spi_master_write_data_byte(dev, 0x01);
-	spi_master_write_data_byte(dev, 0x30);
+#define DIRTY_DEF_RECTS 0 // tracking is off until lcd_setDirtyPolicy()
+#define DIRTY_DOUBLE_RECTS 8 // turned on by lcd_frameDoubleEnable()
+#define DIRTY_DEF_COALESCE 256 // default extra pixels accepted by a merge
 
-	spi_master_write_command(dev, 0x11);    // ILI:Sleep Out (11h), ST:SLPOUT (11h): Sleep Out
-	delayMS(5);
+typedef struct {
+	coord_t x0, y0; // top left corner
+	coord_t x1, y1; // bottom right corner
+} rect_t;
 
-#elif LCD_DRIVER == 1
+typedef struct {
+	rect_t rect[LCD_DIRTY_RECTS];
+	uint8_t count;
+	bool full; // whole screen, rect[] is ignored
+} rect_list_t;
+
+static rect_list_t pend = {.full = true};
+static rect_list_t drawn;
+static uint8_t dirty_max_rects = DIRTY_DEF_RECTS;
+static int32_t dirty_coalesce = DIRTY_DEF_COALESCE;
+static bool dirty_double; // tracking is on for double buffering only
+static bool fill_valid; // frame buffer is fill_color outside drawn rects
+static color_t fill_color;
+static lcd_dirty_stats_t dirty_stats;
+
+// Layers (see below) keep their own lists. While one is selected, drawing
+// and its tracking go to the layer instead of the frame.
+typedef struct {
+	void *pix;         // pixels in the frame format
+	color_t key;       // transparent color, as drawn
+	rect_list_t pend;  // changed since the last composition
+	rect_list_t drawn; // may differ from the key color, all if full
+} layer_t;
 
-	// spi_master_write_command(dev, 0x01);  // SWRESET (01h): Software Reset
-	// delayMS(5);
+static layer_t *layer_cur; // selected layer, NULL when drawing to the frame
 
-	spi_master_write_command(dev, 0x36);  // MADCTL (36h): Memory Data Access Control
-	spi_master_write_data_byte(dev, 0x00);
+static inline int32_t rect_area(const rect_t *r)
+{
+	return (int32_t)(r->x1-r->x0+1)*(r->y1-r->y0+1);
+}
 
-	spi_master_write_command(dev, 0x3A);  // COLMOD (3Ah): Interface Pixel Format
-	spi_master_write_data_byte(dev, 0x05);
+// Grow rectangle a to also cover rectangle b.
+static inline void rect_union(rect_t *a, const rect_t *b)
+{
+	if (b->x0 < a->x0) a->x0 = b->x0;
+	if (b->y0 < a->y0) a->y0 = b->y0;
+	if (b->x1 > a->x1) a->x1 = b->x1;
+	if (b->y1 > a->y1) a->y1 = b->y1;
+}
 
-	spi_master_write_command(dev, 0xB2);  // PORCTRL (B2h): Porch Setting
-	spi_master_write_data_byte(dev, 0x0C);
-	spi_master_write_data_byte(dev, 0x0C);
-	spi_master_write_data_byte(dev, 0x00);
-	spi_master_write_data_byte(dev, 0x33);
-	spi_master_write_data_byte(dev, 0x33);
+// Pixels covered by the union of a and b that are in neither rectangle.
+// Negative when the rectangles overlap.
+static inline int32_t rect_waste(const rect_t *a, const rect_t *b)
+{
+	rect_t u = *a;
+	rect_union(&u, b);
+	return rect_area(&u) - rect_area(a) - rect_area(b);
+}
 
-	spi_master_write_command(dev, 0xB7);  // GCTRL (B7h): Gate Control
-	spi_master_write_data_byte(dev, 0x35);
+static void rect_list_add(rect_list_t *l, const rect_t *r)
+{
+	if (l->full) return;
+	rect_t m = *r;
+	// Fold the new rectangle into neighbors that are within the coalesce
+	// threshold. A merge grows the rectangle, so rescan from the start.
+	for (uint8_t i = 0; i < l->count; ) {
+		rect_t *c = &l->rect[i];
+		if (m.x0 >= c->x0 && m.x1 <= c->x1 && m.y0 >= c->y0 && m.y1 <= c->y1)
+			return; // already covered
+		if (rect_waste(c, &m) <= dirty_coalesce) {
+			rect_union(&m, c);
+			*c = l->rect[--l->count];
+			i = 0;
+		} else {
+			i++;
+		}
+	}
+	if (l->count < dirty_max_rects) {
+		l->rect[l->count++] = m;
+		return;
+	}
+	// List is full, merge with the rectangle that wastes the fewest pixels.
+	uint8_t best = 0;
+	int32_t best_waste = INT32_MAX;
+	for (uint8_t i = 0; i < l->count; i++) {
+		int32_t w = rect_waste(&l->rect[i], &m);
+		if (w < best_waste) {best_waste = w; best = i;}
+	}
+	rect_union(&l->rect[best], &m);
+}
 
-	spi_master_write_command(dev, 0xBB);  // VCOMS (BBh): VCOM Setting
-	spi_master_write_data_byte(dev, 0x19);
+static inline void rect_list_clear(rect_list_t *l, bool full)
+{
+	l->count = 0;
+	l->full = full || dirty_max_rects == 0;
+}
 
-	spi_master_write_command(dev, 0xC0);  // LCMCTRL (C0h): LCM Control
-	spi_master_write_data_byte(dev, 0x2C);
+// Record a modified frame buffer region, corners already clipped to screen.
+static inline void dirty_add(coord_t x0, coord_t y0, coord_t x1, coord_t y1)
+{
+	rect_list_t *p = &pend, *d = &drawn;
+	if (dev != &device) return; // canvases are not sent
+	if (layer_cur != NULL) {p = &layer_cur->pend; d = &layer_cur->drawn;}
+	if (p->full && d->full) return;
+	rect_t r = {x0, y0, x1, y1};
+	rect_list_add(p, &r);
+	rect_list_add(d, &r);
+}
 
-	spi_master_write_command(dev, 0xC2);  // VDVVRHEN (C2h): VDV and VRH Command Enable
-	spi_master_write_data_byte(dev, 0x01);
+// Record a full screen fill with the specified color.
+static void dirty_fill(color_t color)
+{
+	if (dev != &device) return;
+	if (layer_cur != NULL) {
+		rect_list_clear(&layer_cur->pend, true);
+		rect_list_clear(&layer_cur->drawn, color != layer_cur->key);
+		return;
+	}
+	if (fill_valid && fill_color == color && !drawn.full) {
+		// Only regions drawn since the last fill were changed.
+		for (uint8_t i = 0; i < drawn.count; i++) rect_list_add(&pend, &drawn.rect[i]);
+	} else {
+		rect_list_clear(&pend, true);
+	}
+	rect_list_clear(&drawn, false);
+	fill_valid = true;
+	fill_color = color;
+}
 
-	spi_master_write_command(dev, 0xC3);  // VRHS (C3h): VRH Set
-	spi_master_write_data_byte(dev, 0x12);
+// Forget all tracking, the next frame is sent in full.
+static void dirty_reset(void)
+{
+	rect_list_clear(&pend, true);
+	rect_list_clear(&drawn, true);
+	fill_valid = false;
+}
 
-	spi_master_write_command(dev, 0xC4);  // VDVS (C4h): VDV Set
-	spi_master_write_data_byte(dev, 0x20);
 
-	spi_master_write_command(dev, 0xC6);  // FRCTRL2 (C6h): Frame Rate Control in Normal Mode
-	spi_master_write_data_byte(dev, 0x0F);
+//----------------------------------------------------------------------------//
+// Vertical scroll
+//----------------------------------------------------------------------------//
 
-	spi_master_write_command(dev, 0xD0);  // PWCTRL1 (D0h): Power Control 1
-	spi_master_write_data_byte(dev, 0xA4);
-	spi_master_write_data_byte(dev, 0xA1);
+// Rows of the scroll region form a ring in the frame buffer: screen row
+// top+i is stored in row top+(i+offset)%height, so a scroll step only moves
+// the offset. If the panel can scroll, its memory keeps the frame buffer
+// layout and the scroll start address (VSCRSADD) picks the row shown at
+// the top of the region, so a step sends just the rows drawn after it.
+// Otherwise the region is sent again in screen order.
+
+static struct {
+	coord_t  top;    // first screen row of the region
+	coord_t  height; // rows in the region, 0 when scrolling is off
+	coord_t  offset; // ring position of the region's first screen row
+	bool     hw;     // panel scrolls, its memory mirrors the frame buffer
+	uint16_t start;  // scroll start address last sent to the panel
+} scroll;
+
+// Frame buffer row holding screen row y.
+static inline coord_t fb_line(coord_t y)
+{
+	coord_t i = y - scroll.top;
+	if (i < 0 || i >= scroll.height || dev != &device) return y;
+	i += scroll.offset;
+	if (i >= scroll.height) i -= scroll.height;
+	return scroll.top + i;
+}
 
-	spi_master_write_command(dev, 0xE0);  // PVGAMCTRL (E0h): Positive Voltage Gamma Control
-	spi_master_write_data_byte(dev, 0xD0);
-	spi_master_write_data_byte(dev, 0x04);
-	spi_master_write_data_byte(dev, 0x0D);
-	spi_master_write_data_byte(dev, 0x11);
-	spi_master_write_data_byte(dev, 0x13);
-	spi_master_write_data_byte(dev, 0x2B);
-	spi_master_write_data_byte(dev, 0x3F);
-	spi_master_write_data_byte(dev, 0x54);
-	spi_master_write_data_byte(dev, 0x4C);
-	spi_master_write_data_byte(dev, 0x18);
-	spi_master_write_data_byte(dev, 0x0D);
-	spi_master_write_data_byte(dev, 0x0B);
-	spi_master_write_data_byte(dev, 0x1F);
-	spi_master_write_data_byte(dev, 0x23);
+// Buffer that drawing goes to, the selected layer, the frame buffer or
+// a canvas.
+static inline color_t *fb_base(void)
+{
+	return (layer_cur != NULL && dev == &device) ? layer_cur->pix : dev->frame_buffer;
+}
 
-	spi_master_write_command(dev, 0xE1);  // NVGAMCTRL (E1h): Negative Voltage Gamma Control
-	spi_master_write_data_byte(dev, 0xD0);
-	spi_master_write_data_byte(dev, 0x04);
-	spi_master_write_data_byte(dev, 0x0C);
-	spi_master_write_data_byte(dev, 0x11);
-	spi_master_write_data_byte(dev, 0x13);
-	spi_master_write_data_byte(dev, 0x2C);
-	spi_master_write_data_byte(dev, 0x3F);
-	spi_master_write_data_byte(dev, 0x44);
-	spi_master_write_data_byte(dev, 0x51);
-	spi_master_write_data_byte(dev, 0x2F);
-	spi_master_write_data_byte(dev, 0x1F);
-	spi_master_write_data_byte(dev, 0x1F);
-	spi_master_write_data_byte(dev, 0x20);
-	spi_master_write_data_byte(dev, 0x23);
+// First pixel of screen row y in the frame buffer.
+static inline color_t *fb_row(coord_t y)
+{
+	return fb_base() + (size_t)fb_line(y)*dev->width;
+}
 
-	spi_master_write_command(dev, 0x11);  // SLPOUT (11h): Sleep Out
-	delayMS(5);
+// Number of screen rows from y0 through at most y1 that are stored in
+// consecutive frame buffer rows.
+static coord_t scroll_run(coord_t y0, coord_t y1)
+{
+	if (scroll.height) {
+		coord_t bot = scroll.top + scroll.height;
+		coord_t wrap = bot - scroll.offset; // first row stored at the top
+		coord_t end = (y0 < scroll.top) ? scroll.top : (y0 < wrap) ? wrap : bot;
+		if (y0 < bot && y1 >= end) y1 = end-1;
+	}
+	return y1-y0+1;
+}
 
-#endif
+// Move the rectangles of a list that lie inside the scroll region up by n
+// rows (0 < n < height), wrapping at the region edges like the image.
+static void rect_list_scroll(rect_list_t *l, coord_t n)
+{
+	rect_t old[LCD_DIRTY_RECTS];
+	uint8_t count = l->count;
+	coord_t top = scroll.top, bot = scroll.top+scroll.height-1;
+
+	if (l->full) return;
+	memcpy(old, l->rect, count*sizeof(rect_t));
+	rect_list_clear(l, false);
+	for (uint8_t i = 0; i < count; i++) {
+		rect_t r = old[i], p;
+		if (r.y0 < top) { // above the region
+			p = (rect_t){r.x0, r.y0, r.x1, (r.y1 < top) ? r.y1 : top-1};
+			rect_list_add(l, &p);
+		}
+		if (r.y1 > bot) { // below the region
+			p = (rect_t){r.x0, (r.y0 > bot) ? r.y0 : bot+1, r.x1, r.y1};
+			rect_list_add(l, &p);
+		}
+		coord_t y0 = (r.y0 < top) ? top : r.y0;
+		coord_t y1 = (r.y1 > bot) ? bot : r.y1;
+		if (y0 > y1) continue;
+		y0 -= n; y1 -= n;
+		if (y1 < top) {
+			y0 += scroll.height; y1 += scroll.height;
+		} else if (y0 < top) { // split by the wrap
+			p = (rect_t){r.x0, y0+scroll.height, r.x1, bot};
+			rect_list_add(l, &p);
+			y0 = top;
+		}
+		p = (rect_t){r.x0, y0, r.x1, y1};
+		rect_list_add(l, &p);
+	}
+}
 
-#if LCD_INV
-	ESP_LOGI(TAG, "Enable Display Inversion");
-	lcd_inversionOn();
-#else
-	lcd_inversionOff();
-#endif
-	lcd_fillScreen(BLACK); // assume use_frame_buffer is false
-	lcd_displayOn();
-	lcd_backlightOn();
+// Show the current ring position on the panel.
+static void scroll_show(void)
+{
+	if (!scroll.hw) return;
+	uint16_t start = scroll.top + scroll.offset + dev->offsety;
+	if (start == scroll.start) return;
+	spi_master_write_command(dev, 0x37); // VSCRSADD: Vertical Scrolling Start Address
+	spi_master_write_data_word(dev, start);
+	scroll.start = start;
 }
 
-//----------------------------------------------------------------------------//
-// Draw (outline) and fill primitives
-//----------------------------------------------------------------------------//
+// Reverse the order of frame buffer rows a through b.
+static void fb_reverse_rows(coord_t a, coord_t b)
+{
+	color_t wk[dev->width];
+
+	for (; a < b; a++, b--) {
+		color_t *pa = dev->frame_buffer + (size_t)a*dev->width;
+		color_t *pb = dev->frame_buffer + (size_t)b*dev->width;
+		lcd_pix_copy(wk, pa, dev->width);
+		lcd_pix_copy(pa, pb, dev->width);
+		lcd_pix_copy(pb, wk, dev->width);
+	}
+}
 
-void lcd_fillScreen(color_t color)
+// Send a rectangle of screen rows (inclusive corners) from the frame
+// buffer. With panel scroll, each run of consecutive frame buffer rows is
+// written to the same rows of panel memory. Otherwise one window covers
+// the rectangle and the runs are sent in screen order.
+static void write_rect(coord_t x0, coord_t y0, coord_t x1, coord_t y1)
 {
-	if (dev->use_frame_buffer) {
-		color_t *ptr = dev->frame_buffer;
-		size_t len = (size_t)dev->width*dev->height;
-		*ptr++ = color; len--;
-		while (len) {
-			size_t n = (len < ptr - dev->frame_buffer) ? len : ptr - dev->frame_buffer;
-			memcpy(ptr, dev->frame_buffer, n*sizeof(color_t));
-			ptr += n; len -= n;
+	bool split = scroll.hw && scroll.height;
+
+	for (coord_t y = y0, wy0 = y0, wy1 = y1; y <= y1; ) {
+		coord_t n = scroll_run(y, y1);
+		coord_t m = fb_line(y);
+		if (split) {wy0 = m; wy1 = m+n-1;}
+		if (split || y == y0) {
+			spi_master_write_command(dev, 0x2A); // Column(x) Address Set
+			spi_master_write_addr(dev, x0+dev->offsetx, x1+dev->offsetx);
+			spi_master_write_command(dev, 0x2B); // Page(y) Address Set
+			spi_master_write_addr(dev, wy0+dev->offsety, wy1+dev->offsety);
+			spi_master_write_command(dev, 0x2C); // Memory Write
 		}
-	} else {
-		spi_master_write_command(dev, 0x2A); // Column(x) Address Set
-		spi_master_write_addr(dev, 0, dev->width-1);
-		spi_master_write_command(dev, 0x2B); // Page(y) Address Set
-		spi_master_write_addr(dev, 0, dev->height-1);
-		spi_master_write_command(dev, 0x2C); // Memory Write
-		spi_master_write_color(dev, color, (size_t)dev->width*dev->height);
+		spi_master_write_frame_rect(dev, x0, m, x1, m+n-1);
+		y += n;
 	}
 }
 
-void lcd_drawPixel(coord_t x, coord_t y, color_t color)
-{
-	if (x < 0 || x >= dev->width) return; // off screen
-	if (y < 0 || y >= dev->height) return;
 
-	if (dev->use_frame_buffer) {
-		dev->frame_buffer[y*dev->width+x] = color;
-	} else {
-		coord_t _x = x + dev->offsetx;
-		coord_t _y = y + dev->offsety;
+//----------------------------------------------------------------------------//
+// Asynchronous frame write
+//----------------------------------------------------------------------------//
 
-		spi_master_write_command(dev, 0x2A); // Column(x) Address Set
-		spi_master_write_addr(dev, _x, _x);
-		spi_master_write_command(dev, 0x2B); // Page(y) Address Set
-		spi_master_write_addr(dev, _y, _y);
-		spi_master_write_command(dev, 0x2C); // Memory Write
-		spi_master_write_colors(dev, &color, 1);
-	}
-}
+// The draw buffer (frame_buffer) and the transfer buffer (frame_back) swap
+// roles on each lcd_writeFrameAsync(). Pending rectangles are widened to
+// full-width row bands so each band is contiguous and goes out as one DMA
+// stream. Bands are byte-swapped in place in the transfer buffer. Before
+// the swap, bands changed this frame and bands swapped last frame are
+// copied into the other buffer so both hold the same frame afterwards.
 
-void lcd_drawHPixels(coord_t x, coord_t y, coord_t w, const color_t *colors)
-{
-	if (x+w <= 0 || x >= dev->width) return; // off screen
-	if (y < 0 || y >= dev->height) return;
+static rect_t back_band[LCD_DIRTY_RECTS]; // bands swapped in frame_back
+static uint8_t back_bands;
 
-	if (x < 0) {w += x; x = 0;} // clip
-	if (x+w > dev->width) w = dev->width-x;
+// Convert the pending rectangles into sorted, disjoint row bands.
+// Returns the number of bands.
+static uint8_t dirty_bands(rect_t *band)
+{
+	uint8_t n = 0;
 
-	if (dev->use_frame_buffer) {
-		coord_t _x1 = x;
-		coord_t _x2 = _x1 + (w-1);
-		coord_t index = 0;
-		size_t fbidx = (size_t)y*dev->width;
-		for (coord_t i = _x1; i <= _x2; i++){
-			dev->frame_buffer[fbidx+i] = colors[index++];
+	if (pend.full) {
+		band[0] = (rect_t){0, 0, dev->width-1, dev->height-1};
+		return 1;
+	}
+	// Insertion sort by top row
+	for (uint8_t i = 0; i < pend.count; i++) {
+		rect_t b = {0, pend.rect[i].y0, dev->width-1, pend.rect[i].y1};
+		uint8_t j = n++;
+		for (; j > 0 && band[j-1].y0 > b.y0; j--) band[j] = band[j-1];
+		band[j] = b;
+	}
+	// Merge overlapping or touching bands
+	uint8_t m = 0;
+	for (uint8_t i = 0; i < n; i++) {
+		if (m && band[i].y0 <= band[m-1].y1+1) {
+			if (band[i].y1 > band[m-1].y1) band[m-1].y1 = band[i].y1;
+		} else {
+			band[m++] = band[i];
 		}
-	} else {
-		coord_t _x1 = x + dev->offsetx;
-		coord_t _x2 = _x1 + (w-1);
-		coord_t _y1 = y + dev->offsety;
-		coord_t _y2 = _y1;
-
-		spi_master_write_command(dev, 0x2A); // Column(x) Address Set
-		spi_master_write_addr(dev, _x1, _x2);
-		spi_master_write_command(dev, 0x2B); // Page(y) Address Set
-		spi_master_write_addr(dev, _y1, _y2);
-		spi_master_write_command(dev, 0x2C); // Memory Write
-		spi_master_write_colors(dev, colors, w);
 	}
+	return m;
 }
 
-void lcd_drawHLine(coord_t x, coord_t y, coord_t w, color_t color)
+// Copy row bands between equally sized frame buffers.
+static void copy_bands(color_t *dst, const color_t *src, const rect_t *band, uint8_t n)
 {
-	if (x+w <= 0 || x >= dev->width) return; // off screen
-	if (y < 0 || y >= dev->height) return;
-
-	if (x < 0) {w += x; x = 0;} // clip
-	if (x+w > dev->width) w = dev->width-x;
+	for (uint8_t i = 0; i < n; i++) {
+		size_t idx = (size_t)band[i].y0*dev->width;
+		size_t len = (size_t)(band[i].y1-band[i].y0+1)*dev->width;
+		lcd_pix_copy(dst+idx, src+idx, len);
+	}
+}
 
-	if (dev->use_frame_buffer) {
-		coord_t _x1 = x;
-		coord_t _x2 = _x1 + (w-1);
-		size_t fbidx = (size_t)y*dev->width;
-		for (coord_t i = _x1; i <= _x2; i++){
-			dev->frame_buffer[fbidx+i] = color;
-		}
-	} else {
-		coord_t _x1 = x + dev->offsetx;
-		coord_t _x2 = _x1 + (w-1);
-		coord_t _y1 = y + dev->offsety;
-		coord_t _y2 = _y1;
+// Reap completed transactions until the given count has been reached.
+static void trans_reap(uint32_t upto)
+{
+	spi_transaction_t *t;
+	esp_err_t ret;
 
-		spi_master_write_command(dev, 0x2A); // Column(x) Address Set
-		spi_master_write_addr(dev, _x1, _x2);
-		spi_master_write_command(dev, 0x2B); // Page(y) Address Set
-		spi_master_write_addr(dev, _y1, _y2);
-		spi_master_write_command(dev, 0x2C); // Memory Write
-		spi_master_write_color(dev, color, w);
+	if ((int32_t)(upto - trans_reaped) <= 0) return;
+	int64_t start = esp_timer_get_time();
+	while ((int32_t)(upto - trans_reaped) > 0) {
+		ret = spi_device_get_trans_result(dev->SPIHandle, &t, portMAX_DELAY);
+		assert(ret==ESP_OK);
+		trans_reaped++;
 	}
+	stat[stat_cur].wait_us += esp_timer_get_time() - start;
 }
 
-void lcd_drawVLine(coord_t x, coord_t y, coord_t h, color_t color)
+// Queue one transaction. Up to four bytes are copied into the transaction.
+static void trans_queue(const void *data, size_t len, uintptr_t user)
 {
-	coord_t y2 = y+h-1;
-	if (x < 0 || x  >= dev->width) return; // off screen
-	if (y2 < 0 || y >= dev->height) return;
-
-	if (y < 0) y = 0; // clip
-	if (y2 >= dev->height) y2 = dev->height-1;
+	esp_err_t ret;
 
-	if (dev->use_frame_buffer) {
-		for (size_t j = y; j <= y2; j++){
-			dev->frame_buffer[j*dev->width+x] = color;
-		}
+	if (trans_queued - trans_reaped == TRANS_POOL) trans_reap(trans_reaped+1);
+	spi_transaction_t *t = &trans_pool[trans_queued++ % TRANS_POOL];
+	memset(t, 0, sizeof(spi_transaction_t));
+	t->length = len * 8;
+	t->user = (void *)user;
+	if (len <= sizeof(t->tx_data)) {
+		t->flags = SPI_TRANS_USE_TXDATA;
+		memcpy(t->tx_data, data, len);
 	} else {
-		coord_t _x1 =  x  + dev->offsetx;
-		coord_t _x2 = _x1 + dev->offsetx;
-		coord_t _y1 =  y  + dev->offsety;
-		coord_t _y2 =  y2 + dev->offsety;
-		size_t size = _y2-_y1+1;
-
-		spi_master_write_command(dev, 0x2A); // Column(x) Address Set
-		spi_master_write_addr(dev, _x1, _x2);
-		spi_master_write_command(dev, 0x2B); // Page(y) Address Set
-		spi_master_write_addr(dev, _y1, _y2);
-		spi_master_write_command(dev, 0x2C); // Memory Write
-		spi_master_write_color(dev, color, size);
+		t->tx_buffer = data;
 	}
+	ret = spi_device_queue_trans(dev->SPIHandle, t, portMAX_DELAY);
+	assert(ret==ESP_OK);
+	lcd_stat_counts_t *st = &stat[stat_cur];
+	st->transactions++;
+	if (user & TRANS_DC_CMD) st->cmd_bytes += len;
+	else st->data_bytes += len;
 }
 
-/**
- * @note Bresenham's algorithm from Wikipedia. Speed enhanced by Bodmer to use
- *  efficient H/V Line draw routines for line segments of 2 pixels or more.
- */
-void lcd_drawLine(coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color)
+static void trans_queue_addr(uint8_t cmd, uint16_t addr1, uint16_t addr2)
 {
-	bool steep = abs(y1 - y0) > abs(x1 - x0);
-	if (steep) {
-		swap(coord_t, x0, y0);
-		swap(coord_t, x1, y1);
-	}
+	uint8_t Byte[4] = {addr1 >> 8, addr1 & 0xFF, addr2 >> 8, addr2 & 0xFF};
+	stat[stat_cur].windows++;
+	trans_queue(&cmd, 1, TRANS_DC_CMD);
+	trans_queue(Byte, 4, TRANS_DC_DATA);
+}
 
-	if (x0 > x1) {
-		swap(coord_t, x0, x1);
-		swap(coord_t, y0, y1);
-	}
+//----------------------------------------------------------------------------//
+// Command stream
+//----------------------------------------------------------------------------//
 
-	coord_t dx = x1 - x0, dy = abs(y1 - y0);;
+// In direct mode, draw calls are queued as DMA transactions instead of
+// polling transfers, with DC driven from the transaction user field. Window
+// commands are skipped when they match the cached window, and a write that
+// starts at the RAM cursor uses Memory Write Continue with no window at all.
+// Pixel data is staged because callers may reuse their arrays on return.
+#define STREAM_BYTES 8192 // staging for pixel data of queued transactions
 
-	coord_t err = dx >> 1, ystep = -1, xs = x0, dlen = 0;
+static DMA_ATTR uint8_t stream_buf[STREAM_BYTES];
+static size_t stream_pos;
 
-	if (y0 < y1) ystep = 1;
+// Reserve staging space. When full, wait for queued transactions to finish.
+static void *stream_reserve(size_t bytes)
+{
+	if (stream_pos + bytes > STREAM_BYTES) lcd_waitFrame(); // resets stream_pos
+	void *ptr = stream_buf + stream_pos;
+	stream_pos += (bytes + 3) & ~(size_t)3; // keep word alignment
+	return ptr;
+}
 
-	// Split into steep and not steep for FastH/V separation
-	if (steep) {
-		for (; x0 <= x1; x0++) {
-			dlen++;
-			err -= dy;
-			if (err < 0) {
-				if (dlen == 1) lcd_drawPixel(y0, xs, color);
-				else lcd_drawVLine(y0, xs, dlen, color);
-				dlen = 0;
-				y0 += ystep; xs = x0 + 1;
-				err += dx;
-			}
+// Open a write to the region x0..x1, y0..y1 (display coordinates).
+static void stream_window(coord_t x0, coord_t y0, coord_t x1, coord_t y1)
+{
+	// A single row only needs to fit, so its window extends to the right
+	// edge. More rows need the exact column range to wrap correctly.
+	bool cols = win.valid && ((y0 == y1) ?
+		(x0 >= win.x0 && x1 <= win.x1) : (x0 == win.x0 && x1 == win.x1));
+	uint8_t cmd;
+
+	if (cols && win.cx == x0 && win.cy == y0) {
+		cmd = 0x3C; // Memory Write Continue
+		stat[stat_cur].window_skips += 2;
+	} else {
+		if (cols && x0 == win.x0) {
+			stat[stat_cur].window_skips++;
+		} else {
+			win.x0 = x0;
+			win.x1 = (y0 == y1) ? dev->offsetx+dev->width-1 : x1;
+			trans_queue_addr(0x2A, win.x0, win.x1); // Column(x) Address Set
 		}
-		if (dlen) lcd_drawVLine(y0, xs, dlen, color);
-	}
-	else
-	{
-		for (; x0 <= x1; x0++) {
-			dlen++;
-			err -= dy;
-			if (err < 0) {
-				if (dlen == 1) lcd_drawPixel(xs, y0, color);
-				else lcd_drawHLine(xs, y0, dlen, color);
-				dlen = 0;
-				y0 += ystep; xs = x0 + 1;
-				err += dx;
-			}
+		if (win.valid && y0 == win.y0) {
+			stat[stat_cur].window_skips++;
+		} else {
+			win.y0 = y0;
+			trans_queue_addr(0x2B, y0, dev->offsety+dev->height-1); // Page(y) Address Set
 		}
-		if (dlen) lcd_drawHLine(xs, y0, dlen, color);
+		win.valid = true;
+		win.cx = x0;
+		win.cy = y0;
+		cmd = 0x2C; // Memory Write
 	}
+	trans_queue(&cmd, 1, TRANS_DC_CMD);
 }
 
-void lcd_drawRect(coord_t x, coord_t y, coord_t w, coord_t h, color_t color)
+// Advance the RAM write cursor by n pixels.
+static void stream_advance(size_t n)
 {
-	lcd_drawHLine(x,     y,     w, color);
-	lcd_drawHLine(x,     y+h-1, w, color);
-	lcd_drawVLine(x,     y,     h, color);
-	lcd_drawVLine(x+w-1, y,     h, color);
+	size_t w = win.x1-win.x0+1;
+	size_t pos = (size_t)(win.cy-win.y0)*w + (win.cx-win.x0) + n;
+	win.cx = win.x0 + pos%w;
+	win.cy = win.y0 + pos/w;
 }
 
-void lcd_fillRect(coord_t x, coord_t y, coord_t w, coord_t h, color_t color)
+// Write n pixels of one color to the open window.
+static void stream_color(color_t color, size_t n)
 {
-	coord_t x1 = x+w-1;
-	coord_t y1 = y+h-1;
+	uint16_t temp = SWAP16(color);
+	size_t len = (n < STREAM_BYTES/2/sizeof(color_t)) ? n : STREAM_BYTES/2/sizeof(color_t);
+	uint16_t *block;
 
-	if (x1 < 0 || x >= dev->width) return; // off screen
-	if (y1 < 0 || y >= dev->height) return;
+	stream_advance(n);
+	if (n <= 2) { // fits in the transaction itself
+		uint16_t pair[2] = {temp, temp};
+		trans_queue(pair, n*sizeof(color_t), TRANS_DC_DATA);
+		return;
+	}
+	block = stream_reserve(len*sizeof(color_t));
+	lcd_pix_fill(block, temp, len);
+	while (n) {
+		size_t k = (n < len) ? n : len;
+		trans_queue(block, k*sizeof(color_t), TRANS_DC_DATA);
+		n -= k;
+	}
+}
 
-	if (x < 0) x = 0; // clip
-	if (x1 >= dev->width) x1=dev->width-1;
-	if (y < 0) y = 0;
-	if (y1 >= dev->height) y1=dev->height-1;
+// Write n pixels from an array to the open window.
+static void stream_colors(const color_t *colors, size_t n)
+{
+	stream_advance(n);
+	while (n) {
+		size_t k = (n < STREAM_BYTES/2/sizeof(color_t)) ? n : STREAM_BYTES/2/sizeof(color_t);
+		uint16_t pair[2];
+		uint16_t *block = (k <= 2) ? pair : stream_reserve(k*sizeof(color_t));
+		lcd_pix_copySwap(block, colors, k);
+		trans_queue(block, k*sizeof(color_t), TRANS_DC_DATA);
+		colors += k;
+		n -= k;
+	}
+}
 
-	if (dev->use_frame_buffer) {
-		for (size_t j = y; j <= y1; j++){
-			for (size_t i = x; i <= x1; i++){
-				dev->frame_buffer[j*dev->width+i] = color;
-			}
-		}
-	} else {
-		coord_t _x0 = x  + dev->offsetx;
-		coord_t _x1 = x1 + dev->offsetx;
-		coord_t _y0 = y  + dev->offsety;
-		coord_t _y1 = y1 + dev->offsety;
-		size_t size = (size_t)(_x1-_x0+1)*(_y1-_y0+1);
+//----------------------------------------------------------------------------//
+// Tiled rendering
+//----------------------------------------------------------------------------//
 
-		spi_master_write_command(dev, 0x2A); // Column(x) Address Set
-		spi_master_write_addr(dev, _x0, _x1);
-		spi_master_write_command(dev, 0x2B); // Page(y) Address Set
-		spi_master_write_addr(dev, _y0, _y1);
-		spi_master_write_command(dev, 0x2C); // Memory Write
-		spi_master_write_color(dev, color, size);
+// Draw calls are recorded into a command list instead of a frame buffer.
+// On write, the frame is rasterized one full-width band at a time into
+// two small DMA buffers, so one band is sent while the next is drawn.
+#define TILE_DEF_CMD_BYTES (8*1024) // default command list size
+#define TILE_DEF_BAND_H 16 // default rows per band
+
+static lcd_tile_list_t tile_list;
+static uint32_t *tile_cmd;
+static color_t *tile_buf[2];
+
+// Parallel rasterization: the changed bands are dealt out in turn to one
+// worker task per core, which draw them into a full frame. The frame is
+// sent once both are done.
+#define PAR_WORKERS 2
+#define PAR_TASK_STACK 2048
+#define PAR_TASK_PRIO 5
+
+static color_t *par_frame;
+static SemaphoreHandle_t par_start[PAR_WORKERS];
+static SemaphoreHandle_t par_done;
+static uint8_t par_workers; // tasks running
+static volatile bool par_quit;
+
+static void par_task(void *arg)
+{
+	uintptr_t k = (uintptr_t)arg;
+
+	for (;;) {
+		xSemaphoreTake(par_start[k], portMAX_DELAY);
+		if (par_quit) break;
+		uint16_t bands = lcd_tile_bands(&tile_list);
+		uint16_t n = 0;
+		for (uint16_t b = 0; b < bands; b++) {
+			if (!lcd_tile_changed(&tile_list, b)) continue;
+			if (n++ % PAR_WORKERS != k) continue;
+			lcd_tile_raster(&tile_list, b,
+				par_frame + (size_t)b*tile_list.band_h*dev->width, true);
+		}
+		xSemaphoreGive(par_done);
 	}
+	xSemaphoreGive(par_done);
+	vTaskDelete(NULL);
 }
 
-void lcd_drawTriangle(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t x2, coord_t y2, color_t color)
+// Rasterize the changed bands on every worker and wait for all of them.
+static void par_raster(void)
 {
-	lcd_drawLine(x0, y0, x1, y1, color);
-	lcd_drawLine(x1, y1, x2, y2, color);
-	lcd_drawLine(x2, y2, x0, y0, color);
+	for (uint8_t k = 0; k < PAR_WORKERS; k++) xSemaphoreGive(par_start[k]);
+	for (uint8_t k = 0; k < PAR_WORKERS; k++) xSemaphoreTake(par_done, portMAX_DELAY);
 }
 
-/**
- * @note Original Adafruit function works well and code footprint is small.
- */
-void lcd_fillTriangle(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t x2, coord_t y2, color_t color)
+// Send the recorded frame. Returns false if no band needed to be sent.
+static bool tile_write(void)
 {
-	coord_t a, b, y, last;
-
-	// Sort coordinates by Y order (y2 >= y1 >= y0)
-	if (y0 > y1) {
-		swap(coord_t, y0, y1); swap(coord_t, x0, x1);
+	uint16_t bands = lcd_tile_bands(&tile_list);
+	uint16_t last = bands;
+	uint32_t done[2] = {trans_queued, trans_queued}; // buffer free after these
+	uint8_t cur = 0;
+	size_t frame_bytes = (size_t)dev->width*dev->height*sizeof(color_t);
+	size_t sent_bytes = 0;
+	bool window = false;
+
+	if (tile_list.dropped) {
+		ESP_LOGW(TAG, "tile command list full, %lu commands dropped",
+			(unsigned long)tile_list.dropped);
 	}
-	if (y1 > y2) {
-		swap(coord_t, y2, y1); swap(coord_t, x2, x1);
+	dirty_stats.frames++;
+	stat_frames++;
+	for (uint16_t b = 0; b < bands; b++) {
+		if (lcd_tile_changed(&tile_list, b)) last = b;
 	}
-	if (y0 > y1) {
-		swap(coord_t, y0, y1); swap(coord_t, x0, x1);
+	if (par_frame != NULL && last != bands) {
+		trans_reap(trans_queued); // the last frame is sent from par_frame
+		par_raster();
 	}
+	for (uint16_t b = 0; b < bands; b++) {
+		if (!lcd_tile_changed(&tile_list, b)) continue;
+		coord_t y0 = b * tile_list.band_h;
+		coord_t rows;
+		color_t *buf;
+		if (par_frame != NULL) {
+			buf = par_frame + (size_t)y0*dev->width;
+			rows = (dev->height-y0 < tile_list.band_h) ? dev->height-y0 : tile_list.band_h;
+		} else {
+			trans_reap(done[cur]); // wait for the band sent from this buffer
+			buf = tile_buf[cur];
+			rows = lcd_tile_raster(&tile_list, b, buf, true);
+		}
+		size_t bytes = (size_t)rows*dev->width*sizeof(color_t);
 
-	if (y0 == y2) { // Handle awkward all-on-same-line case as its own thing
-		a = b = x0;
-		if (x1 < a)      a = x1;
-		else if (x1 > b) b = x1;
-		if (x2 < a)      a = x2;
-		else if (x2 > b) b = x2;
-		lcd_drawHLine(a, y0, b - a + 1, color);
-		return;
+		if (!window) { // column window is the full width for every band
+			win.valid = false;
+			trans_queue_addr(0x2A, dev->offsetx, dev->offsetx+dev->width-1); // Column(x) Address Set
+			window = true;
+		}
+		trans_queue_addr(0x2B, y0+dev->offsety, y0+rows-1+dev->offsety); // Page(y) Address Set
+		uint8_t cmd = 0x2C; // Memory Write
+		trans_queue(&cmd, 1, TRANS_DC_CMD);
+		trans_queue(buf, bytes, TRANS_DC_DATA | ((b == last) ? TRANS_END : 0));
+		done[cur] = trans_queued;
+		cur ^= 1;
+		sent_bytes += bytes;
+		dirty_stats.rects++;
 	}
+	if (sent_bytes == frame_bytes) dirty_stats.full_frames++;
+	dirty_stats.bytes_sent += sent_bytes;
+	dirty_stats.bytes_saved += frame_bytes - sent_bytes;
+	lcd_tile_reset(&tile_list);
+	// The last band may still be in flight. The next display access or
+	// frame waits for it, and only then reuses its buffer.
+	return last != bands;
+}
 
-	coord_t
-	dx01 = x1 - x0,
-	dy01 = y1 - y0,
-	dx02 = x2 - x0,
-	dy02 = y2 - y0,
-	dx12 = x2 - x1,
-	dy12 = y2 - y1,
-	sa   = 0,
-	sb   = 0;
-
-	// For upper part of triangle, find scanline crossings for segments
-	// 0-1 and 0-2. If y1=y2 (flat-bottomed triangle), the scanline y1
-	// is included here (and second loop will be skipped, avoiding a /0
-	// error there), otherwise scanline y1 is skipped here and handled
-	// in the second loop...which also avoids a /0 error here if y0=y1
-	// (flat-topped triangle).
-	if (y1 == y2) last = y1; // Include y1 scanline
-	else          last = y1 - 1; // Skip it
-
-	for (y = y0; y <= last; y++) {
-		a   = x0 + sa / dy01;
-		b   = x0 + sb / dy02;
-		sa += dx01;
-		sb += dx02;
+//----------------------------------------------------------------------------//
+// Palette mode
+//----------------------------------------------------------------------------//
 
-		if (a > b) swap(coord_t, a, b);
-		lcd_drawHLine(a, y, b - a + 1, color);
+// The frame is kept as 8-bit indices into a palette of up to 256 colors.
+// Draw calls map their color to the nearest palette entry, with a small
+// cache of recently mapped colors in front of the search. On write, the
+// dirty rectangles are expanded through the palette, stored in display
+// byte order, into two small DMA buffers so one chunk is sent while the
+// next is expanded. A palette change resends the whole frame. With the
+// default palette, a grid of red, green and blue levels, the closest entry
+// is found per channel without a search.
+#define PAL_CACHE 64 // recently mapped colors, a power of two
+#define PAL_VALID 0x10000 // cache key flag
+#define PAL_BUF_PIXELS (LCD_W*16) // pixels per expansion buffer
+
+static uint8_t *pal_frame;
+static color_t *pal_buf[2];
+static color_t pal_rgb[256]; // palette in CPU byte order, for matching
+static color_t pal_wire[256]; // palette in display byte order
+static uint16_t pal_count;
+static uint32_t pal_key[PAL_CACHE]; // color | PAL_VALID
+static uint8_t pal_val[PAL_CACHE];
+static bool pal_grid; // default palette, use the tables below
+static uint8_t pal_grid_r[32], pal_grid_g[64], pal_grid_b[32]; // index bits per level
+
+// Find the palette entry closest to a color, weighting green most.
+static uint8_t pal_match(color_t color)
+{
+	int32_t r = color >> 11, g = (color >> 5) & 0x3F, b = color & 0x1F;
+	uint32_t best_d = UINT32_MAX;
+	uint8_t best = 0;
+
+	for (uint16_t i = 0; i < pal_count; i++) {
+		color_t p = pal_rgb[i];
+		int32_t dr = 2*((p >> 11) - r); // red and blue scaled to 6 bits
+		int32_t dg = ((p >> 5) & 0x3F) - g;
+		int32_t db = 2*((p & 0x1F) - b);
+		uint32_t d = 3*dr*dr + 4*dg*dg + 2*db*db;
+		if (d < best_d) {
+			best_d = d;
+			best = i;
+			if (d == 0) break;
+		}
 	}
+	return best;
+}
 
-	// For lower part of triangle, find scanline crossings for segments
-	// 0-2 and 1-2. This loop is skipped if y1=y2.
-	sa = dx12 * (y - y1);
-	sb = dx02 * (y - y0);
-	for (; y <= y2; y++) {
-		a   = x1 + sa / dy12;
-		b   = x0 + sb / dy02;
-		sa += dx12;
-		sb += dx02;
-
-		if (a > b) swap(coord_t, a, b);
-		lcd_drawHLine(a, y, b - a + 1, color);
+// Palette index for a color.
+static uint8_t pal_index(color_t color)
+{
+	if (pal_grid) {
+		return pal_grid_r[color >> 11] | pal_grid_g[(color >> 5) & 0x3F] | pal_grid_b[color & 0x1F];
+	}
+	uint32_t h = ((uint32_t)color*0x9E37U >> 10) & (PAL_CACHE-1);
+	if (pal_key[h] != (color | PAL_VALID)) {
+		pal_key[h] = color | PAL_VALID;
+		pal_val[h] = pal_match(color);
 	}
+	return pal_val[h];
 }
 
-void lcd_drawCircle(coord_t xc, coord_t yc, coord_t r, color_t color)
+// First index of screen row y in the buffer that drawing goes to.
+static inline uint8_t *pal_row(coord_t y)
 {
-	coord_t x;
-	coord_t y;
-	coord_t err;
-	coord_t old_err;
+	uint8_t *base = (layer_cur != NULL) ? layer_cur->pix : pal_frame;
+	return base + (size_t)y*dev->width;
+}
 
-	x=0;
-	y=-r;
-	err=2-2*r;
-	do {
-		lcd_drawPixel(xc-x, yc+y, color);
-		lcd_drawPixel(xc-y, yc-x, color);
-		lcd_drawPixel(xc+x, yc-y, color);
-		lcd_drawPixel(xc+y, yc+x, color);
-		if ((old_err=err)<=x)   err+=++x*2+1;
-		if (old_err>y || err>x) err+=++y*2+1;
-	} while (y<0);
+// Fill a rectangle (inclusive corners, already clipped) with one color.
+static void pal_rect(coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color)
+{
+	uint8_t idx = pal_index(color);
+	for (coord_t j = y0; j <= y1; j++) memset(pal_row(j)+x0, idx, x1-x0+1);
+	dirty_add(x0, y0, x1, y1);
 }
 
-void lcd_fillCircle(coord_t xc, coord_t yc, coord_t r, color_t color)
+// Store a clipped horizontal run of colors.
+static void pal_pixels(coord_t x, coord_t y, coord_t w, const color_t *colors)
 {
-	coord_t x;
-	coord_t y;
-	coord_t err;
-	coord_t old_err;
-	coord_t ChangeX;
+	uint8_t *dst = pal_row(y)+x;
+	for (coord_t i = 0; i < w; i++) dst[i] = pal_index(colors[i]);
+	dirty_add(x, y, x+w-1, y);
+}
 
-	x=0;
-	y=-r;
-	err=2-2*r;
-	ChangeX=1;
-	do {
-		if (ChangeX) {
-			lcd_drawVLine(xc-x, yc+y, (-y<<1)+1, color);
-			lcd_drawVLine(xc+x, yc+y, (-y<<1)+1, color);
+// Send the regions changed since the last write. Returns false if nothing
+// needed to be sent.
+static bool pal_write(void)
+{
+	rect_t full = {0, 0, dev->width-1, dev->height-1};
+	const rect_t *rect = pend.full ? &full : pend.rect;
+	uint8_t n = pend.full ? 1 : pend.count;
+	uint32_t done[2] = {trans_queued, trans_queued}; // buffer free after these
+	uint8_t cur = 0;
+	size_t frame_bytes = (size_t)dev->width*dev->height*sizeof(color_t);
+	size_t sent_bytes = 0;
+
+	dirty_stats.frames++;
+	stat_frames++;
+	if (pend.full) dirty_stats.full_frames++;
+	else dirty_stats.rects += n;
+	win.valid = false;
+	for (uint8_t i = 0; i < n; i++) {
+		const rect_t *r = &rect[i];
+		coord_t w = r->x1-r->x0+1;
+		coord_t rows = PAL_BUF_PIXELS/w;
+		trans_queue_addr(0x2A, r->x0+dev->offsetx, r->x1+dev->offsetx); // Column(x) Address Set
+		trans_queue_addr(0x2B, r->y0+dev->offsety, r->y1+dev->offsety); // Page(y) Address Set
+		uint8_t cmd = 0x2C; // Memory Write
+		trans_queue(&cmd, 1, TRANS_DC_CMD);
+		for (coord_t y = r->y0; y <= r->y1; y += rows) {
+			coord_t m = (r->y1-y+1 < rows) ? r->y1-y+1 : rows;
+			size_t bytes = (size_t)m*w*sizeof(color_t);
+			trans_reap(done[cur]); // wait for the chunk sent from this buffer
+			for (coord_t j = 0; j < m; j++) {
+				const uint8_t *src = pal_frame + (size_t)(y+j)*dev->width + r->x0;
+				lcd_pix_lookup(pal_buf[cur]+(size_t)j*w, src, pal_wire, w);
+			}
+			bool end = (i == n-1 && y+m > r->y1);
+			trans_queue(pal_buf[cur], bytes, TRANS_DC_DATA | (end ? TRANS_END : 0));
+			done[cur] = trans_queued;
+			cur ^= 1;
+			sent_bytes += bytes;
 		}
-		ChangeX=(old_err=err)<=x;
-		if (ChangeX)            err+=++x*2+1;
-		if (old_err>y || err>x) err+=++y*2+1;
-	} while (y<=0);
+	}
+	dirty_stats.bytes_sent += sent_bytes;
+	dirty_stats.bytes_saved += frame_bytes - sent_bytes;
+	rect_list_clear(&pend, false);
+	// The last chunk may still be in flight, as with tile mode.
+	return n != 0;
 }
 
-void lcd_drawRoundRect(coord_t x, coord_t y, coord_t w, coord_t h, coord_t r, color_t color)
-{
-	coord_t x1 = x+w-1;
-	coord_t y1 = y+h-1;
-	coord_t xa;
-	coord_t ya;
-	coord_t err;
-	coord_t old_err;
 
-	w -= (r<<1);
-	h -= (r<<1);
-	if (w < 1 || h < 1) return;
+//----------------------------------------------------------------------------//
+// Half resolution mode
+//----------------------------------------------------------------------------//
 
-	xa=0;
-	ya=-r;
-	err=2-2*r;
+// The frame buffer covers half the screen width and height, and drawing
+// works in that space. On write, each dirty rectangle is scaled up 2x
+// into two small DMA buffers as with palette mode: source rows are
+// doubled (and byte swapped) into the first of each pair of display rows,
+// which is then copied to the second.
+#define HALF_BUF_PIXELS (LCD_W*16) // display pixels per scaling buffer
 
-	do {
-		if (xa) {
-			lcd_drawPixel(x+r-xa,  y+r+ya,  color);
-			lcd_drawPixel(x1-r+xa, y+r+ya,  color);
-			lcd_drawPixel(x+r-xa,  y1-r-ya, color);
-			lcd_drawPixel(x1-r+xa, y1-r-ya, color);
+static color_t *half_buf[2];
+
+// Send the regions changed since the last write. Returns false if nothing
+// needed to be sent.
+static bool half_write(void)
+{
+	rect_t full = {0, 0, dev->width-1, dev->height-1};
+	const rect_t *rect = pend.full ? &full : pend.rect;
+	uint8_t n = pend.full ? 1 : pend.count;
+	uint32_t done[2] = {trans_queued, trans_queued}; // buffer free after these
+	uint8_t cur = 0;
+	size_t frame_bytes = (size_t)LCD_W*LCD_H*sizeof(color_t);
+	size_t sent_bytes = 0;
+
+	dirty_stats.frames++;
+	stat_frames++;
+	if (pend.full) dirty_stats.full_frames++;
+	else dirty_stats.rects += n;
+	win.valid = false;
+	for (uint8_t i = 0; i < n; i++) {
+		const rect_t *r = &rect[i];
+		coord_t w = r->x1-r->x0+1; // source pixels per row
+		coord_t rows = HALF_BUF_PIXELS/(4*w); // source rows per chunk
+		trans_queue_addr(0x2A, 2*r->x0+dev->offsetx, 2*r->x1+1+dev->offsetx); // Column(x) Address Set
+		trans_queue_addr(0x2B, 2*r->y0+dev->offsety, 2*r->y1+1+dev->offsety); // Page(y) Address Set
+		uint8_t cmd = 0x2C; // Memory Write
+		trans_queue(&cmd, 1, TRANS_DC_CMD);
+		for (coord_t y = r->y0; y <= r->y1; y += rows) {
+			coord_t m = (r->y1-y+1 < rows) ? r->y1-y+1 : rows;
+			size_t bytes = (size_t)m*4*w*sizeof(color_t);
+			trans_reap(done[cur]); // wait for the chunk sent from this buffer
+			for (coord_t j = 0; j < m; j++) {
+				color_t *dst = half_buf[cur]+(size_t)j*4*w;
+				const color_t *src = dev->frame_buffer + (size_t)(y+j)*dev->width + r->x0;
+				if (dev->fb_native) lcd_pix_double(dst, src, w);
+				else lcd_pix_doubleSwap(dst, src, w);
+				lcd_pix_copy(dst+2*w, dst, 2*w);
+			}
+			bool end = (i == n-1 && y+m > r->y1);
+			trans_queue(half_buf[cur], bytes, TRANS_DC_DATA | (end ? TRANS_END : 0));
+			done[cur] = trans_queued;
+			cur ^= 1;
+			sent_bytes += bytes;
 		}
-		if ((old_err=err)<=xa)    err+=++xa*2+1;
-		if (old_err>ya || err>xa) err+=++ya*2+1;
-	} while (ya<0);
-	lcd_drawHLine(x+r, y,   w, color);
-	lcd_drawHLine(x+r, y1,  w, color);
-	lcd_drawVLine(x,   y+r, h, color);
-	lcd_drawVLine(x1,  y+r, h, color);
+	}
+	dirty_stats.bytes_sent += sent_bytes;
+	dirty_stats.bytes_saved += frame_bytes - sent_bytes;
+	rect_list_clear(&pend, false);
+	// The last chunk may still be in flight, as with tile mode.
+	return n != 0;
 }
 
-void lcd_fillRoundRect(coord_t x, coord_t y, coord_t w, coord_t h, coord_t r, color_t color)
-{
-	// coord_t x1 = x+w-1;
-	coord_t y1 = y+h-1;
-	coord_t xa;
-	coord_t ya;
-	coord_t err;
-	coord_t old_err;
 
-	coord_t w1 = w-(r<<1);
-	coord_t h1 = h-(r<<1);
-	if (w1 < 1 || h1 < 1) return;
+//----------------------------------------------------------------------------//
+// Layers
+//----------------------------------------------------------------------------//
+
+// Layers are buffers in the frame format (colors, or palette indices): an
+// opaque background that is drawn once and kept, and dynamic layers on top
+// where the key color is transparent. The frame buffer only holds their
+// composition. Each layer tracks the regions changed since the last
+// composition, and those of a dynamic layer include where a clear removed
+// last frame's objects. At lcd_writeFrame() only the union of these regions
+// is composed again, from the background up through the dynamic layers
+// that may have pixels there, so the work follows the moving objects.
+
+static layer_t layer[LCD_LAYERS_MAX+1]; // [0] is the background
+static uint8_t layer_count; // including the background, 0 when off
+
+// Does the rectangle overlap any region of a list.
+static bool rect_list_hits(const rect_list_t *l, const rect_t *r)
+{
+	if (l->full) return true;
+	for (uint8_t i = 0; i < l->count; i++) {
+		const rect_t *c = &l->rect[i];
+		if (c->x0 <= r->x1 && r->x0 <= c->x1 && c->y0 <= r->y1 && r->y0 <= c->y1) return true;
+	}
+	return false;
+}
+
+// Fill a rectangle of a layer with one color, without tracking.
+static void layer_fill(layer_t *l, const rect_t *r, color_t color)
+{
+	coord_t w = r->x1-r->x0+1;
+	for (coord_t y = r->y0; y <= r->y1; y++) {
+		size_t idx = (size_t)y*dev->width + r->x0;
+		if (dev->use_palette) memset((uint8_t *)l->pix + idx, pal_index(color), w);
+		else lcd_pix_fill((color_t *)l->pix + idx, FB_COLOR(color), w);
+	}
+}
+
+// Compose the regions changed in any layer into the frame.
+static void layer_compose(void)
+{
+	rect_list_t area;
+	rect_t full = {0, 0, dev->width-1, dev->height-1};
+
+	rect_list_clear(&area, false);
+	for (uint8_t i = 0; i < layer_count; i++) {
+		rect_list_t *p = &layer[i].pend;
+		if (p->full) rect_list_add(&area, &full);
+		else for (uint8_t j = 0; j < p->count; j++) rect_list_add(&area, &p->rect[j]);
+		rect_list_clear(p, false);
+	}
+	const rect_t *rect = area.full ? &full : area.rect;
+	uint8_t n = area.full ? 1 : area.count;
+	layer_t *sel = layer_cur;
+	layer_cur = NULL; // the frame is tracked below
+	for (uint8_t i = 0; i < n; i++) {
+		const rect_t *r = &rect[i];
+		coord_t w = r->x1-r->x0+1;
+		uint8_t top[LCD_LAYERS_MAX]; // dynamic layers with pixels here
+		color_t key[LCD_LAYERS_MAX]; // their keys as stored
+		uint8_t m = 0;
+		for (uint8_t k = 1; k < layer_count; k++) {
+			if (!rect_list_hits(&layer[k].drawn, r)) continue;
+			key[m] = dev->use_palette ? pal_index(layer[k].key) : FB_COLOR(layer[k].key);
+			top[m++] = k;
+		}
+		for (coord_t y = r->y0; y <= r->y1; y++) {
+			size_t idx = (size_t)y*dev->width + r->x0;
+			if (dev->use_palette) {
+				memcpy(pal_frame+idx, (uint8_t *)layer[0].pix + idx, w);
+				for (uint8_t k = 0; k < m; k++) {
+					lcd_pix_copyKey8(pal_frame+idx, (uint8_t *)layer[top[k]].pix + idx, key[k], w);
+				}
+			} else {
+				lcd_pix_copy(dev->frame_buffer+idx, (color_t *)layer[0].pix + idx, w);
+				for (uint8_t k = 0; k < m; k++) {
+					lcd_pix_copyKey(dev->frame_buffer+idx, (color_t *)layer[top[k]].pix + idx, key[k], w);
+				}
+			}
+		}
+		dirty_add(r->x0, r->y0, r->x1, r->y1);
+	}
+	layer_cur = sel;
+}
+
+void lcd_init(void)
+{
+	if (!screen_selected(__func__)) return;
+	spi_master_init(dev,
+		LCD_MOSI,
+		LCD_SCLK,
+		LCD_CS,
+		LCD_DC,
+		LCD_RST,
+		LCD_BL);
+
+	if (dev->res >= 0) {
+		gpio_set_level(dev->res, 0);
+		delayMS(20);
+		gpio_set_level(dev->res, 1);
+		delayMS(120);
+	}
+
+	dev->width = LCD_W;
+	dev->height = LCD_H;
+	lcd_resetClip();
+	dev->offsetx = LCD_OFFSETX;
+	dev->offsety = LCD_OFFSETY;
+	dev->font_direction = DIRECTION0;
+	dev->font_size = 1;
+	dev->font_back_en = false;
+	dev->font_back_color = BLACK;
+	dev->use_frame_buffer = false;
+	dev->frame_buffer = NULL;
+	dev->frame_back = NULL;
+	dev->fb_native = false;
+	dev->fb_half = false;
+	dev->use_tiles = false;
+	dev->use_palette = false;
+
+#if LCD_DRIVER == 0
+	// spi_master_write_command(dev, 0x01);    // ILI:Software Reset (01h), ST:SWRESET (01h): Software Reset
+	// delayMS(5);
+
+	spi_master_write_command(dev, 0x3A);    // ILI:COLMOD: Pixel Format Set (3Ah), ST:COLMOD (3Ah): Interface Pixel Format
+	spi_master_write_data_byte(dev, 0x55);
+	// delayMS(10);
+
+	spi_master_write_command(dev, 0x36);    // ILI:Memory Access Control (36h), ST:MADCTL (36h): Memory Data Access Control
+	spi_master_write_data_byte(dev, 0x08);  // 0x00
+
+	spi_master_write_command(dev, 0xCF);    // ILI:Power control B (CFh), ILI9341 only
+	spi_master_write_data_byte(dev, 0x00);
+	spi_master_write_data_byte(dev, 0xc3);
+	spi_master_write_data_byte(dev, 0x30);
+	spi_master_write_command(dev, 0xED);    // ILI:Power on sequence control (EDh), ILI9341 only
+	spi_master_write_data_byte(dev, 0x64);
+	spi_master_write_data_byte(dev, 0x03);
+	spi_master_write_data_byte(dev, 0x12);
+	spi_master_write_data_byte(dev, 0x81);
+	spi_master_write_command(dev, 0xE8);    // ILI:Driver timing control A (E8h), ST:PWCTRL2 (E8h): Power Control 2
+	spi_master_write_data_byte(dev, 0x85);
+	spi_master_write_data_byte(dev, 0x00);
+	spi_master_write_data_byte(dev, 0x78);
+	spi_master_write_command(dev, 0xCB);    // ILI:Power control A (CBh), ILI9341 only
+	spi_master_write_data_byte(dev, 0x39);
+	spi_master_write_data_byte(dev, 0x2c);
+	spi_master_write_data_byte(dev, 0x00);
+	spi_master_write_data_byte(dev, 0x34);
+	spi_master_write_data_byte(dev, 0x02);
+	spi_master_write_command(dev, 0xF7);    // ILI:Pump ratio control (F7h), ILI9341 only
+	spi_master_write_data_byte(dev, 0x20);
+	spi_master_write_command(dev, 0xEA);    // ILI:Driver timing control B (EAh), ILI9341 only
+	spi_master_write_data_byte(dev, 0x00);
+	spi_master_write_data_byte(dev, 0x00);
+	spi_master_write_command(dev, 0xC0);    // ILI:Power Control 1 (C0h), ST:LCMCTRL (C0h): LCM Control
+	spi_master_write_data_byte(dev, 0x1B);
+	spi_master_write_command(dev, 0xC1);    // ILI:Power Control 2 (C1h), ST:IDSET (C1h): ID Code Setting
+	spi_master_write_data_byte(dev, 0x12);
+	spi_master_write_command(dev, 0xC5);    // ILI:VCOM Control 1(C5h), ST:VCMOFSET (C5h): VCOM Offset Set
+	spi_master_write_data_byte(dev, 0x32);
+	spi_master_write_data_byte(dev, 0x3C);
+	spi_master_write_command(dev, 0xC7);    // ILI:VCOM Control 2(C7h), ST:CABCCTRL (C7h): CABC Control
+	spi_master_write_data_byte(dev, 0x91);
+	spi_master_write_command(dev, 0xB1);    // ILI:Frame Rate Control (In Normal Mode/Full Colors) (B1h), ST:RGBCTRL (B1h): RGB Interface Control
+	spi_master_write_data_byte(dev, 0x00);
+	spi_master_write_data_byte(dev, 0x10);
+	spi_master_write_command(dev, 0xB6);    // ILI:Display Function Control (B6h), ILI9341 only
+	spi_master_write_data_byte(dev, 0x0A);
+	spi_master_write_data_byte(dev, 0xA2);
+	spi_master_write_command(dev, 0xF6);    // ILI:Interface Control (F6h), ILI9341 only
+	spi_master_write_data_byte(dev, 0x01);
+	spi_master_write_data_byte(dev, 0x30);
+
+	spi_master_write_command(dev, 0x11);    // ILI:Sleep Out (11h), ST:SLPOUT (11h): Sleep Out
+	delayMS(5);
+
+#elif LCD_DRIVER == 1
+
+	// spi_master_write_command(dev, 0x01);  // SWRESET (01h): Software Reset
+	// delayMS(5);
+
+	spi_master_write_command(dev, 0x36);  // MADCTL (36h): Memory Data Access Control
+	spi_master_write_data_byte(dev, 0x00);
+
+	spi_master_write_command(dev, 0x3A);  // COLMOD (3Ah): Interface Pixel Format
+	spi_master_write_data_byte(dev, 0x05);
+
+	spi_master_write_command(dev, 0xB2);  // PORCTRL (B2h): Porch Setting
+	spi_master_write_data_byte(dev, 0x0C);
+	spi_master_write_data_byte(dev, 0x0C);
+	spi_master_write_data_byte(dev, 0x00);
+	spi_master_write_data_byte(dev, 0x33);
+	spi_master_write_data_byte(dev, 0x33);
+
+	spi_master_write_command(dev, 0xB7);  // GCTRL (B7h): Gate Control
+	spi_master_write_data_byte(dev, 0x35);
+
+	spi_master_write_command(dev, 0xBB);  // VCOMS (BBh): VCOM Setting
+	spi_master_write_data_byte(dev, 0x19);
+
+	spi_master_write_command(dev, 0xC0);  // LCMCTRL (C0h): LCM Control
+	spi_master_write_data_byte(dev, 0x2C);
+
+	spi_master_write_command(dev, 0xC2);  // VDVVRHEN (C2h): VDV and VRH Command Enable
+	spi_master_write_data_byte(dev, 0x01);
+
+	spi_master_write_command(dev, 0xC3);  // VRHS (C3h): VRH Set
+	spi_master_write_data_byte(dev, 0x12);
+
+	spi_master_write_command(dev, 0xC4);  // VDVS (C4h): VDV Set
+	spi_master_write_data_byte(dev, 0x20);
+
+	spi_master_write_command(dev, 0xC6);  // FRCTRL2 (C6h): Frame Rate Control in Normal Mode
+	spi_master_write_data_byte(dev, 0x0F);
+
+	spi_master_write_command(dev, 0xD0);  // PWCTRL1 (D0h): Power Control 1
+	spi_master_write_data_byte(dev, 0xA4);
+	spi_master_write_data_byte(dev, 0xA1);
+
+	spi_master_write_command(dev, 0xE0);  // PVGAMCTRL (E0h): Positive Voltage Gamma Control
+	spi_master_write_data_byte(dev, 0xD0);
+	spi_master_write_data_byte(dev, 0x04);
+	spi_master_write_data_byte(dev, 0x0D);
+	spi_master_write_data_byte(dev, 0x11);
+	spi_master_write_data_byte(dev, 0x13);
+	spi_master_write_data_byte(dev, 0x2B);
+	spi_master_write_data_byte(dev, 0x3F);
+	spi_master_write_data_byte(dev, 0x54);
+	spi_master_write_data_byte(dev, 0x4C);
+	spi_master_write_data_byte(dev, 0x18);
+	spi_master_write_data_byte(dev, 0x0D);
+	spi_master_write_data_byte(dev, 0x0B);
+	spi_master_write_data_byte(dev, 0x1F);
+	spi_master_write_data_byte(dev, 0x23);
+
+	spi_master_write_command(dev, 0xE1);  // NVGAMCTRL (E1h): Negative Voltage Gamma Control
+	spi_master_write_data_byte(dev, 0xD0);
+	spi_master_write_data_byte(dev, 0x04);
+	spi_master_write_data_byte(dev, 0x0C);
+	spi_master_write_data_byte(dev, 0x11);
+	spi_master_write_data_byte(dev, 0x13);
+	spi_master_write_data_byte(dev, 0x2C);
+	spi_master_write_data_byte(dev, 0x3F);
+	spi_master_write_data_byte(dev, 0x44);
+	spi_master_write_data_byte(dev, 0x51);
+	spi_master_write_data_byte(dev, 0x2F);
+	spi_master_write_data_byte(dev, 0x1F);
+	spi_master_write_data_byte(dev, 0x1F);
+	spi_master_write_data_byte(dev, 0x20);
+	spi_master_write_data_byte(dev, 0x23);
+
+	spi_master_write_command(dev, 0x11);  // SLPOUT (11h): Sleep Out
+	delayMS(5);
+
+#endif
+
+#if LCD_INV
+	ESP_LOGI(TAG, "Enable Display Inversion");
+	lcd_inversionOn();
+#else
+	lcd_inversionOff();
+#endif
+	lcd_fillScreen(BLACK); // assume use_frame_buffer is false
+	lcd_displayOn();
+	lcd_backlightOn();
+}
+
+//----------------------------------------------------------------------------//
+// Draw (outline) and fill primitives
+//----------------------------------------------------------------------------//
+
+#define min3(a,b,c) (((a) < (b)) ? (((a) < (c)) ? (a) : (c)) : (((b) < (c)) ? (b) : (c)))
+#define max3(a,b,c) (((a) > (b)) ? (((a) > (c)) ? (a) : (c)) : (((b) > (c)) ? (b) : (c)))
+
+// True if a box is entirely outside the clip rectangle.
+static inline bool clip_out(coord_t x0, coord_t y0, coord_t x1, coord_t y1)
+{
+	return x1 < dev->clip_x0 || x0 > dev->clip_x1 || y1 < dev->clip_y0 || y0 > dev->clip_y1;
+}
+
+// Fill a clipped horizontal span of the frame buffer without dirty
+// tracking. The color is in frame buffer order.
+static void fb_span(coord_t x, coord_t y, coord_t w, color_t color)
+{
+	if (y < dev->clip_y0 || y > dev->clip_y1) return;
+	if (x < dev->clip_x0) {w -= dev->clip_x0-x; x = dev->clip_x0;}
+	if (x+w > dev->clip_x1+1) w = dev->clip_x1+1-x;
+	if (w <= 0) return;
+	lcd_pix_fill(fb_row(y)+x, color, w);
+	STAT_PIXELS(w);
+}
+
+void lcd_fillScreen(color_t color)
+{
+	STAT(LCD_STAT_FILL_SCREEN);
+	if (dev->clip_x0 > 0 || dev->clip_y0 > 0 ||
+		dev->clip_x1 < dev->width-1 || dev->clip_y1 < dev->height-1) {
+		lcd_fillRect(0, 0, dev->width, dev->height, color);
+		return;
+	}
+	STAT_PIXELS((size_t)dev->width*dev->height);
+	if (dev->use_frame_buffer) {
+		dirty_fill(color);
+		lcd_pix_fill(fb_base(), FB_COLOR(color), (size_t)dev->width*dev->height);
+	} else if (dev->use_tiles) {
+		lcd_tile_clear(&tile_list, color);
+	} else if (dev->use_palette) {
+		dirty_fill(color);
+		memset(pal_row(0), pal_index(color), (size_t)dev->width*dev->height);
+	} else {
+		stream_window(dev->offsetx, dev->offsety,
+			dev->offsetx+dev->width-1, dev->offsety+dev->height-1);
+		stream_color(color, (size_t)dev->width*dev->height);
+	}
+}
+
+void lcd_drawPixel(coord_t x, coord_t y, color_t color)
+{
+	STAT(LCD_STAT_PIXEL);
+	if (x < dev->clip_x0 || x > dev->clip_x1) return; // clipped
+	if (y < dev->clip_y0 || y > dev->clip_y1) return;
+	STAT_PIXELS(1);
+
+	if (dev->use_frame_buffer) {
+		fb_row(y)[x] = FB_COLOR(color);
+		dirty_add(x, y, x, y);
+	} else if (dev->use_tiles) {
+		lcd_tile_rect(&tile_list, x, y, 1, 1, color);
+	} else if (dev->use_palette) {
+		pal_row(y)[x] = pal_index(color);
+		dirty_add(x, y, x, y);
+	} else {
+		coord_t _x = x + dev->offsetx;
+		coord_t _y = y + dev->offsety;
+
+		stream_window(_x, _y, _x, _y);
+		stream_color(color, 1);
+	}
+}
+
+void lcd_drawHPixels(coord_t x, coord_t y, coord_t w, const color_t *colors)
+{
+	STAT(LCD_STAT_PIXEL);
+	if (x+w <= dev->clip_x0 || x > dev->clip_x1) return; // clipped
+	if (y < dev->clip_y0 || y > dev->clip_y1) return;
+
+	if (x < dev->clip_x0) {w -= dev->clip_x0-x; colors += dev->clip_x0-x; x = dev->clip_x0;} // clip
+	if (x+w > dev->clip_x1+1) w = dev->clip_x1+1-x;
+	STAT_PIXELS(w);
+
+	if (dev->use_frame_buffer) {
+		coord_t _x1 = x;
+		coord_t _x2 = _x1 + (w-1);
+		color_t *row = fb_row(y);
+		if (dev->fb_native) {
+			lcd_pix_copySwap(row+_x1, colors, w);
+		} else {
+			lcd_pix_copy(row+_x1, colors, w);
+		}
+		dirty_add(_x1, y, _x2, y);
+	} else if (dev->use_tiles) {
+		lcd_tile_pixels(&tile_list, x, y, w, colors);
+	} else if (dev->use_palette) {
+		pal_pixels(x, y, w, colors);
+	} else {
+		coord_t _x1 = x + dev->offsetx;
+		coord_t _x2 = _x1 + (w-1);
+		coord_t _y1 = y + dev->offsety;
+		coord_t _y2 = _y1;
+
+		stream_window(_x1, _y1, _x2, _y2);
+		stream_colors(colors, w);
+	}
+}
+
+void lcd_drawHLine(coord_t x, coord_t y, coord_t w, color_t color)
+{
+	STAT(LCD_STAT_HVLINE);
+	if (x+w <= dev->clip_x0 || x > dev->clip_x1) return; // clipped
+	if (y < dev->clip_y0 || y > dev->clip_y1) return;
+
+	if (x < dev->clip_x0) {w -= dev->clip_x0-x; x = dev->clip_x0;} // clip
+	if (x+w > dev->clip_x1+1) w = dev->clip_x1+1-x;
+	STAT_PIXELS(w);
+
+	if (dev->use_frame_buffer) {
+		coord_t _x1 = x;
+		coord_t _x2 = _x1 + (w-1);
+		lcd_pix_fill(fb_row(y)+_x1, FB_COLOR(color), w);
+		dirty_add(_x1, y, _x2, y);
+	} else if (dev->use_tiles) {
+		lcd_tile_rect(&tile_list, x, y, w, 1, color);
+	} else if (dev->use_palette) {
+		pal_rect(x, y, x+w-1, y, color);
+	} else {
+		coord_t _x1 = x + dev->offsetx;
+		coord_t _x2 = _x1 + (w-1);
+		coord_t _y1 = y + dev->offsety;
+		coord_t _y2 = _y1;
+
+		stream_window(_x1, _y1, _x2, _y2);
+		stream_color(color, w);
+	}
+}
+
+void lcd_drawVLine(coord_t x, coord_t y, coord_t h, color_t color)
+{
+	STAT(LCD_STAT_HVLINE);
+	coord_t y2 = y+h-1;
+	if (x < dev->clip_x0 || x > dev->clip_x1) return; // clipped
+	if (y2 < dev->clip_y0 || y > dev->clip_y1) return;
+
+	if (y < dev->clip_y0) y = dev->clip_y0; // clip
+	if (y2 > dev->clip_y1) y2 = dev->clip_y1;
+	STAT_PIXELS(y2-y+1);
+
+	if (dev->use_frame_buffer) {
+		color = FB_COLOR(color);
+		for (coord_t j = y; j <= y2; j++){
+			fb_row(j)[x] = color;
+		}
+		dirty_add(x, y, x, y2);
+	} else if (dev->use_tiles) {
+		lcd_tile_rect(&tile_list, x, y, 1, y2-y+1, color);
+	} else if (dev->use_palette) {
+		pal_rect(x, y, x, y2, color);
+	} else {
+		coord_t _x1 =  x  + dev->offsetx;
+		coord_t _y1 =  y  + dev->offsety;
+		coord_t _y2 =  y2 + dev->offsety;
+		size_t size = _y2-_y1+1;
+
+		stream_window(_x1, _y1, _x1, _y2);
+		stream_color(color, size);
+	}
+}
+
+// Limit the steps k0..k1 along the major axis of a line to those whose
+// minor axis offset is within t..u. Bresenham with initial error e0 has
+// made ceil((k*dy-e0)/dx) minor steps after k major steps. Returns false
+// if no step is left.
+static bool line_clip(coord_t dx, coord_t dy, coord_t e0, coord_t t, coord_t u, coord_t *k0, coord_t *k1)
+{
+	if (u < 0) return false;
+	if (dy == 0) return t <= 0 && *k0 <= *k1;
+	if (t > 0) {
+		int64_t k = ((int64_t)(t-1)*dx + e0)/dy + 1;
+		if (k > *k1) return false;
+		if (k > *k0) *k0 = k;
+	}
+	int64_t k = ((int64_t)u*dx + e0)/dy;
+	if (k < *k1) *k1 = k;
+	return *k0 <= *k1;
+}
+
+/**
+ * @note Bresenham's algorithm from Wikipedia. Speed enhanced by Bodmer to use
+ *  efficient H/V Line draw routines for line segments of 2 pixels or more.
+ *  The line is clipped before it is walked, with the error term set to
+ *  where the unclipped line would have it, so the same pixels are drawn.
+ */
+void lcd_drawLine(coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color)
+{
+	STAT(LCD_STAT_LINE);
+	bool steep = abs(y1 - y0) > abs(x1 - x0);
+	if (steep) {
+		swap(coord_t, x0, y0);
+		swap(coord_t, x1, y1);
+	}
+
+	if (x0 > x1) {
+		swap(coord_t, x0, x1);
+		swap(coord_t, y0, y1);
+	}
+
+	coord_t dx = x1 - x0, dy = abs(y1 - y0);
+
+	coord_t err = dx >> 1, ystep = -1, xs, dlen = 0;
+
+	if (y0 < y1) ystep = 1;
+
+	// Clip limits along the major (x) and minor (y) axes
+	coord_t lo = steep ? dev->clip_y0 : dev->clip_x0;
+	coord_t hi = steep ? dev->clip_y1 : dev->clip_x1;
+	coord_t nlo = steep ? dev->clip_x0 : dev->clip_y0;
+	coord_t nhi = steep ? dev->clip_x1 : dev->clip_y1;
+	coord_t k0 = (lo > x0) ? lo-x0 : 0;
+	coord_t k1 = (hi < x1) ? hi-x0 : dx;
+	if (ystep > 0) {
+		if (!line_clip(dx, dy, err, nlo-y0, nhi-y0, &k0, &k1)) return;
+	} else {
+		if (!line_clip(dx, dy, err, y0-nhi, y0-nlo, &k0, &k1)) return;
+	}
+	if (k0 > 0) { // skip ahead to the first step inside
+		coord_t n = ((int64_t)k0*dy - err + dx - 1)/dx;
+		err += n*dx - k0*dy;
+		y0 += n*ystep;
+	}
+	x1 = x0 + k1;
+	x0 += k0;
+	xs = x0;
+
+	// Split into steep and not steep for FastH/V separation
+	if (steep) {
+		for (; x0 <= x1; x0++) {
+			dlen++;
+			err -= dy;
+			if (err < 0) {
+				if (dlen == 1) lcd_drawPixel(y0, xs, color);
+				else lcd_drawVLine(y0, xs, dlen, color);
+				dlen = 0;
+				y0 += ystep; xs = x0 + 1;
+				err += dx;
+			}
+		}
+		if (dlen) lcd_drawVLine(y0, xs, dlen, color);
+	}
+	else
+	{
+		for (; x0 <= x1; x0++) {
+			dlen++;
+			err -= dy;
+			if (err < 0) {
+				if (dlen == 1) lcd_drawPixel(xs, y0, color);
+				else lcd_drawHLine(xs, y0, dlen, color);
+				dlen = 0;
+				y0 += ystep; xs = x0 + 1;
+				err += dx;
+			}
+		}
+		if (dlen) lcd_drawHLine(xs, y0, dlen, color);
+	}
+}
+
+void lcd_drawRect(coord_t x, coord_t y, coord_t w, coord_t h, color_t color)
+{
+	STAT(LCD_STAT_RECT);
+	lcd_drawHLine(x,     y,     w, color);
+	lcd_drawHLine(x,     y+h-1, w, color);
+	lcd_drawVLine(x,     y,     h, color);
+	lcd_drawVLine(x+w-1, y,     h, color);
+}
+
+void lcd_fillRect(coord_t x, coord_t y, coord_t w, coord_t h, color_t color)
+{
+	STAT(LCD_STAT_FILL_RECT);
+	coord_t x1 = x+w-1;
+	coord_t y1 = y+h-1;
+
+	if (clip_out(x, y, x1, y1)) return;
+
+	if (x < dev->clip_x0) x = dev->clip_x0; // clip
+	if (x1 > dev->clip_x1) x1 = dev->clip_x1;
+	if (y < dev->clip_y0) y = dev->clip_y0;
+	if (y1 > dev->clip_y1) y1 = dev->clip_y1;
+	STAT_PIXELS((size_t)(x1-x+1)*(y1-y+1));
+
+	if (dev->use_frame_buffer) {
+		color = FB_COLOR(color);
+		for (coord_t j = y; j <= y1; j++){
+			lcd_pix_fill(fb_row(j)+x, color, x1-x+1);
+		}
+		dirty_add(x, y, x1, y1);
+	} else if (dev->use_tiles) {
+		lcd_tile_rect(&tile_list, x, y, x1-x+1, y1-y+1, color);
+	} else if (dev->use_palette) {
+		pal_rect(x, y, x1, y1, color);
+	} else {
+		coord_t _x0 = x  + dev->offsetx;
+		coord_t _x1 = x1 + dev->offsetx;
+		coord_t _y0 = y  + dev->offsety;
+		coord_t _y1 = y1 + dev->offsety;
+		size_t size = (size_t)(_x1-_x0+1)*(_y1-_y0+1);
+
+		stream_window(_x0, _y0, _x1, _y1);
+		stream_color(color, size);
+	}
+}
+
+void lcd_drawTriangle(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t x2, coord_t y2, color_t color)
+{
+	STAT(LCD_STAT_TRIANGLE);
+	if (clip_out(min3(x0, x1, x2), min3(y0, y1, y2), max3(x0, x1, x2), max3(y0, y1, y2))) return;
+	lcd_drawLine(x0, y0, x1, y1, color);
+	lcd_drawLine(x1, y1, x2, y2, color);
+	lcd_drawLine(x2, y2, x0, y0, color);
+}
+
+// Triangle edge walked down one row at a time. Its x position is
+// x + rem/h: a DDA whose fraction is kept in units of 1/h rather than in
+// Q16. A Q16 slope is off by up to one unit per row, and on an edge of h
+// rows it must stay within 1/h of the true x for the fill rule to hold, so
+// Q16 gives wrong pixels from about 256 rows. Both cost an add and a
+// compare per row and one division per edge.
+typedef struct {
+	coord_t x, rem; // position
+	coord_t dx, drem; // step per row
+	coord_t h; // height of the edge
+} edge_t;
+
+// Floor division for a positive divisor.
+static inline int64_t div_floor(int64_t n, coord_t d)
+{
+	int64_t q = n / d;
+	return (q*d > n) ? q-1 : q;
+}
+
+// Start an edge from (xa,ya) to (xb,yb) at row y.
+static inline void edge_init(edge_t *e, coord_t xa, coord_t ya, coord_t xb, coord_t yb, coord_t y)
+{
+	int64_t n = (int64_t)(xb-xa)*(y-ya);
+	int64_t q = div_floor(n, yb-ya);
+	e->h = yb-ya;
+	e->x = xa + q;
+	e->rem = n - q*e->h;
+	e->dx = div_floor(xb-xa, e->h);
+	e->drem = (xb-xa) - e->dx*e->h;
+}
+
+static inline void edge_step(edge_t *e)
+{
+	e->x += e->dx;
+	e->rem += e->drem;
+	if (e->rem >= e->h) {e->rem -= e->h; e->x++;}
+}
+
+// Fill rows y to y_end-1 between a left and a right edge. Pixel centers on
+// a left edge are filled and on a right edge are not.
+static void edge_fill(edge_t *l, edge_t *r, coord_t y, coord_t y_end, color_t color, rect_t *box)
+{
+	for (; y < y_end; y++, edge_step(l), edge_step(r)) {
+		coord_t xs = l->x + (l->rem != 0); // ceil
+		coord_t xe = r->x + (r->rem != 0) - 1;
+		if (xs < dev->clip_x0) xs = dev->clip_x0;
+		if (xe > dev->clip_x1) xe = dev->clip_x1;
+		if (xs > xe) continue;
+		if (dev->use_frame_buffer) {
+			lcd_pix_fill(fb_row(y)+xs, color, xe-xs+1);
+			STAT_PIXELS(xe-xs+1);
+			if (xs < box->x0) box->x0 = xs;
+			if (xe > box->x1) box->x1 = xe;
+			if (y < box->y0) box->y0 = y;
+			box->y1 = y;
+		} else {
+			lcd_drawHLine(xs, y, xe-xs+1, color);
+		}
+	}
+}
+
+/**
+ * @details Edges are stepped incrementally in integer arithmetic, so there
+ *  is one division per edge and none per row. Pixels whose centers lie
+ *  inside are filled, with the top-left rule for centers on an edge, so
+ *  triangles that share an edge do not overlap. Spans used to run from the
+ *  truncated left x to the truncated right x inclusive, down to and
+ *  including the last row; pixels on the right and bottom edges are now
+ *  left out, and a triangle with no area draws nothing.
+ */
+void lcd_fillTriangle(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t x2, coord_t y2, color_t color)
+{
+	STAT(LCD_STAT_FILL_TRIANGLE);
+
+	// Sort coordinates by Y order (y2 >= y1 >= y0)
+	if (y0 > y1) {
+		swap(coord_t, y0, y1); swap(coord_t, x0, x1);
+	}
+	if (y1 > y2) {
+		swap(coord_t, y2, y1); swap(coord_t, x2, x1);
+	}
+	if (y0 > y1) {
+		swap(coord_t, y0, y1); swap(coord_t, x0, x1);
+	}
+
+	// Trivially reject triangles clipped or with no area.
+	if (clip_out(min3(x0, x1, x2), y0, max3(x0, x1, x2), y2)) return;
+	int64_t cross = (int64_t)(x1-x0)*(y2-y0) - (int64_t)(x2-x0)*(y1-y0);
+	if (cross == 0) return;
+
+	// Edge 0-2 spans all rows. Vertex 1 is on its right if cross > 0.
+	coord_t ye = (y2 > dev->clip_y1) ? dev->clip_y1+1 : y2;
+	coord_t ys = (y0 < dev->clip_y0) ? dev->clip_y0 : y0;
+	coord_t ym = (y1 < ys) ? ys : (y1 > ye) ? ye : y1;
+	edge_t e02, e;
+	edge_t *l = (cross > 0) ? &e02 : &e;
+	edge_t *r = (cross > 0) ? &e : &e02;
+	rect_t box = {dev->width, dev->height, -1, -1};
+
+	if (dev->use_frame_buffer) color = FB_COLOR(color);
+	edge_init(&e02, x0, y0, x2, y2, ys);
+	if (ys < ym) {
+		edge_init(&e, x0, y0, x1, y1, ys);
+		edge_fill(l, r, ys, ym, color, &box);
+	}
+	if (ym < ye) {
+		edge_init(&e, x1, y1, x2, y2, ym);
+		edge_fill(l, r, ym, ye, color, &box);
+	}
+	if (dev->use_frame_buffer && box.x1 >= 0) dirty_add(box.x0, box.y0, box.x1, box.y1);
+}
+
+void lcd_drawCircle(coord_t xc, coord_t yc, coord_t r, color_t color)
+{
+	STAT(LCD_STAT_CIRCLE);
+	coord_t x;
+	coord_t y;
+	coord_t err;
+	coord_t old_err;
+
+	if (clip_out(xc-r, yc-r, xc+r, yc+r)) return;
+
+	x=0;
+	y=-r;
+	err=2-2*r;
+	do {
+		lcd_drawPixel(xc-x, yc+y, color);
+		lcd_drawPixel(xc-y, yc-x, color);
+		lcd_drawPixel(xc+x, yc-y, color);
+		lcd_drawPixel(xc+y, yc+x, color);
+		if ((old_err=err)<=x)   err+=++x*2+1;
+		if (old_err>y || err>x) err+=++y*2+1;
+	} while (y<0);
+}
+
+// Fill a band of rows dy_hi down to dy_lo above yt and below yb, hw pixels
+// beyond xl and xr. A band reaching dy 0 also covers the rows in between.
+static void round_band(coord_t xl, coord_t yt, coord_t xr, coord_t yb,
+	coord_t dy_hi, coord_t dy_lo, coord_t hw, color_t color)
+{
+	coord_t w = xr-xl+1+(hw<<1);
+	if (dy_lo == 0) {
+		lcd_fillRect(xl-hw, yt-dy_hi, w, yb-yt+1+(dy_hi<<1), color);
+	} else {
+		lcd_fillRect(xl-hw, yt-dy_hi, w, dy_hi-dy_lo+1, color);
+		lcd_fillRect(xl-hw, yb+dy_lo, w, dy_hi-dy_lo+1, color);
+	}
+}
+
+// Fill four quarter circles of radius r centered on the corners (xl,yt),
+// (xr,yt), (xl,yb), (xr,yb) and the area between them. Row widths come
+// from the midpoint circle of lcd_drawCircle(). Each row is written once,
+// and rows of equal width are merged into one rectangle.
+static void fill_round(coord_t xl, coord_t yt, coord_t xr, coord_t yb, coord_t r, color_t color)
+{
+	coord_t x = 0, y = -r, err = 2-2*r, old_err;
+	coord_t band_dy = r, band_hw = 0; // current run of rows of equal width
+
+	if (r < 0 || clip_out(xl-r, yt-r, xr+r, yb+r)) return;
+	do {
+		coord_t dy = -y, hw = x;
+		if ((old_err=err)<=x)   err+=++x*2+1;
+		if (old_err>y || err>x) err+=++y*2+1;
+		if (y == -dy) continue; // row dy may still widen
+		if (hw != band_hw) {
+			round_band(xl, yt, xr, yb, band_dy, dy+1, band_hw, color);
+			band_dy = dy;
+			band_hw = hw;
+		}
+	} while (y<=0);
+	round_band(xl, yt, xr, yb, band_dy, 0, band_hw, color);
+}
+
+void lcd_fillCircle(coord_t xc, coord_t yc, coord_t r, color_t color)
+{
+	STAT(LCD_STAT_FILL_CIRCLE);
+	fill_round(xc, yc, xc, yc, r, color);
+}
+
+void lcd_drawRoundRect(coord_t x, coord_t y, coord_t w, coord_t h, coord_t r, color_t color)
+{
+	STAT(LCD_STAT_ROUND_RECT);
+	coord_t x1 = x+w-1;
+	coord_t y1 = y+h-1;
+	coord_t xa;
+	coord_t ya;
+	coord_t err;
+	coord_t old_err;
+
+	w -= (r<<1);
+	h -= (r<<1);
+	if (w < 1 || h < 1) return;
+	if (clip_out(x, y, x1, y1)) return;
+
+	xa=0;
+	ya=-r;
+	err=2-2*r;
+
+	do {
+		if (xa) {
+			lcd_drawPixel(x+r-xa,  y+r+ya,  color);
+			lcd_drawPixel(x1-r+xa, y+r+ya,  color);
+			lcd_drawPixel(x+r-xa,  y1-r-ya, color);
+			lcd_drawPixel(x1-r+xa, y1-r-ya, color);
+		}
+		if ((old_err=err)<=xa)    err+=++xa*2+1;
+		if (old_err>ya || err>xa) err+=++ya*2+1;
+	} while (ya<0);
+	lcd_drawHLine(x+r, y,   w, color);
+	lcd_drawHLine(x+r, y1,  w, color);
+	lcd_drawVLine(x,   y+r, h, color);
+	lcd_drawVLine(x1,  y+r, h, color);
+}
+
+void lcd_fillRoundRect(coord_t x, coord_t y, coord_t w, coord_t h, coord_t r, color_t color)
+{
+	STAT(LCD_STAT_FILL_ROUND_RECT);
+	coord_t w1 = w-(r<<1);
+	coord_t h1 = h-(r<<1);
+	if (w1 < 1 || h1 < 1) return;
+
+	fill_round(x+r, y+r, x+r+w1-1, y+r+h1-1, r, color);
+}
+
+// Find the left, right and center points of the base of an arrow head of
+// half width w at x1,y1. The head is 3*w high, limited to the arrow length.
+// Lengths are kept in Q8 so the points round as they would in floating point.
+static void arrow_head(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t w,
+	coord_t L[2], coord_t R[2], coord_t C[2])
+{
+	int64_t vx = x1 - x0; // basic vector
+	int64_t vy = y1 - y0;
+	int64_t v = fx_isqrt((uint64_t)(vx*vx+vy*vy) << 16); // basic vector length, Q8
+	int64_t h = (int64_t)w*3*256; // arrow head height, Q8
+
+	if (h > v) h = v; // clip arrow head height to vector length
+	if (v == 0) v = 1; // no direction, the head collapses to x1,y1
+
+	// Unit vector scaled by the head height and half width, Q8. Scaled by
+	// multiplying, as vx and vy may be negative.
+	int64_t uxh = vx*h*256/v, uyh = vy*h*256/v;
+	int64_t uxw = vx*w*65536/v, uyw = vy*w*65536/v;
+	L[0] = x1 + ((-uyw - uxh + 128) >> 8);
+	L[1] = y1 + (( uxw - uyh + 128) >> 8);
+	R[0] = x1 + (( uyw - uxh + 128) >> 8);
+	R[1] = y1 + ((-uxw - uyh + 128) >> 8);
+	C[0] = x1 + ((-uxh + 128) >> 8);
+	C[1] = y1 + ((-uyh + 128) >> 8);
+}
+
+/**
+ * @details See this [link](http://k-hiura.cocolog-nifty.com/blog/2010/11/post-2a62.html)
+    for implementation details.
+ */
+void lcd_drawArrow(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t w, color_t color)
+{
+	STAT(LCD_STAT_ARROW);
+	coord_t L[2],R[2],C[2]; // left, right, center arrow head base
+	arrow_head(x0, y0, x1, y1, w, L, R, C);
+
+	lcd_drawLine(x0, y0, C[0], C[1], color);
+	lcd_drawTriangle(x1, y1, L[0], L[1], R[0], R[1], color);
+}
+
+/**
+ * @details See this [link](http://k-hiura.cocolog-nifty.com/blog/2010/11/post-2a62.html)
+    for implementation details.
+ */
+void lcd_fillArrow(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t w, color_t color)
+{
+	STAT(LCD_STAT_ARROW);
+	coord_t L[2],R[2],C[2]; // left, right, center arrow head base
+	arrow_head(x0, y0, x1, y1, w, L, R, C);
+
+	lcd_drawLine(x0, y0, C[0], C[1], color);
+	lcd_fillTriangle(x1, y1, L[0], L[1], R[0], R[1], color);
+}
+
+// Find the end of a run of bits equal to set in a bitmap scanline,
+// starting at bit i. Whole bytes are skipped at a time.
+static coord_t bit_run(const uint8_t *line, coord_t i, coord_t w, bool set)
+{
+	uint8_t full = set ? 0xFF : 0x00;
+	while (i < w) {
+		if (!(i & 7) && i+8 <= w && line[i >> 3] == full) {
+			i += 8;
+		} else if (((line[i >> 3] >> (7 - (i & 7))) & 1) == set) {
+			i++;
+		} else {
+			break;
+		}
+	}
+	return i;
+}
+
+// Draw a span of set pixels from a monochrome bitmap. With a frame buffer,
+// the caller marks the whole bitmap dirty afterwards.
+static void bitmap_span(coord_t x, coord_t y, coord_t w, color_t color)
+{
+	if (dev->use_frame_buffer) fb_span(x, y, w, FB_COLOR(color));
+	else lcd_drawHLine(x, y, w, color);
+}
+
+void lcd_drawBitmap(coord_t x, coord_t y, const uint8_t *bitmap, coord_t w, coord_t h, color_t color)
+{
+	STAT(LCD_STAT_BITMAP);
+	coord_t byteWidth = (w + 7) / 8; // pad bitmap scanline to whole byte
+
+	if (clip_out(x, y, x+w-1, y+h-1)) return;
+
+	for (coord_t j = 0; j < h; j++) {
+		const uint8_t *line = bitmap + j*byteWidth;
+		for (coord_t i = bit_run(line, 0, w, false); i < w; ) {
+			coord_t end = bit_run(line, i, w, true);
+			bitmap_span(x+i, y+j, end-i, color);
+			i = bit_run(line, end, w, false);
+		}
+	}
+	if (dev->use_frame_buffer) lcd_markDirty(x, y, w, h);
+}
+
+lcd_rle_t *lcd_rleEncode(const uint8_t *bitmap, coord_t w, coord_t h)
+{
+	coord_t byteWidth = (w + 7) / 8;
+	size_t runs = 0;
+	lcd_rle_t *rle = NULL;
+
+	if (w <= 0 || h <= 0) return NULL;
+	for (int pass = 0; pass < 2; pass++) {
+		lcd_run_t *run = NULL;
+		uint16_t *row = NULL;
+		if (pass) { // one block: header, row index, then runs
+			size_t idx_bytes = ((h+1)*sizeof(uint16_t) + 3) & ~(size_t)3;
+			rle = heap_caps_malloc(sizeof(lcd_rle_t) + idx_bytes + runs*sizeof(lcd_run_t), MALLOC_CAP_8BIT);
+			if (rle == NULL) return NULL;
+			row = (uint16_t *)(rle+1);
+			run = (lcd_run_t *)((uint8_t *)row + idx_bytes);
+			rle->w = w;
+			rle->h = h;
+			rle->row = row;
+			rle->run = run;
+		}
+		runs = 0;
+		for (coord_t j = 0; j < h; j++) {
+			const uint8_t *line = bitmap + j*byteWidth;
+			if (pass) row[j] = runs;
+			for (coord_t i = bit_run(line, 0, w, false); i < w; ) {
+				coord_t end = bit_run(line, i, w, true);
+				if (pass) run[runs] = (lcd_run_t){i, end-i};
+				runs++;
+				i = bit_run(line, end, w, false);
+			}
+		}
+		if (pass) row[h] = runs;
+		else if (runs > UINT16_MAX) return NULL;
+	}
+	return rle;
+}
+
+void lcd_rleFree(lcd_rle_t *rle)
+{
+	heap_caps_free(rle);
+}
+
+void lcd_drawBitmapRLE(coord_t x, coord_t y, const lcd_rle_t *rle, color_t color)
+{
+	STAT(LCD_STAT_BITMAP);
+	if (clip_out(x, y, x+rle->w-1, y+rle->h-1)) return;
+
+	for (coord_t j = 0; j < rle->h; j++) {
+		for (uint16_t k = rle->row[j]; k < rle->row[j+1]; k++) {
+			bitmap_span(x+rle->run[k].x, y+j, rle->run[k].len, color);
+		}
+	}
+	if (dev->use_frame_buffer) lcd_markDirty(x, y, rle->w, rle->h);
+}
+
+void lcd_drawBitmapRLEOpaque(coord_t x, coord_t y, const lcd_rle_t *rle, color_t color, color_t bg)
+{
+	STAT(LCD_STAT_BITMAP);
+	coord_t w = rle->w, h = rle->h;
+
+	if (dev->use_tiles || dev->use_palette || x < dev->clip_x0 || x+w-1 > dev->clip_x1 ||
+		y < dev->clip_y0 || y+h-1 > dev->clip_y1) {
+		// Clipped, draw the background then the set pixels.
+		lcd_fillRect(x, y, w, h, bg);
+		lcd_drawBitmapRLE(x, y, rle, color);
+		return;
+	}
+	STAT_PIXELS((size_t)w*h);
+	if (dev->use_frame_buffer) {
+		color = FB_COLOR(color);
+		bg = FB_COLOR(bg);
+		for (coord_t j = 0; j < h; j++) {
+			color_t *line = fb_row(y+j) + x;
+			lcd_pix_fill(line, bg, w);
+			for (uint16_t k = rle->row[j]; k < rle->row[j+1]; k++) {
+				lcd_pix_fill(line+rle->run[k].x, color, rle->run[k].len);
+			}
+		}
+		dirty_add(x, y, x+w-1, y+h-1);
+	} else {
+		// One address window, rows packed into as few transfers as fit.
+		coord_t rows = (STREAM_BYTES/2)/(w*sizeof(color_t));
+		color = SWAP16(color);
+		bg = SWAP16(bg);
+		stream_window(x+dev->offsetx, y+dev->offsety,
+			x+w-1+dev->offsetx, y+h-1+dev->offsety);
+		stream_advance((size_t)w*h);
+		for (coord_t j = 0; j < h; ) {
+			coord_t m = (h-j < rows) ? h-j : rows;
+			size_t bytes = (size_t)m*w*sizeof(color_t);
+			color_t *line = stream_reserve(bytes);
+			void *data = line;
+			for (coord_t i = 0; i < m; i++, j++, line += w) {
+				lcd_pix_fill(line, bg, w);
+				for (uint16_t k = rle->row[j]; k < rle->row[j+1]; k++) {
+					lcd_pix_fill(line+rle->run[k].x, color, rle->run[k].len);
+				}
+			}
+			trans_queue(data, bytes, TRANS_DC_DATA);
+		}
+	}
+}
+
+// Runs of one color at least this long are stored as fills.
+#define RLE_FILL_MIN 4
+
+// Length of the run of pixels equal to line[i], at most n.
+static coord_t same_run(const color_t *line, coord_t i, coord_t n)
+{
+	coord_t j = i+1;
+	while (j < n && line[j] == line[i]) j++;
+	return j-i;
+}
+
+// Encode either a color image (bitmap, key) or a monochrome one (mono,
+// color) in two passes: count runs and pixels, then fill one block.
+static lcd_rle_rgb_t *rle_encode_rgb(const color_t *bitmap, const uint8_t *mono,
+	coord_t w, coord_t h, color_t color)
+{
+	size_t runs = 0, pixels = 0;
+	lcd_rle_rgb_t *rle = NULL;
+
+	if (w <= 0 || h <= 0 || w >= LCD_RUN_FILL) return NULL;
+	for (int pass = 0; pass < 2; pass++) {
+		lcd_rgb_run_t *run = NULL;
+		uint16_t *row = NULL;
+		color_t *pix = NULL;
+		if (pass) { // one block: header, row index, runs, then pixels
+			size_t idx_bytes = ((h+1)*sizeof(uint16_t) + 3) & ~(size_t)3;
+			rle = heap_caps_malloc(sizeof(lcd_rle_rgb_t) + idx_bytes +
+				runs*sizeof(lcd_rgb_run_t) + pixels*sizeof(color_t), MALLOC_CAP_8BIT);
+			if (rle == NULL) return NULL;
+			row = (uint16_t *)(rle+1);
+			run = (lcd_rgb_run_t *)((uint8_t *)row + idx_bytes);
+			pix = (color_t *)(run + runs);
+			rle->w = w;
+			rle->h = h;
+			rle->row = row;
+			rle->run = run;
+			rle->pix = pix;
+		}
+		runs = pixels = 0;
+		for (coord_t j = 0; j < h; j++) {
+			if (pass) row[j] = runs;
+			if (mono != NULL) {
+				const uint8_t *line = mono + j*((w + 7) / 8);
+				for (coord_t i = bit_run(line, 0, w, false); i < w; ) {
+					coord_t end = bit_run(line, i, w, true);
+					if (pass) run[runs] = (lcd_rgb_run_t){i, (end-i) | LCD_RUN_FILL, color};
+					runs++;
+					i = bit_run(line, end, w, false);
+				}
+				continue;
+			}
+			const color_t *line = bitmap + (size_t)j*w;
+			for (coord_t i = 0; i < w; ) {
+				if (line[i] == color) {i++; continue;} // transparent
+				coord_t n = same_run(line, i, w);
+				if (n >= RLE_FILL_MIN) {
+					if (pass) run[runs] = (lcd_rgb_run_t){i, n | LCD_RUN_FILL, line[i]};
+					runs++;
+					i += n;
+					continue;
+				}
+				// Literal pixels up to the next transparent pixel or fill.
+				coord_t end = i;
+				while (end < w && line[end] != color && same_run(line, end, w) < RLE_FILL_MIN) {
+					end += same_run(line, end, w);
+				}
+				if (pass) {
+					run[runs] = (lcd_rgb_run_t){i, end-i, pixels};
+					memcpy(pix+pixels, line+i, (end-i)*sizeof(color_t));
+				}
+				runs++;
+				pixels += end-i;
+				i = end;
+			}
+		}
+		if (pass) row[h] = runs;
+		else if (runs > UINT16_MAX) return NULL;
+	}
+	return rle;
+}
+
+lcd_rle_rgb_t *lcd_rleEncodeRGB(const color_t *bitmap, coord_t w, coord_t h, color_t key)
+{
+	return rle_encode_rgb(bitmap, NULL, w, h, key);
+}
+
+lcd_rle_rgb_t *lcd_rleEncodeMonoRGB(const uint8_t *bitmap, coord_t w, coord_t h, color_t color)
+{
+	return rle_encode_rgb(NULL, bitmap, w, h, color);
+}
+
+void lcd_rleFreeRGB(lcd_rle_rgb_t *rle)
+{
+	heap_caps_free(rle);
+}
+
+// Store a clipped horizontal run of colors in the frame buffer without
+// dirty tracking.
+static void fb_pixels(coord_t x, coord_t y, coord_t w, const color_t *colors)
+{
+	if (y < dev->clip_y0 || y > dev->clip_y1) return;
+	if (x < dev->clip_x0) {w -= dev->clip_x0-x; colors += dev->clip_x0-x; x = dev->clip_x0;}
+	if (x+w > dev->clip_x1+1) w = dev->clip_x1+1-x;
+	if (w <= 0) return;
+	if (dev->fb_native) lcd_pix_copySwap(fb_row(y)+x, colors, w);
+	else lcd_pix_copy(fb_row(y)+x, colors, w);
+	STAT_PIXELS(w);
+}
+
+void lcd_drawRGBBitmapRLE(coord_t x, coord_t y, const lcd_rle_rgb_t *rle)
+{
+	STAT(LCD_STAT_RGB_BITMAP);
+	if (clip_out(x, y, x+rle->w-1, y+rle->h-1)) return;
+
+	for (coord_t j = 0; j < rle->h; j++) {
+		for (uint16_t k = rle->row[j]; k < rle->row[j+1]; k++) {
+			const lcd_rgb_run_t *r = &rle->run[k];
+			coord_t len = r->len & ~LCD_RUN_FILL;
+			if (r->len & LCD_RUN_FILL) bitmap_span(x+r->x, y+j, len, r->pix);
+			else if (dev->use_frame_buffer) fb_pixels(x+r->x, y+j, len, rle->pix+r->pix);
+			else lcd_drawHPixels(x+r->x, y+j, len, rle->pix+r->pix);
+		}
+	}
+	if (dev->use_frame_buffer) lcd_markDirty(x, y, rle->w, rle->h);
+}
+
+void lcd_drawRGBBitmap(coord_t x, coord_t y, const color_t *bitmap, coord_t w, coord_t h)
+{
+	STAT(LCD_STAT_RGB_BITMAP);
+	lcd_drawRGBBitmapRect(x, y, bitmap, w, 0, 0, w, h);
+}
+
+void lcd_drawRGBBitmapRect(coord_t x, coord_t y, const color_t *bitmap, coord_t stride,
+	coord_t sx, coord_t sy, coord_t w, coord_t h)
+{
+	STAT(LCD_STAT_RGB_BITMAP);
+	if (clip_out(x, y, x+w-1, y+h-1)) return;
+
+	if (x < dev->clip_x0) {w -= dev->clip_x0-x; sx += dev->clip_x0-x; x = dev->clip_x0;} // clip, moving the source with it
+	if (y < dev->clip_y0) {h -= dev->clip_y0-y; sy += dev->clip_y0-y; y = dev->clip_y0;}
+	if (x+w > dev->clip_x1+1) w = dev->clip_x1+1-x;
+	if (y+h > dev->clip_y1+1) h = dev->clip_y1+1-y;
+	const color_t *src = bitmap + (size_t)sy*stride + sx;
+	STAT_PIXELS((size_t)w*h);
+
+	if (dev->use_frame_buffer) {
+		for (coord_t j = 0; j < h; j++, src += stride) {
+			color_t *dst = fb_row(y+j) + x;
+			if (dev->fb_native) {
+				lcd_pix_copySwap(dst, src, w);
+			} else {
+				lcd_pix_copy(dst, src, w);
+			}
+		}
+		dirty_add(x, y, x+w-1, y+h-1);
+	} else if (dev->use_tiles) {
+		for (coord_t j = 0; j < h; j++, src += stride) {
+			lcd_tile_pixels(&tile_list, x, y+j, w, src);
+		}
+	} else if (dev->use_palette) {
+		for (coord_t j = 0; j < h; j++, src += stride) {
+			pal_pixels(x, y+j, w, src);
+		}
+	} else {
+		// One address window, rows packed into as few transfers as fit.
+		coord_t rows = (STREAM_BYTES/2)/(w*sizeof(color_t));
+		stream_window(x+dev->offsetx, y+dev->offsety,
+			x+w-1+dev->offsetx, y+h-1+dev->offsety);
+		stream_advance((size_t)w*h);
+		for (coord_t j = 0; j < h; ) {
+			coord_t m = (h-j < rows) ? h-j : rows;
+			size_t bytes = (size_t)m*w*sizeof(color_t);
+			color_t *dst = stream_reserve(bytes);
+			void *data = dst;
+			for (coord_t i = 0; i < m; i++, j++, src += stride, dst += w) {
+				lcd_pix_copySwap(dst, src, w);
+			}
+			trans_queue(data, bytes, TRANS_DC_DATA);
+		}
+	}
+}
+
+//----------------------------------------------------------------------------//
+// Rectangle variants that specify two diagonal corners
+//----------------------------------------------------------------------------//
+
+void lcd_drawRect2(coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color)
+{
+	STAT(LCD_STAT_RECT);
+	if (x0>x1) swap(coord_t, x0, x1);
+	if (y0>y1) swap(coord_t, y0, y1);
+
+	lcd_drawHLine(x0, y0, x1-x0+1, color);
+	lcd_drawHLine(x0, y1, x1-x0+1, color);
+	lcd_drawVLine(x1, y0, y1-y0+1, color);
+	lcd_drawVLine(x0, y0, y1-y0+1, color);
+}
+
+void lcd_fillRect2(coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color)
+{
+	STAT(LCD_STAT_FILL_RECT);
+	if (x0>x1) swap(coord_t, x0, x1);
+	if (y0>y1) swap(coord_t, y0, y1);
+
+	if (clip_out(x0, y0, x1, y1)) return;
+
+	if (x0 < dev->clip_x0) x0 = dev->clip_x0; // clip
+	if (x1 > dev->clip_x1) x1 = dev->clip_x1;
+	if (y0 < dev->clip_y0) y0 = dev->clip_y0;
+	if (y1 > dev->clip_y1) y1 = dev->clip_y1;
+	STAT_PIXELS((size_t)(x1-x0+1)*(y1-y0+1));
+
+	if (dev->use_frame_buffer) {
+		color = FB_COLOR(color);
+		for (coord_t j = y0; j <= y1; j++){
+			lcd_pix_fill(fb_row(j)+x0, color, x1-x0+1);
+		}
+		dirty_add(x0, y0, x1, y1);
+	} else if (dev->use_tiles) {
+		lcd_tile_rect(&tile_list, x0, y0, x1-x0+1, y1-y0+1, color);
+	} else if (dev->use_palette) {
+		pal_rect(x0, y0, x1, y1, color);
+	} else {
+		coord_t _x0 = x0 + dev->offsetx;
+		coord_t _x1 = x1 + dev->offsetx;
+		coord_t _y0 = y0 + dev->offsety;
+		coord_t _y1 = y1 + dev->offsety;
+		size_t size = (size_t)(_x1-_x0+1)*(_y1-_y0+1);
+
+		stream_window(_x0, _y0, _x1, _y1);
+		stream_color(color, size);
+	}
+}
+
+void lcd_drawRoundRect2(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t r, color_t color)
+{
+	STAT(LCD_STAT_ROUND_RECT);
+	coord_t xa;
+	coord_t ya;
+	coord_t err;
+	coord_t old_err;
+
+	if (x0>x1) swap(coord_t, x0, x1);
+	if (y0>y1) swap(coord_t, y0, y1);
+
+	coord_t w = x1-x0+1-(r<<1);
+	coord_t h = y1-y0+1-(r<<1);
+	if (w < 1 || h < 1) return;
+	if (clip_out(x0, y0, x1, y1)) return;
+
+	xa=0;
+	ya=-r;
+	err=2-2*r;
+
+	do {
+		if (xa) {
+			lcd_drawPixel(x0+r-xa, y0+r+ya, color);
+			lcd_drawPixel(x1-r+xa, y0+r+ya, color);
+			lcd_drawPixel(x0+r-xa, y1-r-ya, color);
+			lcd_drawPixel(x1-r+xa, y1-r-ya, color);
+		}
+		if ((old_err=err)<=xa)    err+=++xa*2+1;
+		if (old_err>ya || err>xa) err+=++ya*2+1;
+	} while (ya<0);
+	lcd_drawHLine(x0+r, y0,   w, color);
+	lcd_drawHLine(x0+r, y1,   w, color);
+	lcd_drawVLine(x0,   y0+r, h, color);
+	lcd_drawVLine(x1,   y0+r, h, color);
+}
 
-	xa=0;
-	ya=-r;
-	err=2-2*r;
+void lcd_fillRoundRect2(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t r, color_t color)
+{
+	STAT(LCD_STAT_FILL_ROUND_RECT);
+	if (x0>x1) swap(coord_t, x0, x1);
+	if (y0>y1) swap(coord_t, y0, y1);
+
+	coord_t w1 = x1-x0+1-(r<<1);
+	coord_t h1 = y1-y0+1-(r<<1);
+	if (w1 < 1 || h1 < 1) return;
+
+	fill_round(x0+r, y0+r, x1-r, y1-r, r, color);
+}
+
+//----------------------------------------------------------------------------//
+// Specify center, size, and rotation angle of primitive shape
+//----------------------------------------------------------------------------//
+
+// Rotate the offset xd,yd from xc,yc. c and s are the cosine and sine of
+// the angle in Q1.15. The vertex is rounded to the nearest pixel.
+static void rotate_vertex(coord_t xc, coord_t yc, int32_t xd, int32_t yd,
+	q15_t c, q15_t s, coord_t *x, coord_t *y)
+{
+	int32_t xr, yr;
+	fx_rotate(xd, yd, c, s, &xr, &yr);
+	*x = xc + xr;
+	*y = yc + yr;
+}
+
+/**
+ * @details A vertex's final position is calculated by rotating it
+ *  around the center point of the primitive by the angle specified.
+ * x1 = x * cos(angle) - y * sin(angle) + xc
+ * y1 = x * sin(angle) + y * cos(angle) + yc
+ */
+void lcd_drawRectC(coord_t xc, coord_t yc, coord_t w, coord_t h, angle_t angle, color_t color)
+{
+	STAT(LCD_STAT_RECT);
+	fx_angle_t a = fx_deg(-angle);
+	q15_t c = fx_cos(a), s = fx_sin(a);
+	coord_t x1, y1;
+	coord_t x2, y2;
+	coord_t x3, y3;
+	coord_t x4, y4;
+	rotate_vertex(xc, yc, -(w/2),  h/2,  c, s, &x1, &y1);
+	rotate_vertex(xc, yc, -(w/2), -(h/2), c, s, &x2, &y2);
+	rotate_vertex(xc, yc,   w/2,   h/2,  c, s, &x3, &y3);
+	rotate_vertex(xc, yc,   w/2, -(h/2), c, s, &x4, &y4);
+
+	lcd_drawLine(x1, y1, x2, y2, color);
+	lcd_drawLine(x1, y1, x3, y3, color);
+	lcd_drawLine(x2, y2, x4, y4, color);
+	lcd_drawLine(x3, y3, x4, y4, color);
+}
+
+/**
+ * @details A vertex's final position is calculated by rotating it
+ *  around the center point of the primitive by the angle specified.
+ * x1 = x * cos(angle) - y * sin(angle) + xc
+ * y1 = x * sin(angle) + y * cos(angle) + yc
+ */
+void lcd_drawTriangleC(coord_t xc, coord_t yc, coord_t w, coord_t h, angle_t angle, color_t color)
+{
+	STAT(LCD_STAT_TRIANGLE);
+	fx_angle_t a = fx_deg(-angle);
+	q15_t c = fx_cos(a), s = fx_sin(a);
+	coord_t x1, y1;
+	coord_t x2, y2;
+	coord_t x3, y3;
+	rotate_vertex(xc, yc,      0,  h/2,  c, s, &x1, &y1);
+	rotate_vertex(xc, yc,    w/2, -(h/2), c, s, &x2, &y2);
+	rotate_vertex(xc, yc, -(w/2), -(h/2), c, s, &x3, &y3);
+
+	lcd_drawLine(x1, y1, x2, y2, color);
+	lcd_drawLine(x1, y1, x3, y3, color);
+	lcd_drawLine(x2, y2, x3, y3, color);
+}
+
+/**
+ * @details A vertex's final position is calculated by rotating it
+ *  around the center point of the primitive by the angle specified.
+ * x1 = x * cos(angle) - y * sin(angle) + xc
+ * y1 = x * sin(angle) + y * cos(angle) + yc
+ *  Vertex i is at 360*i/n degrees before rotation, so both rotations are
+ *  done as one table lookup per vertex.
+ */
+void lcd_drawRegularPolygonC(coord_t xc, coord_t yc, coord_t n, coord_t r, angle_t angle, color_t color)
+{
+	STAT(LCD_STAT_POLYGON);
+	fx_angle_t a = fx_deg(-angle);
+	coord_t x1, y1;
+	coord_t x2, y2;
+	coord_t i;
+
+	coord_t ra = abs(r)+1; // bounds vertices after rounding
+	if (clip_out(xc-ra, yc-ra, xc+ra, yc+ra)) return;
+	if (n <= 0) return;
+
+	rotate_vertex(xc, yc, r, 0, fx_cos(a), fx_sin(a), &x1, &y1);
+	for (i = 1; i <= n; i++) {
+		fx_angle_t v = a + (fx_angle_t)((uint32_t)(i % n)*65536/n);
+		rotate_vertex(xc, yc, r, 0, fx_cos(v), fx_sin(v), &x2, &y2);
+		lcd_drawLine(x1, y1, x2, y2, color);
+		x1 = x2; y1 = y2;
+	}
+}
+
+//----------------------------------------------------------------------------//
+// Draw characters and strings
+//----------------------------------------------------------------------------//
+
+// Glyph cache. Characters with a background are expanded into cells of
+// pixels in the order they are stored (frame buffer or display wire order),
+// keyed by character, font size and the stored colors.
+#define GLYPH_DEF_BYTES (4*1024) // default cache size
+#define GLYPH_SLOTS 32 // most cells kept
+
+#define GLYPH_KEY(a,s,fg,bg) ((uint64_t)(uint8_t)(a) | (uint64_t)(s) << 8 | \
+	(uint64_t)(fg) << 16 | (uint64_t)(bg) << 32 | 1ULL << 48)
+
+typedef struct {
+	uint64_t key;  // 0 if the slot is free
+	uint32_t used; // tick of last use
+	size_t bytes;
+	color_t *cell; // LCD_CHAR_W*size by LCD_CHAR_H*size pixels
+} glyph_t;
+
+static glyph_t glyph[GLYPH_SLOTS];
+static size_t glyph_max = GLYPH_DEF_BYTES; // cache size
+static size_t glyph_bytes; // cache bytes in use
+static uint32_t glyph_tick; // advanced once per draw call
+
+// Expand pixel row r of a glyph at the current font size.
+static void glyph_row(char ascii, color_t fg, color_t bg, coord_t r, color_t *dst)
+{
+	uint8_t s = dev->font_size;
+	uint8_t bit = 1 << (r / s);
+	const unsigned char *line = &font[(uint8_t)ascii * (LCD_CHAR_W-1)];
+
+	for (int8_t i = 0; i < LCD_CHAR_W; i++) {
+		color_t c = (i < LCD_CHAR_W-1 && (line[i] & bit)) ? fg : bg;
+		for (uint8_t k = 0; k < s; k++) *dst++ = c;
+	}
+}
+
+static void glyph_free(glyph_t *g)
+{
+	heap_caps_free(g->cell);
+	glyph_bytes -= g->bytes;
+	g->key = 0;
+	g->cell = NULL;
+}
+
+// Look up a glyph cell, expanding it on a miss. Returns NULL if the cell does
+// not fit without evicting one used in the current draw call.
+static const color_t *glyph_get(char ascii, color_t fg, color_t bg)
+{
+	uint8_t s = dev->font_size;
+	uint64_t key = GLYPH_KEY(ascii, s, fg, bg);
+	coord_t cw = LCD_CHAR_W*s, ch = LCD_CHAR_H*s;
+	size_t bytes = (size_t)cw*ch*sizeof(color_t);
+	glyph_t *g, *slot, *lru;
+
+	if (dev != &device) return NULL; // canvases do not share the cache
+	for (g = glyph; g < glyph+GLYPH_SLOTS; g++) {
+		if (g->key == key) {
+			g->used = glyph_tick;
+			return g->cell;
+		}
+	}
+	if (bytes > glyph_max) return NULL;
+	for (;;) { // evict least recently used cells until the new one fits
+		slot = lru = NULL;
+		for (g = glyph; g < glyph+GLYPH_SLOTS; g++) {
+			if (g->key == 0) {
+				if (slot == NULL) slot = g;
+			} else if (lru == NULL || (int32_t)(g->used - lru->used) < 0) {
+				lru = g;
+			}
+		}
+		if (slot != NULL && glyph_bytes + bytes <= glyph_max) break;
+		if (lru == NULL || lru->used == glyph_tick) return NULL;
+		glyph_free(lru);
+	}
+	slot->cell = heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+	if (slot->cell == NULL) return NULL;
+	for (coord_t r = 0; r < ch; r++) glyph_row(ascii, fg, bg, r, slot->cell + r*cw);
+	slot->key = key;
+	slot->used = glyph_tick;
+	slot->bytes = bytes;
+	glyph_bytes += bytes;
+	return slot->cell;
+}
+
+// Draw n characters with the font background, all inside the clip. In
+// direct mode the run is sent as one address window.
+static void glyph_run(coord_t x, coord_t y, const char *ascii, size_t n, color_t color)
+{
+	coord_t cw = LCD_CHAR_W*dev->font_size;
+	coord_t ch = LCD_CHAR_H*dev->font_size;
+	coord_t w = n*cw;
+	const color_t *cell[n];
+
+	if (dev == &device) glyph_tick++;
+	STAT_PIXELS((size_t)w*ch);
+	if (dev->use_frame_buffer) {
+		color_t fg = FB_COLOR(color), bg = FB_COLOR(dev->font_back_color);
+		for (size_t k = 0; k < n; k++) {
+			const color_t *src = glyph_get(ascii[k], fg, bg);
+			for (coord_t r = 0; r < ch; r++) {
+				color_t *dst = fb_row(y+r) + x+k*cw;
+				if (src) lcd_pix_copy(dst, src+r*cw, cw);
+				else glyph_row(ascii[k], fg, bg, r, dst);
+			}
+		}
+		dirty_add(x, y, x+w-1, y+ch-1);
+	} else {
+		color_t fg = SWAP16(color), bg = SWAP16(dev->font_back_color);
+		coord_t rows = (STREAM_BYTES/2)/(w*sizeof(color_t)); // per transfer
+		for (size_t k = 0; k < n; k++) cell[k] = glyph_get(ascii[k], fg, bg);
+		stream_window(x+dev->offsetx, y+dev->offsety,
+			x+w-1+dev->offsetx, y+ch-1+dev->offsety);
+		stream_advance((size_t)w*ch);
+		for (coord_t r = 0; r < ch; ) {
+			coord_t m = (ch-r < rows) ? ch-r : rows;
+			size_t bytes = (size_t)m*w*sizeof(color_t);
+			color_t *dst = stream_reserve(bytes);
+			void *data = dst;
+			for (coord_t i = 0; i < m; i++, r++) {
+				for (size_t k = 0; k < n; k++, dst += cw) {
+					if (cell[k]) lcd_pix_copy(dst, cell[k]+r*cw, cw);
+					else glyph_row(ascii[k], fg, bg, r, dst);
+				}
+			}
+			trans_queue(data, bytes, TRANS_DC_DATA);
+		}
+	}
+}
+
+coord_t lcd_drawChar(coord_t x, coord_t y, char ascii, color_t color)
+{
+	STAT(LCD_STAT_TEXT);
+	coord_t s = dev->font_size;
+#if 0
+	if ((x >= dev->width) ||                        // off screen right
+		(y >= dev->height) ||                       // off screen bottom
+		((x + LCD_CHAR_W * dev->font_size) <= 0) || // off screen left
+		((y + LCD_CHAR_H * dev->font_size) <= 0))   // off screen top
+		return;
+#endif
+
+	if (dev->font_back_en) {
+		if (!dev->use_tiles && !dev->use_palette &&
+			x >= dev->clip_x0 && x+LCD_CHAR_W*s-1 <= dev->clip_x1 &&
+			y >= dev->clip_y0 && y+LCD_CHAR_H*s-1 <= dev->clip_y1) {
+			glyph_run(x, y, &ascii, 1, color);
+			return x+LCD_CHAR_W*s;
+		}
+		lcd_fillRect(x, y,
+			LCD_CHAR_W*dev->font_size,
+			LCD_CHAR_H*dev->font_size,
+			dev->font_back_color);
+	}
+	// Draw each column as vertical runs of set pixels.
+	for (int8_t i = 0; i < LCD_CHAR_W-1; i++) {
+		uint8_t line = font[((uint8_t)ascii * (LCD_CHAR_W-1)) + i];
+		for (int8_t j = 0; j < LCD_CHAR_H; ) {
+			if (!((line >> j) & 0x1)) {j++; continue;}
+			int8_t k = j+1;
+			while (k < LCD_CHAR_H && ((line >> k) & 0x1)) k++;
+			if (s == 1 && k-j == 1) lcd_drawPixel(x + i, y + j, color);
+			else lcd_fillRect(x + i*s, y + j*s, s, (k-j)*s, color);
+			j = k;
+		}
+	}
+	return x+LCD_CHAR_W*s;
+}
+
+coord_t lcd_drawString(coord_t x, coord_t y, const char *ascii, color_t color)
+{
+	STAT(LCD_STAT_TEXT);
+	size_t length = strlen(ascii);
+	size_t i = 0;
+	coord_t cw = LCD_CHAR_W*dev->font_size;
+
+	if (dev->font_back_en && !dev->use_tiles && !dev->use_palette &&
+		y >= dev->clip_y0 && y+LCD_CHAR_H*dev->font_size-1 <= dev->clip_y1) {
+		// Characters fully inside the clip rectangle are drawn as one run.
+		for (; i < length && x < dev->clip_x0; i++) x = lcd_drawChar(x, y, ascii[i], color);
+		size_t n = 0;
+		while (i+n < length && x+(coord_t)(n+1)*cw-1 <= dev->clip_x1) n++;
+		if (n) {
+			glyph_run(x, y, ascii+i, n, color);
+			x += n*cw;
+			i += n;
+		}
+	}
+	for (; i<length; i++) {
+		x = lcd_drawChar(x, y, ascii[i], color);
+	}
+	return x;
+}
+
+//----------------------------------------------------------------------------//
+// Font parameters
+//----------------------------------------------------------------------------//
+
+void lcd_setFontDirection(direction_t dir)
+{
+	// TODO: implement, currently direction always 0
+	dev->font_direction = dir;
+}
+
+void lcd_setFontSize(uint8_t size)
+{
+	if (size < 1) return;
+	dev->font_size = size;
+}
+
+void lcd_setFontBackground(color_t color)
+{
+	dev->font_back_en = true;
+	dev->font_back_color = color;
+}
+
+void lcd_noFontBackground(void)
+{
+	dev->font_back_en = false;
+}
+
+void lcd_setGlyphCache(size_t bytes)
+{
+	for (glyph_t *g = glyph; g < glyph+GLYPH_SLOTS; g++) {
+		if (g->key != 0) glyph_free(g);
+	}
+	glyph_max = bytes;
+}
+
+//----------------------------------------------------------------------------//
+// Display configuration
+//----------------------------------------------------------------------------//
+
+void lcd_spiClockFreq(int32_t freq)
+{
+	ESP_LOGI(TAG, "SPI clock frequency=%d MHz", (int)freq/1000000);
+	clock_freq_hz = freq;
+}
+
+void lcd_displayOff(void)
+{
+	if (!screen_selected(__func__)) return;
+	spi_master_write_command(dev, 0x28); // Display OFF (28h), DISPOFF (28h): Display Off
+}
+
+void lcd_displayOn(void)
+{
+	if (!screen_selected(__func__)) return;
+	spi_master_write_command(dev, 0x29); // Display ON (29h), DISPON (29h): Display On
+}
+
+void lcd_backlightOff(void)
+{
+	if (!screen_selected(__func__)) return;
+	if (dev->bl >= 0) {
+		gpio_set_level(dev->bl, 0);
+	}
+}
+
+void lcd_backlightOn(void)
+{
+	if (!screen_selected(__func__)) return;
+	if (dev->bl >= 0) {
+		gpio_set_level(dev->bl, 1);
+	}
+}
+
+void lcd_inversionOff(void)
+{
+	if (!screen_selected(__func__)) return;
+	spi_master_write_command(dev, 0x20); // Display Inversion OFF (20h), INVOFF (20h): Display Inversion Off
+}
+
+void lcd_inversionOn(void)
+{
+	if (!screen_selected(__func__)) return;
+	spi_master_write_command(dev, 0x21); // Display Inversion ON (21h), INVON (21h): Display Inversion On
+}
+
+void lcd_getStats(lcd_stats_t *stats)
+{
+	lcd_stat_counts_t *t = &stats->total;
+
+	memcpy(stats->prim, stat, sizeof(stat));
+	memset(t, 0, sizeof(*t));
+	for (uint8_t i = 0; i < LCD_STAT_COUNT; i++) {
+		t->calls += stat[i].calls;
+		t->transactions += stat[i].transactions;
+		t->windows += stat[i].windows;
+		t->window_skips += stat[i].window_skips;
+		t->wait_us += stat[i].wait_us;
+		t->cmd_bytes += stat[i].cmd_bytes;
+		t->data_bytes += stat[i].data_bytes;
+		t->pixels += stat[i].pixels;
+	}
+	stats->frames = stat_frames;
+}
+
+void lcd_resetStats(void)
+{
+	memset(stat, 0, sizeof(stat));
+	stat_frames = 0;
+}
+
+const char *lcd_statName(lcd_stat_t prim)
+{
+	return (prim < LCD_STAT_COUNT) ? stat_names[prim] : "";
+}
+
+void lcd_setClip(coord_t x, coord_t y, coord_t w, coord_t h)
+{
+	coord_t x1 = x+w-1;
+	coord_t y1 = y+h-1;
+
+	if (x < 0) x = 0; // limit to the screen
+	if (x1 >= dev->width) x1 = dev->width-1;
+	if (y < 0) y = 0;
+	if (y1 >= dev->height) y1 = dev->height-1;
+	if (x1 < x || y1 < y) {
+		// Empty, one pixel left of and above the origin so that a span
+		// clipped on one axis is rejected on the other.
+		x = y = 0;
+		x1 = y1 = -1;
+	}
+	dev->clip_x0 = x;
+	dev->clip_y0 = y;
+	dev->clip_x1 = x1;
+	dev->clip_y1 = y1;
+}
+
+void lcd_resetClip(void)
+{
+	lcd_setClip(0, 0, dev->width, dev->height);
+}
+
+//----------------------------------------------------------------------------//
+// Frame management
+//----------------------------------------------------------------------------//
+
+void lcd_frameEnable(void)
+{
+	if (!screen_selected(__func__)) return;
+	if (dev->use_frame_buffer == true) return;
+	if (dev->use_tiles) {
+		ESP_LOGE(TAG, "frame buffer not available in tile mode");
+		return;
+	}
+	if (dev->use_palette) {
+		ESP_LOGE(TAG, "frame buffer not available in palette mode");
+		return;
+	}
+	dev->frame_buffer = heap_caps_malloc(sizeof(color_t)*dev->width*dev->height, MALLOC_CAP_DMA);
+	if (dev->frame_buffer == NULL) {
+		ESP_LOGE(TAG, "frame buffer alloc fail");
+	} else {
+		ESP_LOGI(TAG, "frame buffer alloc success");
+		dev->use_frame_buffer = true;
+		dirty_reset();
+	}
+}
 
-	do {
-		if (xa) {
-			lcd_drawHLine(x+r-xa, y +r+ya, w1+(xa<<1), color);
-			lcd_drawHLine(x+r-xa, y1-r-ya, w1+(xa<<1), color);
+void lcd_frameDisable(void)
+{
+	if (!screen_selected(__func__)) return;
+	lcd_layerDisable();
+	lcd_frameDoubleDisable();
+	scroll.height = 0;
+	scroll.offset = 0;
+	scroll_show(); // panel back to screen order for direct drawing
+	if (dev->frame_buffer != NULL) heap_caps_free(dev->frame_buffer);
+	dev->frame_buffer = NULL;
+	dev->use_frame_buffer = false;
+	if (dev->fb_half) {
+		for (uint8_t i = 0; i < 2; i++) {
+			if (half_buf[i] != NULL) heap_caps_free(half_buf[i]);
+			half_buf[i] = NULL;
 		}
-		if ((old_err=err)<=xa)    err+=++xa*2+1;
-		if (old_err>ya || err>xa) err+=++ya*2+1;
-	} while (ya<0);
-	lcd_fillRect(x, y+r, w, h1, color);
+		dev->fb_half = false;
+		dev->width = LCD_W;
+		dev->height = LCD_H;
+		lcd_resetClip();
+	}
 }
 
-/**
- * @details See this [link](http://k-hiura.cocolog-nifty.com/blog/2010/11/post-2a62.html)
-    for implementation details.
- */
-void lcd_drawArrow(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t w, color_t color)
+void lcd_frameHalfEnable(void)
 {
-	float Vx = x1 - x0; // basic vector
-	float Vy = y1 - y0;
-	float v  = sqrtf(Vx*Vx+Vy*Vy); // basic vector length
-	float Ux = Vx/v; // basic unit vector
-	float Uy = Vy/v;
-	float h  = w*3; // arrow head height
+	if (!screen_selected(__func__)) return;
+	if (dev->fb_half) return;
+	if (dev->use_frame_buffer || dev->use_tiles || dev->use_palette) {
+		ESP_LOGE(TAG, "half resolution needs direct mode");
+		return;
+	}
+	dev->frame_buffer = heap_caps_malloc(sizeof(color_t)*(LCD_W/2)*(LCD_H/2), MALLOC_CAP_DMA);
+	half_buf[0] = heap_caps_malloc(HALF_BUF_PIXELS*sizeof(color_t), MALLOC_CAP_DMA);
+	half_buf[1] = heap_caps_malloc(HALF_BUF_PIXELS*sizeof(color_t), MALLOC_CAP_DMA);
+	dev->fb_half = true; // lcd_frameDisable() frees what was allocated
+	if (dev->frame_buffer == NULL || half_buf[0] == NULL || half_buf[1] == NULL) {
+		ESP_LOGE(TAG, "half resolution buffer alloc fail");
+		lcd_frameDisable();
+		return;
+	}
+	ESP_LOGI(TAG, "half resolution buffer alloc success");
+	dev->width = LCD_W/2;
+	dev->height = LCD_H/2;
+	lcd_resetClip();
+	dev->use_frame_buffer = true;
+	dirty_reset();
+}
 
-	if (h > v) h = v; // clip arrow head height to vector length
+void lcd_frameHalfDisable(void)
+{
+	if (!screen_selected(__func__)) return;
+	if (dev->fb_half) lcd_frameDisable();
+}
 
-	coord_t L[2],R[2],C[2]; // left, right, center arrow head base
-	L[0] = x1 - Uy*w - Ux*h + 0.5f;
-	L[1] = y1 + Ux*w - Uy*h + 0.5f;
-	R[0] = x1 + Uy*w - Ux*h + 0.5f;
-	R[1] = y1 - Ux*w - Uy*h + 0.5f;
-	C[0] = x1 - Ux*h + 0.5f;
-	C[1] = y1 - Uy*h + 0.5f;
+// Switch the frame buffer byte order, converting the current image.
+static void lcd_frameNative(bool native)
+{
+	if (dev->fb_native == native) return;
+	lcd_waitFrame();
+	dev->fb_native = native;
+	if (dev->frame_buffer != NULL) {
+		lcd_pix_copySwap(dev->frame_buffer, dev->frame_buffer, (size_t)dev->width*dev->height);
+	}
+	if (dev->frame_back != NULL) {
+		back_band[0] = (rect_t){0, 0, dev->width-1, dev->height-1};
+		back_bands = 1;
+	}
+	for (uint8_t i = 0; dev->use_frame_buffer && i < layer_count; i++) {
+		lcd_pix_copySwap(layer[i].pix, layer[i].pix, (size_t)dev->width*dev->height);
+	}
+}
 
-	lcd_drawLine(x0, y0, C[0], C[1], color);
-	lcd_drawTriangle(x1, y1, L[0], L[1], R[0], R[1], color);
+void lcd_frameNativeEnable(void)
+{
+	if (!screen_selected(__func__)) return;
+	lcd_frameNative(true);
 }
 
-/**
- * @details See this [link](http://k-hiura.cocolog-nifty.com/blog/2010/11/post-2a62.html)
-    for implementation details.
- */
-void lcd_fillArrow(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t w, color_t color)
+void lcd_frameNativeDisable(void)
 {
-	float Vx = x1 - x0; // basic vector
-	float Vy = y1 - y0;
-	float v  = sqrtf(Vx*Vx+Vy*Vy); // basic vector length
-	float Ux = Vx/v; // basic unit vector
-	float Uy = Vy/v;
-	float h  = w*3; // arrow head height
+	if (!screen_selected(__func__)) return;
+	lcd_frameNative(false);
+}
 
-	if (h > v) h = v; // clip arrow head height to vector length
+void lcd_frameDoubleEnable(void)
+{
+	if (!screen_selected(__func__)) return;
+	if (dev->use_frame_buffer == false || dev->frame_back != NULL) return;
+	if (dev->fb_half) return; // frames are already sent from separate buffers
+	dev->frame_back = heap_caps_malloc(sizeof(color_t)*dev->width*dev->height, MALLOC_CAP_DMA);
+	if (dev->frame_back == NULL) {
+		ESP_LOGE(TAG, "second frame buffer alloc fail");
+	} else {
+		ESP_LOGI(TAG, "second frame buffer alloc success");
+		back_band[0] = (rect_t){0, 0, dev->width-1, dev->height-1};
+		back_bands = 1; // contents unknown, copy everything on first write
+		// Untracked frames are copied whole between the buffers on every
+		// write, so track changes while there are two.
+		if (dirty_max_rects == 0) {
+			dirty_max_rects = DIRTY_DOUBLE_RECTS;
+			dirty_double = true;
+			dirty_reset();
+		}
+	}
+}
 
-	coord_t L[2],R[2],C[2]; // left, right, center arrow head base
-	L[0] = x1 - Uy*w - Ux*h + 0.5f;
-	L[1] = y1 + Ux*w - Uy*h + 0.5f;
-	R[0] = x1 + Uy*w - Ux*h + 0.5f;
-	R[1] = y1 - Ux*w - Uy*h + 0.5f;
-	C[0] = x1 - Ux*h + 0.5f;
-	C[1] = y1 - Uy*h + 0.5f;
+void lcd_frameDoubleDisable(void)
+{
+	if (!screen_selected(__func__)) return;
+	lcd_waitFrame();
+	if (dev->frame_back != NULL) heap_caps_free(dev->frame_back);
+	dev->frame_back = NULL;
+	if (dirty_double) {
+		dirty_max_rects = DIRTY_DEF_RECTS;
+		dirty_double = false;
+		dirty_reset();
+	}
+}
 
-	lcd_drawLine(x0, y0, C[0], C[1], color);
-	lcd_fillTriangle(x1, y1, L[0], L[1], R[0], R[1], color);
+color_t *lcd_getFrameBuffer(void)
+{
+	return (dev->frame_buffer != NULL) ? fb_base() : NULL;
 }
 
-void lcd_drawBitmap(coord_t x, coord_t y, const uint8_t *bitmap, coord_t w, coord_t h, color_t color)
+void lcd_wrapAround(scroll_t dir, coord_t start, coord_t end)
 {
-	coord_t byteWidth = (w + 7) / 8; // pad bitmap scanline to whole byte
-	uint8_t b = 0;
+	if (!screen_selected(__func__)) return;
+	STAT(LCD_STAT_SCROLL);
+	if (dev->use_frame_buffer == false) return;
+
+	coord_t fb_w = dev->width;
+	coord_t fb_h = dev->height;
 
-	if (x+w <= 0 || x >= dev->width) return; // off screen
-	if (y+h <= 0 || y >= dev->height) return;
+	if (start < 0) start = 0; // clip
+	if (dir == SCROLL_RIGHT || dir == SCROLL_LEFT) {
+		if (end >= fb_h) end = fb_h-1;
+		if (start > end) return;
+		dirty_add(0, start, fb_w-1, end);
+	} else {
+		if (end >= fb_w) end = fb_w-1;
+		if (start > end) return;
+		if (start == 0 && end == fb_w-1 && scroll.top == 0 && scroll.height == fb_h) {
+			lcd_scroll((dir == SCROLL_UP) ? 1 : -1); // whole screen, move the ring
+			return;
+		}
+		dirty_add(start, 0, end, fb_h-1);
+	}
 
-	for (size_t j = 0; j < h; j++, y++) {
-		for (size_t i = 0; i < w; i++) {
-			if (i & 7) b <<= 1;
-			else b = bitmap[j * byteWidth + i / 8];
-			if (b & 0x80) lcd_drawPixel(x + i, y, color);
+	// Rows are copied whole so memory is walked in order.
+	switch (dir) {
+	case SCROLL_RIGHT: {
+		color_t wk;
+		for (coord_t i = start; i <= end; i++) {
+			color_t *row = fb_row(i);
+			wk = row[fb_w-1];
+			lcd_pix_move(row+1, row, fb_w-1);
+			row[0] = wk;
+		}
+		break; }
+	case SCROLL_LEFT: {
+		color_t wk;
+		for (coord_t i = start; i <= end; i++) {
+			color_t *row = fb_row(i);
+			wk = row[0];
+			lcd_pix_move(row, row+1, fb_w-1);
+			row[fb_w-1] = wk;
+		}
+		break; }
+	case SCROLL_DOWN: {
+		size_t len = end-start+1;
+		color_t wk[len];
+		lcd_pix_copy(wk, fb_row(fb_h-1)+start, len);
+		for (coord_t j = fb_h-1; j > 0; j--) {
+			lcd_pix_copy(fb_row(j)+start, fb_row(j-1)+start, len);
+		}
+		lcd_pix_copy(fb_row(0)+start, wk, len);
+		break; }
+	case SCROLL_UP: {
+		size_t len = end-start+1;
+		color_t wk[len];
+		lcd_pix_copy(wk, fb_row(0)+start, len);
+		for (coord_t j = 0; j < fb_h-1; j++) {
+			lcd_pix_copy(fb_row(j)+start, fb_row(j+1)+start, len);
 		}
+		lcd_pix_copy(fb_row(fb_h-1)+start, wk, len);
+		break; }
 	}
 }
 
-void lcd_drawRGBBitmap(coord_t x, coord_t y, const color_t *bitmap, coord_t w, coord_t h)
+void lcd_scrollEnable(coord_t top, coord_t bottom)
 {
-	if (x+w <= 0 || x >= dev->width) return; // off screen
-	if (y+h <= 0 || y >= dev->height) return;
+	if (!screen_selected(__func__)) return;
+	STAT(LCD_STAT_SCROLL);
+	if (dev->use_frame_buffer == false || dev->fb_half) {
+		ESP_LOGE(TAG, "scrolling needs a full size frame buffer");
+		return;
+	}
+	if (layer_count) {
+		ESP_LOGE(TAG, "scrolling not available with layers");
+		return;
+	}
+	if (top < 0) top = 0;
+	if (bottom < 0) bottom = 0;
+	coord_t height = dev->height-top-bottom;
+	if (height < 2) return;
+
+	lcd_scrollDisable();
+	scroll.top = top;
+	scroll.height = height;
+	scroll.hw = dev->offsety+dev->height <= LCD_SCROLL_LINES;
+	if (scroll.hw) {
+		// Rows outside the region, including panel rows below the
+		// screen, are fixed.
+		uint16_t tfa = top+dev->offsety;
+		spi_master_write_command(dev, 0x33); // VSCRDEF: Vertical Scrolling Definition
+		spi_master_write_data_word(dev, tfa);
+		spi_master_write_data_word(dev, height);
+		spi_master_write_data_word(dev, LCD_SCROLL_LINES-tfa-height);
+		scroll.start = UINT16_MAX; // force the start address out
+		scroll_show();
+	}
+}
 
-	for (size_t j = 0; j < h; j++, y++) {
-		lcd_drawHPixels(x, y, w, bitmap+j*w);
+void lcd_scrollDisable(void)
+{
+	if (!screen_selected(__func__)) return;
+	STAT(LCD_STAT_SCROLL);
+	if (scroll.height == 0) return;
+	if (scroll.offset) {
+		// Rotate the ring back into screen order.
+		coord_t top = scroll.top, bot = scroll.top+scroll.height-1;
+		fb_reverse_rows(top, top+scroll.offset-1);
+		fb_reverse_rows(top+scroll.offset, bot);
+		fb_reverse_rows(top, bot);
+		// Panel memory still holds the ring order.
+		if (scroll.hw) dirty_add(0, top, dev->width-1, bot);
+		scroll.offset = 0;
+	}
+	scroll.height = 0;
+	if (dev->frame_back != NULL) {
+		back_band[0] = (rect_t){0, 0, dev->width-1, dev->height-1};
+		back_bands = 1;
 	}
+	// Panel start address is restored by the next lcd_writeFrame().
 }
 
-//----------------------------------------------------------------------------//
-// Rectangle variants that specify two diagonal corners
-//----------------------------------------------------------------------------//
+void lcd_scroll(coord_t rows)
+{
+	if (!screen_selected(__func__)) return;
+	STAT(LCD_STAT_SCROLL);
+	if (scroll.height == 0) return;
+	rows %= scroll.height;
+	if (rows < 0) rows += scroll.height;
+	if (rows == 0) return;
+
+	scroll.offset += rows;
+	if (scroll.offset >= scroll.height) scroll.offset -= scroll.height;
+	// Drawn regions moved with the image.
+	rect_list_scroll(&drawn, rows);
+	if (scroll.hw) {
+		rect_list_scroll(&pend, rows);
+	} else {
+		rect_t r = {0, scroll.top, dev->width-1, scroll.top+scroll.height-1};
+		rect_list_add(&pend, &r);
+	}
+}
 
-void lcd_drawRect2(coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color)
+void lcd_writeFrame(void)
 {
-	if (x0>x1) swap(coord_t, x0, x1);
-	if (y0>y1) swap(coord_t, y0, y1);
+	if (!screen_selected(__func__)) return;
+	STAT(LCD_STAT_FRAME);
+	if (dev->use_tiles) {
+		tile_write();
+		return;
+	}
+	if (layer_count) layer_compose();
+	if (dev->use_palette) {
+		pal_write();
+		return;
+	}
+	if (dev->fb_half) {
+		half_write();
+		return;
+	}
+	if (dev->use_frame_buffer == false) {
+		lcd_waitFrame(); // direct mode, finish queued draw calls
+		return;
+	}
 
-	lcd_drawHLine(x0, y0, x1-x0+1, color);
-	lcd_drawHLine(x0, y1, x1-x0+1, color);
-	lcd_drawVLine(x1, y0, y1-y0+1, color);
-	lcd_drawVLine(x0, y0, y1-y0+1, color);
+	size_t frame_bytes = (size_t)dev->width*dev->height*sizeof(color_t);
+	size_t sent_bytes = 0;
+	dirty_stats.frames++;
+	stat_frames++;
+	if (pend.full && (scroll.hw || scroll.offset == 0)) {
+		// Panel memory has the frame buffer layout.
+		spi_master_write_command(dev, 0x2A); // Column(x) Address Set
+		spi_master_write_addr(dev, dev->offsetx, dev->offsetx+dev->width-1);
+		spi_master_write_command(dev, 0x2B); // Page(y) Address Set
+		spi_master_write_addr(dev, dev->offsety, dev->offsety+dev->height-1);
+		spi_master_write_command(dev, 0x2C); // Memory Write
+		if (dev->fb_native) spi_master_write_frame_rect(dev, 0, 0, dev->width-1, dev->height-1);
+		else spi_master_write_colors(dev, dev->frame_buffer, dev->width*dev->height);
+		sent_bytes = frame_bytes;
+		dirty_stats.full_frames++;
+	} else if (pend.full) {
+		write_rect(0, 0, dev->width-1, dev->height-1);
+		sent_bytes = frame_bytes;
+		dirty_stats.full_frames++;
+	} else {
+		// Send only the merged dirty rectangles.
+		for (uint8_t i = 0; i < pend.count; i++) {
+			const rect_t *r = &pend.rect[i];
+			write_rect(r->x0, r->y0, r->x1, r->y1);
+			sent_bytes += (size_t)rect_area(r)*sizeof(color_t);
+		}
+		dirty_stats.rects += pend.count;
+	}
+	dirty_stats.bytes_sent += sent_bytes;
+	dirty_stats.bytes_saved += frame_bytes - sent_bytes;
+	rect_list_clear(&pend, false);
+	scroll_show();
+	if (dev->frame_back != NULL) {
+		// Second buffer missed these changes, resynchronize it in full.
+		back_band[0] = (rect_t){0, 0, dev->width-1, dev->height-1};
+		back_bands = 1;
+	}
+
+#if 0
+	size_t size = (size_t)dev->width*dev->height;
+	color_t *image = dev->frame_buffer;
+	while (size > 0) {
+		// 1024 bytes per time.
+		size_t bs = (size > 512) ? 512 : size;
+		spi_master_write_colors(dev, image, bs);
+		size -= bs;
+		image += bs;
+	}
+#endif
+	return;
 }
 
-void lcd_fillRect2(coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color)
+void lcd_markDirty(coord_t x, coord_t y, coord_t w, coord_t h)
 {
-	if (x0>x1) swap(coord_t, x0, x1);
-	if (y0>y1) swap(coord_t, y0, y1);
+	if (!screen_selected(__func__)) return;
+	coord_t x1 = x+w-1;
+	coord_t y1 = y+h-1;
 
-	if (x1 < 0 || x0 >= dev->width) return; // off screen
-	if (y1 < 0 || y0 >= dev->height) return;
+	if (x1 < 0 || x >= dev->width) return; // off screen
+	if (y1 < 0 || y >= dev->height) return;
 
-	if (x0 < 0) x0 = 0; // clip
+	if (x < 0) x = 0; // clip
 	if (x1 >= dev->width) x1=dev->width-1;
-	if (y0 < 0) y0 = 0;
+	if (y < 0) y = 0;
 	if (y1 >= dev->height) y1=dev->height-1;
 
-	if (dev->use_frame_buffer) {
-		for (size_t j = y0; j <= y1; j++){
-			for (size_t i = x0; i <= x1; i++){
-				dev->frame_buffer[j*dev->width+i] = color;
-			}
+	dirty_add(x, y, x1, y1);
+}
+
+void lcd_setDirtyPolicy(uint8_t max_rects, uint32_t coalesce)
+{
+	if (!screen_selected(__func__)) return;
+	if (max_rects > LCD_DIRTY_RECTS) max_rects = LCD_DIRTY_RECTS;
+	dirty_max_rects = max_rects;
+	dirty_coalesce = (coalesce > INT32_MAX) ? INT32_MAX : coalesce;
+	dirty_double = false;
+	dirty_reset();
+}
+
+void lcd_getDirtyStats(lcd_dirty_stats_t *stats)
+{
+	*stats = dirty_stats;
+}
+
+void lcd_resetDirtyStats(void)
+{
+	memset(&dirty_stats, 0, sizeof(dirty_stats));
+}
+
+void lcd_writeFrameAsync(void)
+{
+	if (!screen_selected(__func__)) return;
+	STAT(LCD_STAT_FRAME);
+	rect_t band[LCD_DIRTY_RECTS];
+	uint8_t n;
+
+	if (dev->use_tiles) {
+		if (!tile_write() && frame_cb != NULL) frame_cb(frame_cb_arg);
+		return;
+	}
+	if (layer_count) layer_compose();
+	if (dev->use_palette) {
+		if (!pal_write() && frame_cb != NULL) frame_cb(frame_cb_arg);
+		return;
+	}
+	if (dev->fb_half) {
+		if (!half_write() && frame_cb != NULL) frame_cb(frame_cb_arg);
+		return;
+	}
+	if (dev->use_frame_buffer == false) return;
+	if (dev->frame_back == NULL || scroll.height) {
+		// Bands are screen rows, a scrolled frame buffer is written in order.
+		lcd_writeFrame();
+		if (frame_cb != NULL) frame_cb(frame_cb_arg);
+		return;
+	}
+	lcd_waitFrame(); // transfer buffer is free after this
+
+	// Bring the transfer buffer up to date, then swap roles.
+	n = dirty_bands(band);
+	copy_bands(dev->frame_back, dev->frame_buffer, back_band, back_bands);
+	copy_bands(dev->frame_back, dev->frame_buffer, band, n);
+	color_t *xfer = dev->frame_buffer;
+	dev->frame_buffer = dev->frame_back;
+	dev->frame_back = xfer;
+	memcpy(back_band, band, n*sizeof(rect_t));
+	back_bands = dev->fb_native ? 0 : n; // nothing is swapped in display order
+
+	size_t frame_bytes = (size_t)dev->width*dev->height*sizeof(color_t);
+	size_t sent_bytes = 0;
+	dirty_stats.frames++;
+	stat_frames++;
+	if (pend.full) dirty_stats.full_frames++;
+	else dirty_stats.rects += n;
+	rect_list_clear(&pend, false);
+
+	if (n == 0) { // nothing changed
+		if (frame_cb != NULL) frame_cb(frame_cb_arg);
+		dirty_stats.bytes_saved += frame_bytes;
+		return;
+	}
+
+	// Column window is the full width for every band.
+	win.valid = false;
+	trans_queue_addr(0x2A, dev->offsetx, dev->offsetx+dev->width-1); // Column(x) Address Set
+	for (uint8_t i = 0; i < n; i++) {
+		color_t *ptr = xfer + (size_t)band[i].y0*dev->width;
+		size_t len = (size_t)(band[i].y1-band[i].y0+1)*dev->width;
+		if (!dev->fb_native) {
+			lcd_pix_copySwap(ptr, ptr, len);
 		}
-	} else {
-		coord_t _x0 = x0 + dev->offsetx;
-		coord_t _x1 = x1 + dev->offsetx;
-		coord_t _y0 = y0 + dev->offsety;
-		coord_t _y1 = y1 + dev->offsety;
-		size_t size = (size_t)(_x1-_x0+1)*(_y1-_y0+1);
+		sent_bytes += len*sizeof(color_t);
+
+		trans_queue_addr(0x2B, band[i].y0+dev->offsety, band[i].y1+dev->offsety); // Page(y) Address Set
+		uint8_t cmd = 0x2C; // Memory Write
+		trans_queue(&cmd, 1, TRANS_DC_CMD);
+		// Split the band into transfers the DMA can take in one go.
+		size_t bytes = len*sizeof(color_t);
+		const uint8_t *data = (const uint8_t *)ptr;
+		while (bytes) {
+			size_t chunk = (bytes < DMA_MAX_BYTES) ? bytes : DMA_MAX_BYTES;
+			bytes -= chunk;
+			uintptr_t user = TRANS_DC_DATA;
+			if (bytes == 0 && i == n-1) user |= TRANS_END;
+			trans_queue(data, chunk, user);
+			data += chunk;
+		}
+	}
+	dirty_stats.bytes_sent += sent_bytes;
+	dirty_stats.bytes_saved += frame_bytes - sent_bytes;
+}
 
-		spi_master_write_command(dev, 0x2A); // Column(x) Address Set
-		spi_master_write_addr(dev, _x0, _x1);
-		spi_master_write_command(dev, 0x2B); // Page(y) Address Set
-		spi_master_write_addr(dev, _y0, _y1);
-		spi_master_write_command(dev, 0x2C); // Memory Write
-		spi_master_write_color(dev, color, size);
+void lcd_tileEnable(size_t cmd_bytes, coord_t band_h)
+{
+	if (!screen_selected(__func__)) return;
+	if (dev->use_tiles) return;
+	if (dev->use_frame_buffer || dev->use_palette) {
+		ESP_LOGE(TAG, "tile mode not available with frame buffer or palette");
+		return;
+	}
+	if (cmd_bytes == 0) cmd_bytes = TILE_DEF_CMD_BYTES;
+	if (band_h <= 0) band_h = TILE_DEF_BAND_H;
+	size_t max_h = DMA_MAX_BYTES/((size_t)dev->width*sizeof(color_t));
+	if ((size_t)band_h > max_h) band_h = max_h;
+	size_t band_bytes = (size_t)dev->width*band_h*sizeof(color_t);
+	tile_cmd = heap_caps_malloc(cmd_bytes, MALLOC_CAP_32BIT);
+	tile_buf[0] = heap_caps_malloc(band_bytes, MALLOC_CAP_DMA);
+	tile_buf[1] = heap_caps_malloc(band_bytes, MALLOC_CAP_DMA);
+	if (tile_cmd == NULL || tile_buf[0] == NULL || tile_buf[1] == NULL) {
+		ESP_LOGE(TAG, "tile buffer alloc fail");
+		lcd_tileDisable();
+		return;
 	}
+	ESP_LOGI(TAG, "tile buffer alloc success");
+	lcd_tile_init(&tile_list, tile_cmd, cmd_bytes, dev->width, dev->height, band_h);
+	dev->use_tiles = true;
 }
 
-void lcd_drawRoundRect2(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t r, color_t color)
+void lcd_tileDisable(void)
 {
-	coord_t xa;
-	coord_t ya;
-	coord_t err;
-	coord_t old_err;
+	if (!screen_selected(__func__)) return;
+	lcd_tileParallelDisable();
+	lcd_waitFrame();
+	if (tile_cmd != NULL) heap_caps_free(tile_cmd);
+	if (tile_buf[0] != NULL) heap_caps_free(tile_buf[0]);
+	if (tile_buf[1] != NULL) heap_caps_free(tile_buf[1]);
+	tile_cmd = NULL;
+	tile_buf[0] = tile_buf[1] = NULL;
+	dev->use_tiles = false;
+}
 
-	if (x0>x1) swap(coord_t, x0, x1);
-	if (y0>y1) swap(coord_t, y0, y1);
+void lcd_tileParallelEnable(void)
+{
+	if (!screen_selected(__func__)) return;
+	if (par_frame != NULL) return;
+	if (!dev->use_tiles) {
+		ESP_LOGE(TAG, "parallel rasterization needs tile mode");
+		return;
+	}
+	par_frame = heap_caps_malloc((size_t)dev->width*dev->height*sizeof(color_t), MALLOC_CAP_DMA);
+	par_done = xSemaphoreCreateCounting(PAR_WORKERS, 0);
+	if (par_frame == NULL || par_done == NULL) {
+		ESP_LOGE(TAG, "parallel frame alloc fail");
+		lcd_tileParallelDisable();
+		return;
+	}
+	par_quit = false;
+	for (uintptr_t k = 0; k < PAR_WORKERS; k++) {
+		par_start[k] = xSemaphoreCreateBinary();
+		if (par_start[k] == NULL || xTaskCreatePinnedToCore(par_task, "lcd_par",
+			PAR_TASK_STACK, (void *)k, PAR_TASK_PRIO, NULL, k) != pdPASS) {
+			ESP_LOGE(TAG, "parallel worker start fail");
+			lcd_tileParallelDisable();
+			return;
+		}
+		par_workers++;
+	}
+	ESP_LOGI(TAG, "parallel rasterization on %d cores", PAR_WORKERS);
+}
 
-	coord_t w = x1-x0+1-(r<<1);
-	coord_t h = y1-y0+1-(r<<1);
-	if (w < 1 || h < 1) return;
+void lcd_tileParallelDisable(void)
+{
+	if (!screen_selected(__func__)) return;
+	// Stop the workers, each confirms before it exits.
+	par_quit = true;
+	for (uint8_t k = 0; k < par_workers; k++) {
+		xSemaphoreGive(par_start[k]);
+		xSemaphoreTake(par_done, portMAX_DELAY);
+	}
+	par_workers = 0;
+	lcd_waitFrame(); // bands may still be sent from the frame
+	for (uint8_t k = 0; k < PAR_WORKERS; k++) {
+		if (par_start[k] != NULL) vSemaphoreDelete(par_start[k]);
+		par_start[k] = NULL;
+	}
+	if (par_done != NULL) vSemaphoreDelete(par_done);
+	if (par_frame != NULL) heap_caps_free(par_frame);
+	par_done = NULL;
+	par_frame = NULL;
+}
+
+void lcd_tileMap(const lcd_tilemap_t *map)
+{
+	if (!screen_selected(__func__)) return;
+	if (!dev->use_tiles) {
+		ESP_LOGE(TAG, "tilemap needs tile mode");
+		return;
+	}
+	if (map != NULL && (map->size != 8 && map->size != 16)) {
+		ESP_LOGE(TAG, "tilemap tile size must be 8 or 16");
+		return;
+	}
+	if (map != NULL && (map->atlas == NULL || map->index == NULL || map->cols == 0 || map->rows == 0)) {
+		ESP_LOGE(TAG, "tilemap is empty");
+		return;
+	}
+	lcd_tile_map(&tile_list, map);
+}
+
+void lcd_tileMapScroll(coord_t x, coord_t y)
+{
+	if (!screen_selected(__func__)) return;
+	if (!dev->use_tiles) return;
+	lcd_tile_map_scroll(&tile_list, x, y);
+}
+
+void lcd_tileMapUpdate(uint16_t col, uint16_t row, uint16_t cols, uint16_t rows)
+{
+	if (!screen_selected(__func__)) return;
+	if (!dev->use_tiles) return;
+	lcd_tile_map_touch(&tile_list, col, row, cols, rows);
+}
+
+// Fill a table with the closest of n evenly spread levels for each of
+// the values 0 to max-1, as index bits at the given shift.
+static void pal_grid_level(uint8_t *table, int32_t max, int32_t n, uint8_t shift)
+{
+	for (int32_t v = 0; v < max; v++) {
+		int32_t best = 0;
+		for (int32_t k = 1; k < n; k++) {
+			if (abs(k*(max-1)/(n-1) - v) < abs(best*(max-1)/(n-1) - v)) best = k;
+		}
+		table[v] = best << shift;
+	}
+}
+
+void lcd_paletteEnable(const color_t *colors, uint16_t n)
+{
+	if (!screen_selected(__func__)) return;
+	if (dev->use_palette) return;
+	if (dev->use_frame_buffer || dev->use_tiles) {
+		ESP_LOGE(TAG, "palette mode not available with frame buffer or tiles");
+		return;
+	}
+	pal_frame = heap_caps_malloc((size_t)dev->width*dev->height, MALLOC_CAP_8BIT);
+	pal_buf[0] = heap_caps_malloc(PAL_BUF_PIXELS*sizeof(color_t), MALLOC_CAP_DMA);
+	pal_buf[1] = heap_caps_malloc(PAL_BUF_PIXELS*sizeof(color_t), MALLOC_CAP_DMA);
+	if (pal_frame == NULL || pal_buf[0] == NULL || pal_buf[1] == NULL) {
+		ESP_LOGE(TAG, "palette buffer alloc fail");
+		lcd_paletteDisable();
+		return;
+	}
+	ESP_LOGI(TAG, "palette buffer alloc success");
+	dev->use_palette = true;
+	pal_count = 0;
+	if (colors == NULL || n == 0) {
+		// 3 bits of red and green, 2 of blue
+		color_t rgb[256];
+		for (uint16_t i = 0; i < 256; i++) {
+			rgb[i] = (i >> 5)*31/7 << 11 | ((i >> 2) & 7)*63/7 << 5 | (i & 3)*31/3;
+		}
+		lcd_setPalette(0, rgb, 256);
+		pal_grid_level(pal_grid_r, 32, 8, 5);
+		pal_grid_level(pal_grid_g, 64, 8, 2);
+		pal_grid_level(pal_grid_b, 32, 4, 0);
+		pal_grid = true;
+	} else {
+		lcd_setPalette(0, colors, n);
+	}
+	memset(pal_frame, pal_index(BLACK), (size_t)dev->width*dev->height);
+}
+
+void lcd_paletteDisable(void)
+{
+	if (!screen_selected(__func__)) return;
+	lcd_layerDisable();
+	lcd_waitFrame();
+	if (pal_frame != NULL) heap_caps_free(pal_frame);
+	if (pal_buf[0] != NULL) heap_caps_free(pal_buf[0]);
+	if (pal_buf[1] != NULL) heap_caps_free(pal_buf[1]);
+	pal_frame = NULL;
+	pal_buf[0] = pal_buf[1] = NULL;
+	dev->use_palette = false;
+}
+
+void lcd_setPalette(uint8_t first, const color_t *colors, uint16_t n)
+{
+	if (!screen_selected(__func__)) return;
+	if (n > 256-first) n = 256-first;
+	for (uint16_t i = 0; i < n; i++) {
+		pal_rgb[first+i] = colors[i];
+		pal_wire[first+i] = SWAP16(colors[i]);
+	}
+	if (first+n > pal_count) pal_count = first+n;
+	memset(pal_key, 0, sizeof(pal_key)); // colors may map to other entries
+	pal_grid = false;
+	if (dev->use_palette) dirty_reset(); // every pixel may have changed
+}
+
+void lcd_layerEnable(uint8_t n)
+{
+	if (!screen_selected(__func__)) return;
+	if (layer_count) return;
+	if (!dev->use_frame_buffer && !dev->use_palette) {
+		ESP_LOGE(TAG, "layers need a frame buffer or palette mode");
+		return;
+	}
+	if (scroll.height) {
+		ESP_LOGE(TAG, "layers not available while scrolling");
+		return;
+	}
+	if (n > LCD_LAYERS_MAX) n = LCD_LAYERS_MAX;
+	size_t pixels = (size_t)dev->width*dev->height;
+	size_t bytes = dev->use_palette ? pixels : pixels*sizeof(color_t);
+	for (uint8_t i = 0; i <= n; i++) {
+		layer[i].pix = heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+		if (layer[i].pix == NULL) {
+			ESP_LOGE(TAG, "layer alloc fail");
+			while (i--) heap_caps_free(layer[i].pix);
+			return;
+		}
+	}
+	ESP_LOGI(TAG, "layer alloc success");
+	layer_count = n+1;
+	// The background starts as the current image, dynamic layers clear.
+	rect_t full = {0, 0, dev->width-1, dev->height-1};
+	memcpy(layer[0].pix, dev->use_palette ? (void *)pal_frame : (void *)dev->frame_buffer, bytes);
+	for (uint8_t i = 0; i < layer_count; i++) {
+		layer[i].key = LCD_LAYER_KEY;
+		if (i) layer_fill(&layer[i], &full, LCD_LAYER_KEY);
+		rect_list_clear(&layer[i].pend, false);
+		rect_list_clear(&layer[i].drawn, i == 0);
+	}
+	layer_cur = &layer[0];
+}
+
+void lcd_layerDisable(void)
+{
+	if (!screen_selected(__func__)) return;
+	for (uint8_t i = 0; i < layer_count; i++) heap_caps_free(layer[i].pix);
+	layer_count = 0;
+	layer_cur = NULL;
+}
 
-	xa=0;
-	ya=-r;
-	err=2-2*r;
+void lcd_layerSelect(uint8_t l)
+{
+	if (!screen_selected(__func__)) return;
+	if (l < layer_count) layer_cur = &layer[l];
+}
 
-	do {
-		if (xa) {
-			lcd_drawPixel(x0+r-xa, y0+r+ya, color);
-			lcd_drawPixel(x1-r+xa, y0+r+ya, color);
-			lcd_drawPixel(x0+r-xa, y1-r-ya, color);
-			lcd_drawPixel(x1-r+xa, y1-r-ya, color);
+void lcd_layerClear(uint8_t l)
+{
+	if (!screen_selected(__func__)) return;
+	if (l == LCD_LAYER_BACK || l >= layer_count) return;
+	layer_t *p = &layer[l];
+	rect_t full = {0, 0, dev->width-1, dev->height-1};
+	if (p->drawn.full) {
+		layer_fill(p, &full, p->key);
+		rect_list_clear(&p->pend, true);
+	} else {
+		// Only the regions drawn since the last clear hold other colors.
+		for (uint8_t i = 0; i < p->drawn.count; i++) {
+			layer_fill(p, &p->drawn.rect[i], p->key);
+			rect_list_add(&p->pend, &p->drawn.rect[i]);
 		}
-		if ((old_err=err)<=xa)    err+=++xa*2+1;
-		if (old_err>ya || err>xa) err+=++ya*2+1;
-	} while (ya<0);
-	lcd_drawHLine(x0+r, y0,   w, color);
-	lcd_drawHLine(x0+r, y1,   w, color);
-	lcd_drawVLine(x0,   y0+r, h, color);
-	lcd_drawVLine(x1,   y0+r, h, color);
+	}
+	rect_list_clear(&p->drawn, false);
 }
 
-void lcd_fillRoundRect2(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t r, color_t color)
+void lcd_layerSetKey(uint8_t l, color_t key)
 {
-	coord_t xa;
-	coord_t ya;
-	coord_t err;
-	coord_t old_err;
+	if (!screen_selected(__func__)) return;
+	if (l == LCD_LAYER_BACK || l >= layer_count) return;
+	layer[l].key = key;
+	rect_list_clear(&layer[l].drawn, true);
+	lcd_layerClear(l);
+}
 
-	if (x0>x1) swap(coord_t, x0, x1);
-	if (y0>y1) swap(coord_t, y0, y1);
+lcd_canvas_t *lcd_canvasCreate(coord_t w, coord_t h)
+{
+	if (w <= 0 || h <= 0) return NULL;
+	lcd_canvas_t *c = heap_caps_malloc(sizeof(lcd_canvas_t), MALLOC_CAP_8BIT);
+	color_t *pix = heap_caps_malloc((size_t)w*h*sizeof(color_t), MALLOC_CAP_8BIT);
+	if (c == NULL || pix == NULL) {
+		ESP_LOGE(TAG, "canvas alloc fail");
+		if (c != NULL) heap_caps_free(c);
+		if (pix != NULL) heap_caps_free(pix);
+		return NULL;
+	}
+	// Frame buffer mode in CPU byte order, no display attached.
+	c->ctx = (TFT_t){
+		.width = w, .height = h,
+		.font_direction = DIRECTION0, .font_size = 1,
+		.font_back_en = false, .font_back_color = BLACK,
+		.res = -1, .dc = -1, .bl = -1,
+		.use_frame_buffer = true, .frame_buffer = pix,
+		.clip_x0 = 0, .clip_y0 = 0, .clip_x1 = w-1, .clip_y1 = h-1,
+	};
+	lcd_pix_fill(pix, BLACK, (size_t)w*h);
+	return c;
+}
 
-	coord_t w1 = x1-x0+1-(r<<1);
-	coord_t h1 = y1-y0+1-(r<<1);
-	if (w1 < 1 || h1 < 1) return;
+void lcd_canvasDelete(lcd_canvas_t *c)
+{
+	if (c == NULL) return;
+	if (dev == &c->ctx) dev = &device; // selected by the calling task
+	heap_caps_free(c->ctx.frame_buffer);
+	heap_caps_free(c);
+}
 
-	xa=0;
-	ya=-r;
-	err=2-2*r;
+void lcd_canvasSelect(lcd_canvas_t *c)
+{
+	dev = (c != NULL) ? &c->ctx : &device;
+}
 
-	do {
-		if (xa) {
-			lcd_drawHLine(x0+r-xa, y0+r+ya, w1+(xa<<1), color);
-			lcd_drawHLine(x0+r-xa, y1-r-ya, w1+(xa<<1), color);
-		}
-		if ((old_err=err)<=xa)    err+=++xa*2+1;
-		if (old_err>ya || err>xa) err+=++ya*2+1;
-	} while (ya<0);
-	lcd_fillRect(x0, y0+r, x1-x0+1, h1, color);
+void lcd_canvasDraw(const lcd_canvas_t *c, coord_t x, coord_t y)
+{
+	if (c == NULL || dev == &c->ctx) return;
+	lcd_drawRGBBitmap(x, y, c->ctx.frame_buffer, c->ctx.width, c->ctx.height);
 }
 
-//----------------------------------------------------------------------------//
-// Specify center, size, and rotation angle of primitive shape
-//----------------------------------------------------------------------------//
+void lcd_canvasDrawRect(const lcd_canvas_t *c, coord_t x, coord_t y,
+	coord_t sx, coord_t sy, coord_t w, coord_t h)
+{
+	if (c == NULL || dev == &c->ctx) return;
+	// Keep the source inside the canvas.
+	if (sx < 0) {w += sx; x -= sx; sx = 0;}
+	if (sy < 0) {h += sy; y -= sy; sy = 0;}
+	if (sx+w > c->ctx.width) w = c->ctx.width-sx;
+	if (sy+h > c->ctx.height) h = c->ctx.height-sy;
+	if (w <= 0 || h <= 0) return;
+	lcd_drawRGBBitmapRect(x, y, c->ctx.frame_buffer, c->ctx.width, sx, sy, w, h);
+}
 
-/**
- * @details A vertex's final position is calculated by rotating it
- *  around the center point of the primitive by the angle specified.
- * x1 = x * cos(angle) - y * sin(angle) + xc
- * y1 = x * sin(angle) + y * cos(angle) + yc
- */
-void lcd_drawRectC(coord_t xc, coord_t yc, coord_t w, coord_t h, angle_t angle, color_t color)
+// Run a drawing call on a canvas, or on the screen if it is NULL, then
+// restore the target of the calling task. The draw paths read dev rather
+// than take a context, so this only swaps the per task target; see lcd.h
+// for what that allows.
+#define ON_CANVAS(c, call) do { \
+	TFT_t *prev = dev; \
+	dev = ((c) != NULL) ? &(c)->ctx : &device; \
+	call; \
+	dev = prev; \
+} while (0)
+
+void lcd_canvas_draw(lcd_canvas_t *c, const lcd_canvas_t *src, coord_t x, coord_t y)
 {
-	float xd, yd, rd;
-	coord_t x1, y1;
-	coord_t x2, y2;
-	coord_t x3, y3;
-	coord_t x4, y4;
-	rd = -angle * M_PIf / 180.0f; // degrees to radians
-	xd = 0.0f - w/2;
-	yd = h/2;
-	x1 = (coord_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y1 = (coord_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
+	ON_CANVAS(c, lcd_canvasDraw(src, x, y));
+}
 
-	yd = 0.0f - yd;
-	x2 = (coord_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y2 = (coord_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
+void lcd_canvas_drawPart(lcd_canvas_t *c, const lcd_canvas_t *src, coord_t x, coord_t y,
+	coord_t sx, coord_t sy, coord_t w, coord_t h)
+{
+	ON_CANVAS(c, lcd_canvasDrawRect(src, x, y, sx, sy, w, h));
+}
 
-	xd = w/2;
-	yd = h/2;
-	x3 = (coord_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y3 = (coord_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
+void lcd_canvas_setClip(lcd_canvas_t *c, coord_t x, coord_t y, coord_t w, coord_t h)
+{
+	ON_CANVAS(c, lcd_setClip(x, y, w, h));
+}
 
-	yd = 0.0f - yd;
-	x4 = (coord_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y4 = (coord_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
+void lcd_canvas_resetClip(lcd_canvas_t *c)
+{
+	ON_CANVAS(c, lcd_resetClip());
+}
 
-	lcd_drawLine(x1, y1, x2, y2, color);
-	lcd_drawLine(x1, y1, x3, y3, color);
-	lcd_drawLine(x2, y2, x4, y4, color);
-	lcd_drawLine(x3, y3, x4, y4, color);
+void lcd_canvas_setFontDirection(lcd_canvas_t *c, direction_t dir)
+{
+	ON_CANVAS(c, lcd_setFontDirection(dir));
 }
 
-/**
- * @details A vertex's final position is calculated by rotating it
- *  around the center point of the primitive by the angle specified.
- * x1 = x * cos(angle) - y * sin(angle) + xc
- * y1 = x * sin(angle) + y * cos(angle) + yc
- */
-void lcd_drawTriangleC(coord_t xc, coord_t yc, coord_t w, coord_t h, angle_t angle, color_t color)
+void lcd_canvas_setFontSize(lcd_canvas_t *c, uint8_t size)
 {
-	float xd, yd, rd;
-	coord_t x1, y1;
-	coord_t x2, y2;
-	coord_t x3, y3;
-	rd = -angle * M_PIf / 180.0f; // degrees to radians
-	xd = 0.0f;
-	yd = h/2;
-	x1 = (coord_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y1 = (coord_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
+	ON_CANVAS(c, lcd_setFontSize(size));
+}
 
-	xd = w/2;
-	yd = 0.0f - yd;
-	x2 = (coord_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y2 = (coord_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
+void lcd_canvas_setFontBackground(lcd_canvas_t *c, color_t color)
+{
+	ON_CANVAS(c, lcd_setFontBackground(color));
+}
 
-	xd = 0.0f - w/2;
-	x3 = (coord_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y3 = (coord_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
+void lcd_canvas_noFontBackground(lcd_canvas_t *c)
+{
+	ON_CANVAS(c, lcd_noFontBackground());
+}
 
-	lcd_drawLine(x1, y1, x2, y2, color);
-	lcd_drawLine(x1, y1, x3, y3, color);
-	lcd_drawLine(x2, y2, x3, y3, color);
+void lcd_canvas_fillScreen(lcd_canvas_t *c, color_t color)
+{
+	ON_CANVAS(c, lcd_fillScreen(color));
 }
 
-/**
- * @details A vertex's final position is calculated by rotating it
- *  around the center point of the primitive by the angle specified.
- * x1 = x * cos(angle) - y * sin(angle) + xc
- * y1 = x * sin(angle) + y * cos(angle) + yc
- */
-void lcd_drawRegularPolygonC(coord_t xc, coord_t yc, coord_t n, coord_t r, angle_t angle, color_t color)
+void lcd_canvas_drawPixel(lcd_canvas_t *c, coord_t x, coord_t y, color_t color)
 {
-	float xd, yd, rd;
-	coord_t x1, y1;
-	coord_t x2, y2;
-	coord_t i;
+	ON_CANVAS(c, lcd_drawPixel(x, y, color));
+}
 
-	rd = -angle * M_PIf / 180.0f; // degrees to radians
-	for (i = 0; i < n; i++) {
-		xd = r * cosf(2 * M_PIf * i / n);
-		yd = r * sinf(2 * M_PIf * i / n);
-		x1 = (coord_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-		y1 = (coord_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
+void lcd_canvas_drawHPixels(lcd_canvas_t *c, coord_t x, coord_t y, coord_t w, const color_t *colors)
+{
+	ON_CANVAS(c, lcd_drawHPixels(x, y, w, colors));
+}
 
-		xd = r * cosf(2 * M_PIf * (i + 1) / n);
-		yd = r * sinf(2 * M_PIf * (i + 1) / n);
-		x2 = (coord_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-		y2 = (coord_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
+void lcd_canvas_drawHLine(lcd_canvas_t *c, coord_t x, coord_t y, coord_t w, color_t color)
+{
+	ON_CANVAS(c, lcd_drawHLine(x, y, w, color));
+}
 
-		lcd_drawLine(x1, y1, x2, y2, color);
-	}
+void lcd_canvas_drawVLine(lcd_canvas_t *c, coord_t x, coord_t y, coord_t h, color_t color)
+{
+	ON_CANVAS(c, lcd_drawVLine(x, y, h, color));
 }
 
-//----------------------------------------------------------------------------//
-// Draw characters and strings
-//----------------------------------------------------------------------------//
+void lcd_canvas_drawLine(lcd_canvas_t *c, coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color)
+{
+	ON_CANVAS(c, lcd_drawLine(x0, y0, x1, y1, color));
+}
 
-coord_t lcd_drawChar(coord_t x, coord_t y, char ascii, color_t color)
+void lcd_canvas_drawRect(lcd_canvas_t *c, coord_t x, coord_t y, coord_t w, coord_t h, color_t color)
 {
-#if 0
-	if ((x >= dev->width) ||                        // off screen right
-		(y >= dev->height) ||                       // off screen bottom
-		((x + LCD_CHAR_W * dev->font_size) <= 0) || // off screen left
-		((y + LCD_CHAR_H * dev->font_size) <= 0))   // off screen top
-		return;
-#endif
+	ON_CANVAS(c, lcd_drawRect(x, y, w, h, color));
+}
 
-	if (dev->font_back_en) {
-		lcd_fillRect(x, y,
-			LCD_CHAR_W*dev->font_size,
-			LCD_CHAR_H*dev->font_size,
-			dev->font_back_color);
-	}
-	for (int8_t i = 0; i < LCD_CHAR_W; i++) {
-		uint8_t line;
-		if (i == LCD_CHAR_W-1)
-			line = 0x0;
-		else
-			line = font[((uint8_t)ascii * (LCD_CHAR_W-1)) + i];
-		for (int8_t j = 0; j < LCD_CHAR_H; j++) {
-			if (line & 0x1) {
-				if (dev->font_size == 1) // default size
-					lcd_drawPixel(x + i, y + j, color);
-				else { // big size
-					coord_t x1 = x + (i * dev->font_size), y1 = y + (j * dev->font_size);
-					lcd_fillRect(x1, y1, dev->font_size, dev->font_size, color);
-				}
-			}
-#if 0
-			else if (dev->font_back_en) {
-				if (dev->font_size == 1) // default size
-					lcd_drawPixel(x + i, y + j, dev->font_back_color);
-				else { // big size
-					coord_t x1 = x + (i * dev->font_size), y1 = y + (j * dev->font_size);
-					lcd_fillRect(x1, y1, dev->font_size, dev->font_size, dev->font_back_color);
-				}
-			}
-#endif
-			line >>= 1;
-		}
-	}
-	return x+LCD_CHAR_W*dev->font_size;
+void lcd_canvas_fillRect(lcd_canvas_t *c, coord_t x, coord_t y, coord_t w, coord_t h, color_t color)
+{
+	ON_CANVAS(c, lcd_fillRect(x, y, w, h, color));
 }
 
-coord_t lcd_drawString(coord_t x, coord_t y, const char *ascii, color_t color)
+void lcd_canvas_drawTriangle(lcd_canvas_t *c, coord_t x0, coord_t y0, coord_t x1,
+	coord_t y1, coord_t x2, coord_t y2, color_t color)
 {
-	size_t length = strlen(ascii);
-	for (size_t i=0; i<length; i++) {
-		x = lcd_drawChar(x, y, ascii[i], color);
-	}
-	return x;
+	ON_CANVAS(c, lcd_drawTriangle(x0, y0, x1, y1, x2, y2, color));
 }
 
-//----------------------------------------------------------------------------//
-// Font parameters
-//----------------------------------------------------------------------------//
+void lcd_canvas_fillTriangle(lcd_canvas_t *c, coord_t x0, coord_t y0, coord_t x1,
+	coord_t y1, coord_t x2, coord_t y2, color_t color)
+{
+	ON_CANVAS(c, lcd_fillTriangle(x0, y0, x1, y1, x2, y2, color));
+}
 
-void lcd_setFontDirection(direction_t dir)
+void lcd_canvas_drawCircle(lcd_canvas_t *c, coord_t xc, coord_t yc, coord_t r, color_t color)
 {
-	// TODO: implement, currently direction always 0
-	dev->font_direction = dir;
+	ON_CANVAS(c, lcd_drawCircle(xc, yc, r, color));
 }
 
-void lcd_setFontSize(uint8_t size)
+void lcd_canvas_fillCircle(lcd_canvas_t *c, coord_t xc, coord_t yc, coord_t r, color_t color)
 {
-	if (size < 1) return;
-	dev->font_size = size;
+	ON_CANVAS(c, lcd_fillCircle(xc, yc, r, color));
 }
 
-void lcd_setFontBackground(color_t color)
+void lcd_canvas_drawRoundRect(lcd_canvas_t *c, coord_t x, coord_t y,
+	coord_t w, coord_t h, coord_t r, color_t color)
 {
-	dev->font_back_en = true;
-	dev->font_back_color = color;
+	ON_CANVAS(c, lcd_drawRoundRect(x, y, w, h, r, color));
 }
 
-void lcd_noFontBackground(void)
+void lcd_canvas_fillRoundRect(lcd_canvas_t *c, coord_t x, coord_t y,
+	coord_t w, coord_t h, coord_t r, color_t color)
 {
-	dev->font_back_en = false;
+	ON_CANVAS(c, lcd_fillRoundRect(x, y, w, h, r, color));
 }
 
-//----------------------------------------------------------------------------//
-// Display configuration
-//----------------------------------------------------------------------------//
+void lcd_canvas_drawArrow(lcd_canvas_t *c, coord_t x0, coord_t y0,
+	coord_t x1, coord_t y1, coord_t w, color_t color)
+{
+	ON_CANVAS(c, lcd_drawArrow(x0, y0, x1, y1, w, color));
+}
 
-void lcd_spiClockFreq(int32_t freq)
+void lcd_canvas_fillArrow(lcd_canvas_t *c, coord_t x0, coord_t y0,
+	coord_t x1, coord_t y1, coord_t w, color_t color)
 {
-	ESP_LOGI(TAG, "SPI clock frequency=%d MHz", (int)freq/1000000);
-	clock_freq_hz = freq;
+	ON_CANVAS(c, lcd_fillArrow(x0, y0, x1, y1, w, color));
 }
 
-void lcd_displayOff(void)
+void lcd_canvas_drawBitmap(lcd_canvas_t *c, coord_t x, coord_t y,
+	const uint8_t *bitmap, coord_t w, coord_t h, color_t color)
 {
-	spi_master_write_command(dev, 0x28); // Display OFF (28h), DISPOFF (28h): Display Off
+	ON_CANVAS(c, lcd_drawBitmap(x, y, bitmap, w, h, color));
 }
 
-void lcd_displayOn(void)
+void lcd_canvas_drawBitmapRLE(lcd_canvas_t *c, coord_t x, coord_t y, const lcd_rle_t *rle, color_t color)
 {
-	spi_master_write_command(dev, 0x29); // Display ON (29h), DISPON (29h): Display On
+	ON_CANVAS(c, lcd_drawBitmapRLE(x, y, rle, color));
 }
 
-void lcd_backlightOff(void)
+void lcd_canvas_drawBitmapRLEOpaque(lcd_canvas_t *c, coord_t x, coord_t y,
+	const lcd_rle_t *rle, color_t color, color_t bg)
 {
-	if (dev->bl >= 0) {
-		gpio_set_level(dev->bl, 0);
-	}
+	ON_CANVAS(c, lcd_drawBitmapRLEOpaque(x, y, rle, color, bg));
 }
 
-void lcd_backlightOn(void)
+void lcd_canvas_drawRGBBitmapRLE(lcd_canvas_t *c, coord_t x, coord_t y, const lcd_rle_rgb_t *rle)
 {
-	if (dev->bl >= 0) {
-		gpio_set_level(dev->bl, 1);
-	}
+	ON_CANVAS(c, lcd_drawRGBBitmapRLE(x, y, rle));
 }
 
-void lcd_inversionOff(void)
+void lcd_canvas_drawRGBBitmap(lcd_canvas_t *c, coord_t x, coord_t y,
+	const color_t *bitmap, coord_t w, coord_t h)
 {
-	spi_master_write_command(dev, 0x20); // Display Inversion OFF (20h), INVOFF (20h): Display Inversion Off
+	ON_CANVAS(c, lcd_drawRGBBitmap(x, y, bitmap, w, h));
 }
 
-void lcd_inversionOn(void)
+void lcd_canvas_drawRGBBitmapRect(lcd_canvas_t *c, coord_t x, coord_t y, const color_t *bitmap,
+	coord_t stride, coord_t sx, coord_t sy, coord_t w, coord_t h)
 {
-	spi_master_write_command(dev, 0x21); // Display Inversion ON (21h), INVON (21h): Display Inversion On
+	ON_CANVAS(c, lcd_drawRGBBitmapRect(x, y, bitmap, stride, sx, sy, w, h));
 }
 
-//----------------------------------------------------------------------------//
-// Frame management
-//----------------------------------------------------------------------------//
+void lcd_canvas_drawRect2(lcd_canvas_t *c, coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color)
+{
+	ON_CANVAS(c, lcd_drawRect2(x0, y0, x1, y1, color));
+}
 
-void lcd_frameEnable(void)
+void lcd_canvas_fillRect2(lcd_canvas_t *c, coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color)
 {
-	if (dev->use_frame_buffer == true) return;
-	dev->frame_buffer = heap_caps_malloc(sizeof(color_t)*dev->width*dev->height, MALLOC_CAP_DMA);
-	if (dev->frame_buffer == NULL) {
-		ESP_LOGE(TAG, "frame buffer alloc fail");
-	} else {
-		ESP_LOGI(TAG, "frame buffer alloc success");
-		dev->use_frame_buffer = true;
-	}
+	ON_CANVAS(c, lcd_fillRect2(x0, y0, x1, y1, color));
 }
 
-void lcd_frameDisable(void)
+void lcd_canvas_drawRoundRect2(lcd_canvas_t *c, coord_t x0, coord_t y0,
+	coord_t x1, coord_t y1, coord_t r, color_t color)
 {
-	if (dev->frame_buffer != NULL) heap_caps_free(dev->frame_buffer);
-	dev->frame_buffer = NULL;
-	dev->use_frame_buffer = false;
+	ON_CANVAS(c, lcd_drawRoundRect2(x0, y0, x1, y1, r, color));
 }
 
-color_t *lcd_getFrameBuffer(void)
+void lcd_canvas_fillRoundRect2(lcd_canvas_t *c, coord_t x0, coord_t y0,
+	coord_t x1, coord_t y1, coord_t r, color_t color)
 {
-	return dev->frame_buffer;
+	ON_CANVAS(c, lcd_fillRoundRect2(x0, y0, x1, y1, r, color));
 }
 
-void lcd_wrapAround(scroll_t scroll, coord_t start, coord_t end)
+void lcd_canvas_drawRectC(lcd_canvas_t *c, coord_t xc, coord_t yc,
+	coord_t w, coord_t h, angle_t angle, color_t color)
 {
-	if (dev->use_frame_buffer == false) return;
+	ON_CANVAS(c, lcd_drawRectC(xc, yc, w, h, angle, color));
+}
 
-	coord_t fb_w = dev->width;
-	coord_t fb_h = dev->height;
-	size_t index1;
-	size_t index2;
+void lcd_canvas_drawTriangleC(lcd_canvas_t *c, coord_t xc, coord_t yc,
+	coord_t w, coord_t h, angle_t angle, color_t color)
+{
+	ON_CANVAS(c, lcd_drawTriangleC(xc, yc, w, h, angle, color));
+}
 
-	switch (scroll) {
-	case SCROLL_RIGHT: {
-		color_t wk[fb_w];
-		for (size_t i=start;i<=end;i++) {
-			index1 = i * fb_w;
-			memcpy((char *)wk, (char*)&dev->frame_buffer[index1], fb_w*sizeof(color_t));
-			index2 = index1 + fb_w - 1;
-			dev->frame_buffer[index1] = dev->frame_buffer[index2];
-			memcpy((char *)&dev->frame_buffer[index1+1], (char *)&wk[0], (fb_w-1)*sizeof(color_t));
-		}
-		break; }
-	case SCROLL_LEFT: {
-		color_t wk[fb_w];
-		for (size_t i=start;i<=end;i++) {
-			index1 = i * fb_w;
-			memcpy((char *)wk, (char*)&dev->frame_buffer[index1], fb_w*sizeof(color_t));
-			index2 = index1 + fb_w - 1;
-			dev->frame_buffer[index2] = dev->frame_buffer[index1];
-			memcpy((char *)&dev->frame_buffer[index1], (char *)&wk[1], (fb_w-1)*sizeof(color_t));
-		}
-		break; }
-	case SCROLL_DOWN: {
-		color_t wk;
-		for (size_t i=start;i<=end;i++) {
-			index2 = (size_t)(fb_h-1) * fb_w + i;
-			wk = dev->frame_buffer[index2];
-			for (ssize_t j=fb_h-2;j>=0;j--) {
-				index1 = j * fb_w + i;
-				index2 = (j+1) * fb_w + i;
-				dev->frame_buffer[index2] = dev->frame_buffer[index1];
-			}
-			dev->frame_buffer[i] = wk;
-		}
-		break; }
-	case SCROLL_UP: {
-		color_t wk;
-		for (size_t i=start;i<=end;i++) {
-			wk = dev->frame_buffer[i];
-			for (size_t j=0;j<fb_h-1;j++) {
-				index1 = j * fb_w + i;
-				index2 = (j+1) * fb_w + i;
-				dev->frame_buffer[index1] = dev->frame_buffer[index2];
-			}
-			index2 = (size_t)(fb_h-1) * fb_w + i;
-			dev->frame_buffer[index2] = wk;
-		}
-		break; }
-	}
+void lcd_canvas_drawRegularPolygonC(lcd_canvas_t *c, coord_t xc, coord_t yc,
+	coord_t n, coord_t r, angle_t angle, color_t color)
+{
+	ON_CANVAS(c, lcd_drawRegularPolygonC(xc, yc, n, r, angle, color));
 }
 
-void lcd_writeFrame(void)
+coord_t lcd_canvas_drawChar(lcd_canvas_t *c, coord_t x, coord_t y, char ascii, color_t color)
 {
-	if (dev->use_frame_buffer == false) return;
+	coord_t end;
+	ON_CANVAS(c, end = lcd_drawChar(x, y, ascii, color));
+	return end;
+}
+
+coord_t lcd_canvas_drawString(lcd_canvas_t *c, coord_t x, coord_t y, const char *ascii, color_t color)
+{
+	coord_t end;
+	ON_CANVAS(c, end = lcd_drawString(x, y, ascii, color));
+	return end;
+}
 
-	spi_master_write_command(dev, 0x2A); // Column(x) Address Set
-	spi_master_write_addr(dev, dev->offsetx, dev->offsetx+dev->width-1);
-	spi_master_write_command(dev, 0x2B); // Page(y) Address Set
-	spi_master_write_addr(dev, dev->offsety, dev->offsety+dev->height-1);
-	spi_master_write_command(dev, 0x2C); // Memory Write
-	spi_master_write_colors(dev, dev->frame_buffer, dev->width*dev->height);
+void lcd_waitFrame(void)
+{
+	if (!screen_selected(__func__)) return;
+	STAT(LCD_STAT_FRAME);
+	trans_reap(trans_queued);
+	stream_pos = 0; // staged data is no longer referenced
+}
 
-#if 0
-	size_t size = (size_t)dev->width*dev->height;
-	color_t *image = dev->frame_buffer;
-	while (size > 0) {
-		// 1024 bytes per time.
-		size_t bs = (size > 512) ? 512 : size;
-		spi_master_write_colors(dev, image, bs);
-		size -= bs;
-		image += bs;
-	}
-#endif
-	return;
+void lcd_setFrameCallback(lcd_frame_cb_t cb, void *arg)
+{
+	if (!screen_selected(__func__)) return;
+	lcd_waitFrame();
+	frame_cb = cb;
+	frame_cb_arg = arg;
 }
@@ -10,6 +10,7 @@
  * for more detail about the coordinate system and graphics primitives.
  */
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "hw.h"
@@ -66,6 +67,112 @@ typedef enum {
 	DIRECTION270
 } direction_t;
 
+/** @brief Maximum number of dirty rectangles tracked per frame. */
+#define LCD_DIRTY_RECTS 16
+
+/** @brief Horizontal run of set pixels in a run-length encoded bitmap. */
+typedef struct {
+	uint16_t x;   /**< Start column. */
+	uint16_t len; /**< Length in pixels. */
+} lcd_run_t;
+
+/** @brief Monochrome bitmap encoded as runs of set pixels on each row. */
+typedef struct {
+	coord_t w;            /**< Width in pixels. */
+	coord_t h;            /**< Height in pixels. */
+	const uint16_t *row;  /**< Index of the first run of each row, h+1 entries. */
+	const lcd_run_t *run; /**< Runs of set pixels, row by row. */
+} lcd_rle_t;
+
+/** @brief Background grid of tile indices into a shared atlas of tiles. */
+typedef struct {
+	const color_t *atlas;  /**< Tile pixels, one tile after another, each row by row. */
+	const uint8_t *index;  /**< Atlas tile of each cell, row by row, cols*rows entries. */
+	uint16_t cols;         /**< Map width in tiles. */
+	uint16_t rows;         /**< Map height in tiles. */
+	uint8_t size;          /**< Tile width and height in pixels, 8 or 16. */
+} lcd_tilemap_t;
+
+/** @brief Flag in lcd_rgb_run_t.len for a run of one color. */
+#define LCD_RUN_FILL 0x8000
+
+/** @brief Run of opaque pixels in a color image. */
+typedef struct {
+	uint16_t x;   /**< Start column. */
+	uint16_t len; /**< Length in pixels, with LCD_RUN_FILL for one color. */
+	uint32_t pix; /**< The color of a fill run, else the index of its first pixel. */
+} lcd_rgb_run_t;
+
+/** @brief Color image encoded as runs of opaque pixels on each row. */
+typedef struct {
+	coord_t w;                /**< Width in pixels. */
+	coord_t h;                /**< Height in pixels. */
+	const uint16_t *row;      /**< Index of the first run of each row, h+1 entries. */
+	const lcd_rgb_run_t *run; /**< Runs of opaque pixels, row by row. */
+	const color_t *pix;       /**< Pixels of the runs that are not fills. */
+} lcd_rle_rgb_t;
+
+/** @brief Counters for partial frame writes. */
+typedef struct {
+	uint32_t frames;      /**< Frames written with lcd_writeFrame(). */
+	uint32_t full_frames; /**< Frames that were sent in full. */
+	uint32_t rects;       /**< Dirty rectangles sent in partial frames. */
+	uint64_t bytes_sent;  /**< Pixel bytes sent to the display. */
+	uint64_t bytes_saved; /**< Pixel bytes not sent compared to full frames. */
+} lcd_dirty_stats_t;
+
+/** @brief Groups of primitives that display traffic is counted for.
+ *  @details Traffic is charged to the outermost call, so lines drawn by
+ *  lcd_fillCircle() count as LCD_STAT_FILL_CIRCLE. Pixels drawn more than
+ *  once by a call count each time, so comparing them with the area of the
+ *  shapes shows overdraw. */
+typedef enum {
+	LCD_STAT_OTHER,           /**< Setup and display commands. */
+	LCD_STAT_FILL_SCREEN,     /**< lcd_fillScreen(). */
+	LCD_STAT_PIXEL,           /**< lcd_drawPixel(), lcd_drawHPixels(). */
+	LCD_STAT_HVLINE,          /**< lcd_drawHLine(), lcd_drawVLine(). */
+	LCD_STAT_LINE,            /**< lcd_drawLine(). */
+	LCD_STAT_RECT,            /**< lcd_drawRect(), lcd_drawRect2(), lcd_drawRectC(). */
+	LCD_STAT_FILL_RECT,       /**< lcd_fillRect(), lcd_fillRect2(). */
+	LCD_STAT_TRIANGLE,        /**< lcd_drawTriangle(), lcd_drawTriangleC(). */
+	LCD_STAT_FILL_TRIANGLE,   /**< lcd_fillTriangle(). */
+	LCD_STAT_CIRCLE,          /**< lcd_drawCircle(). */
+	LCD_STAT_FILL_CIRCLE,     /**< lcd_fillCircle(). */
+	LCD_STAT_ROUND_RECT,      /**< lcd_drawRoundRect(), lcd_drawRoundRect2(). */
+	LCD_STAT_FILL_ROUND_RECT, /**< lcd_fillRoundRect(), lcd_fillRoundRect2(). */
+	LCD_STAT_ARROW,           /**< lcd_drawArrow(), lcd_fillArrow(). */
+	LCD_STAT_POLYGON,         /**< lcd_drawRegularPolygonC(). */
+	LCD_STAT_BITMAP,          /**< 1-bit and RLE bitmaps. */
+	LCD_STAT_RGB_BITMAP,      /**< lcd_drawRGBBitmap(), lcd_drawRGBBitmapRect(). */
+	LCD_STAT_TEXT,            /**< lcd_drawChar(), lcd_drawString(). */
+	LCD_STAT_SCROLL,          /**< lcd_wrapAround() and lcd_scroll functions. */
+	LCD_STAT_FRAME,           /**< Frame writes and waits. */
+	LCD_STAT_COUNT
+} lcd_stat_t;
+
+/** @brief Counters for display traffic. */
+typedef struct {
+	uint32_t calls;        /**< Outermost calls. */
+	uint32_t transactions; /**< SPI transactions, polled or queued. */
+	uint32_t windows;      /**< Address window commands sent. */
+	uint32_t window_skips; /**< Address window commands not needed. */
+	uint64_t wait_us;      /**< Time waiting for SPI transfers to finish. */
+	uint64_t cmd_bytes;    /**< Command bytes sent. */
+	uint64_t data_bytes;   /**< Parameter and pixel bytes sent. */
+	uint64_t pixels;       /**< Pixels drawn after clipping, counting overdraw. */
+} lcd_stat_counts_t;
+
+/** @brief Display traffic by primitive group. */
+typedef struct {
+	lcd_stat_counts_t total;                /**< Sum of all groups. */
+	lcd_stat_counts_t prim[LCD_STAT_COUNT]; /**< Counters by group. */
+	uint32_t frames; /**< Frames pushed by lcd_writeFrame() or lcd_writeFrameAsync(). */
+} lcd_stats_t;
+
+/** @brief Callback for completion of an asynchronous frame write.
+ *  @details Called from interrupt context. */
+typedef void (*lcd_frame_cb_t)(void *arg);
+
 /** @brief Scroll type for movement of screen image. */
 typedef enum {
 	SCROLL_RIGHT = 1,
@@ -79,11 +186,34 @@ typedef enum {
  */
 void lcd_init(void);
 
+/** @name Clipping. */
+/** @{ */
+
+/**
+ * @brief Limit drawing to a rectangle.
+ * @details All draw and fill primitives leave pixels outside the rectangle
+ *  unchanged, and shapes entirely outside it are rejected before any work.
+ *  lcd_fillScreen() fills only the rectangle. The rectangle is limited to
+ *  the screen and may be empty. Scrolling and frame writes are not affected.
+ * @param x X coordinate of the top left corner.
+ * @param y Y coordinate of the top left corner.
+ * @param w Width of the rectangle.
+ * @param h Height of the rectangle.
+ */
+void lcd_setClip(coord_t x, coord_t y, coord_t w, coord_t h);
+
+/**
+ * @brief Allow drawing on the whole screen again.
+ */
+void lcd_resetClip(void);
+
+/** @} */
+
 /** @name Draw (outline) and fill primitives. */
 /** @{ */
 
 /**
- * @brief Fill the screen with one color.
+ * @brief Fill the screen, or the clip rectangle if one is set, with one color.
  * @param color Color value.
  */
 void lcd_fillScreen(color_t color);
@@ -167,6 +297,9 @@ void lcd_drawTriangle(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t x2
 
 /**
  * @brief Draw a filled triangle using 3 arbitrary points.
+ * @details Pixels on the right and bottom edges are left out, so triangles
+ *  that share an edge tile without overlap. A triangle with no area draws
+ *  nothing. Draw lcd_drawTriangle() over it for the full outline.
  * @param x0    X coordinate for Vertex 0.
  * @param y0    Y coordinate for Vertex 0.
  * @param x1    X coordinate for Vertex 1.
@@ -230,6 +363,8 @@ void lcd_drawArrow(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t w, co
 
 /**
  * @brief Draw filled arrow.
+ * @details The head is filled by lcd_fillTriangle(), so pixels on its
+ *  right and bottom edges are left out.
  * @param x0    Begin X coordinate.
  * @param y0    Begin Y coordinate.
  * @param x1    End (arrow point) X coordinate.
@@ -253,6 +388,87 @@ void lcd_fillArrow(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t w, co
  */
 void lcd_drawBitmap(coord_t x, coord_t y, const uint8_t *bitmap, coord_t w, coord_t h, color_t color);
 
+/**
+ * @brief Encode a monochrome bitmap as horizontal runs of set pixels.
+ * @details Do this once when a bitmap is loaded, then draw it with
+ *  lcd_drawBitmapRLE(). The result is one allocation. A table with the same
+ *  layout can also be generated ahead of time and declared const.
+ * @param bitmap Byte array with monochrome bitmap, as for lcd_drawBitmap().
+ * @param w      Width of bitmap in pixels.
+ * @param h      Height of bitmap in pixels.
+ * @returns A pointer to the encoded bitmap, or NULL on failure.
+ */
+lcd_rle_t *lcd_rleEncode(const uint8_t *bitmap, coord_t w, coord_t h);
+
+/**
+ * @brief Free a bitmap returned by lcd_rleEncode().
+ * @param rle Encoded bitmap.
+ */
+void lcd_rleFree(lcd_rle_t *rle);
+
+/**
+ * @brief Draw a run-length encoded monochrome bitmap. Unset pixels are
+ *  transparent.
+ * @param x     Top left corner X coordinate.
+ * @param y     Top left corner Y coordinate.
+ * @param rle   Encoded bitmap.
+ * @param color Color value.
+ */
+void lcd_drawBitmapRLE(coord_t x, coord_t y, const lcd_rle_t *rle, color_t color);
+
+/**
+ * @brief Draw a run-length encoded monochrome bitmap with a background
+ *  color for unset pixels.
+ * @details When the bitmap is fully on screen and there is no frame buffer,
+ *  it is sent as one address window.
+ * @param x     Top left corner X coordinate.
+ * @param y     Top left corner Y coordinate.
+ * @param rle   Encoded bitmap.
+ * @param color Color value for set pixels.
+ * @param bg    Color value for unset pixels.
+ */
+void lcd_drawBitmapRLEOpaque(coord_t x, coord_t y, const lcd_rle_t *rle, color_t color, color_t bg);
+
+/**
+ * @brief Encode a color image as runs of opaque pixels.
+ * @details Pixels of the key color are transparent and not stored. Runs of
+ *  one color are stored as a fill, others as literal pixels. The result is
+ *  one allocation, and like lcd_rleEncode() the layout can be generated
+ *  ahead of time and declared const.
+ * @param bitmap Array of color values, one for each pixel, length = w * h.
+ * @param w      Width of bitmap in pixels.
+ * @param h      Height of bitmap in pixels.
+ * @param key    Transparent color.
+ * @returns A pointer to the encoded image, or NULL on failure.
+ */
+lcd_rle_rgb_t *lcd_rleEncodeRGB(const color_t *bitmap, coord_t w, coord_t h, color_t key);
+
+/**
+ * @brief Encode a monochrome bitmap as a color image with set pixels in
+ *  one color and unset pixels transparent.
+ * @param bitmap Byte array with monochrome bitmap, as for lcd_drawBitmap().
+ * @param w      Width of bitmap in pixels.
+ * @param h      Height of bitmap in pixels.
+ * @param color  Color of set pixels.
+ * @returns A pointer to the encoded image, or NULL on failure.
+ */
+lcd_rle_rgb_t *lcd_rleEncodeMonoRGB(const uint8_t *bitmap, coord_t w, coord_t h, color_t color);
+
+/**
+ * @brief Free an image returned by lcd_rleEncodeRGB() or lcd_rleEncodeMonoRGB().
+ * @param rle Encoded image.
+ */
+void lcd_rleFreeRGB(lcd_rle_rgb_t *rle);
+
+/**
+ * @brief Draw a run-length encoded color image. Only its opaque pixels are
+ *  written, the rest of the destination is unchanged.
+ * @param x   Top left corner X coordinate.
+ * @param y   Top left corner Y coordinate.
+ * @param rle Encoded image.
+ */
+void lcd_drawRGBBitmapRLE(coord_t x, coord_t y, const lcd_rle_rgb_t *rle);
+
 /**
  * @brief Draw an image at the specified location.
  * @param x      Top left corner X coordinate.
@@ -263,6 +479,22 @@ void lcd_drawBitmap(coord_t x, coord_t y, const uint8_t *bitmap, coord_t w, coor
  */
 void lcd_drawRGBBitmap(coord_t x, coord_t y, const color_t *bitmap, coord_t w, coord_t h);
 
+/**
+ * @brief Draw part of an image, such as one frame of a sprite sheet.
+ * @details The clipped rectangle is sent as one address window, or copied
+ *  row by row into the frame buffer.
+ * @param x      Top left corner X coordinate on the screen.
+ * @param y      Top left corner Y coordinate on the screen.
+ * @param bitmap Array of color values for the whole source image.
+ * @param stride Width of the source image in pixels (row stride).
+ * @param sx     Left column of the source rectangle.
+ * @param sy     Top row of the source rectangle.
+ * @param w      Width of the source rectangle in pixels.
+ * @param h      Height of the source rectangle in pixels.
+ */
+void lcd_drawRGBBitmapRect(coord_t x, coord_t y, const color_t *bitmap, coord_t stride,
+	coord_t sx, coord_t sy, coord_t w, coord_t h);
+
 /** @} */
 
 /** @name Rectangle variants that specify two diagonal corners. */
@@ -402,6 +634,16 @@ void lcd_setFontBackground(color_t color);
  */
 void lcd_noFontBackground(void);
 
+/**
+ * @brief Set the size of the glyph cache.
+ * @details Characters drawn with a background are expanded into pixel cells
+ *  kept in a least recently used cache, keyed by character, font size and
+ *  colors. Glyphs that do not fit are expanded as they are drawn. The
+ *  default size is 4 KB, about 40 characters at font size 1.
+ * @param bytes Cache size in bytes, 0 to disable the cache.
+ */
+void lcd_setGlyphCache(size_t bytes);
+
 /** @} */
 
 /** @name Display configuration. */
@@ -443,6 +685,27 @@ void lcd_inversionOff(void);
  */
 void lcd_inversionOn(void);
 
+/**
+ * @brief Get counters for display traffic, in total and by primitive.
+ * @details Counting is always on. Wait time covers polling transfers and
+ *  waits for queued transfers, so it shows how much of a slow frame is
+ *  spent on the bus rather than drawing.
+ * @param stats Pointer to the structure to receive the counters.
+ */
+void lcd_getStats(lcd_stats_t *stats);
+
+/**
+ * @brief Reset the counters for display traffic.
+ */
+void lcd_resetStats(void);
+
+/**
+ * @brief Get a short name for a primitive group, for reports.
+ * @param prim Primitive group.
+ * @returns Name of the group.
+ */
+const char *lcd_statName(lcd_stat_t prim);
+
 /** @} */
 
 /** @name Frame management. */
@@ -458,9 +721,31 @@ void lcd_frameEnable(void);
  */
 void lcd_frameDisable(void);
 
+/**
+ * @brief Allocate a frame buffer at half the screen resolution and enable
+ *  its use.
+ * @details The frame buffer is LCD_W/2 by LCD_H/2 pixels, a quarter of the
+ *  full size, and all coordinates are in that space. lcd_writeFrame() scales
+ *  the modified regions up 2x as it sends them, through two small buffers,
+ *  so no full size image is ever held in memory.
+ * @note  Requires direct mode. Scrolling and the second frame buffer are not
+ *  available. lcd_writeFrameAsync() returns once the last chunk is queued.
+ *  lcd_frameDisable() also ends half resolution mode.
+ */
+void lcd_frameHalfEnable(void);
+
+/**
+ * @brief Deallocate the half resolution frame buffer and return to direct
+ *  mode at full resolution.
+ */
+void lcd_frameHalfDisable(void);
+
 /**
  * @brief Get the frame buffer.
  * @returns A pointer to the frame buffer or NULL if not allocated.
+ * @note  While scrolling is enabled, rows of the scroll region are stored
+ *  as a ring, so screen rows are not in order in the frame buffer. With
+ *  dirty tracking enabled, report writes with lcd_markDirty().
  */
 color_t *lcd_getFrameBuffer(void);
 
@@ -469,15 +754,837 @@ color_t *lcd_getFrameBuffer(void);
  * @param scroll Scroll direction.
  * @param start  Start of range in X or Y (depends on scroll direction).
  * @param end    End of range in X or Y (depends on scroll direction).
- * @note  Requires frame buffer to be enabled.
+ * @note  Requires frame buffer to be enabled. Scrolling the full width up
+ *  or down is a call to lcd_scroll() when scrolling is enabled for the
+ *  whole screen.
  */
 void lcd_wrapAround(scroll_t scroll, coord_t start, coord_t end);
 
 /**
- * @brief Write frame buffer to display. Requires frame buffer to be enabled.
+ * @brief Enable vertical scrolling of the rows between fixed areas at the
+ *  top and bottom of the screen.
+ * @details The scroll region is kept as a ring of rows in the frame buffer,
+ *  so lcd_scroll() takes constant time. If the panel supports vertical
+ *  scroll (VSCRDEF/VSCRSADD), its memory holds the same ring and a scroll
+ *  step sends only the rows drawn since. Otherwise the region is sent in
+ *  full on the next frame write.
+ * @param top    Rows fixed at the top of the screen.
+ * @param bottom Rows fixed at the bottom of the screen.
+ * @note  Requires frame buffer to be enabled. While scrolling is enabled,
+ *  lcd_writeFrameAsync() writes the frame like lcd_writeFrame().
+ */
+void lcd_scrollEnable(coord_t top, coord_t bottom);
+
+/**
+ * @brief Disable vertical scrolling. The frame buffer is put back in
+ *  screen order and the panel follows on the next frame write.
+ */
+void lcd_scrollDisable(void);
+
+/**
+ * @brief Scroll the region set by lcd_scrollEnable(). Rows moved out of
+ *  one end of the region come back in at the other end.
+ * @param rows Rows to move the image up, negative moves it down.
+ */
+void lcd_scroll(coord_t rows);
+
+/**
+ * @brief Write frame buffer to display. Without a frame buffer, wait for
+ *  queued draw calls to reach the display.
+ * @details The whole frame is sent unless dirty tracking is enabled with
+ *  lcd_setDirtyPolicy(). Then only the regions modified since the last
+ *  write are sent. Drawing primitives record the regions they touch, and
+ *  a screen fill with the same color as the previous fill only changes
+ *  the regions drawn since then.
  */
 void lcd_writeFrame(void);
 
+/**
+ * @brief Keep frame buffer pixels in display (big-endian) byte order.
+ * @details Frames are then sent straight from the frame buffer without a
+ *  byte-swapping copy. Drawing primitives store swapped values, so pixels
+ *  read or written through lcd_getFrameBuffer() are byte swapped too.
+ *  The current image is converted.
+ */
+void lcd_frameNativeEnable(void);
+
+/**
+ * @brief Keep frame buffer pixels in CPU byte order (default).
+ * @details The current image is converted.
+ */
+void lcd_frameNativeDisable(void);
+
+/**
+ * @brief Allocate a second frame buffer for asynchronous frame writes.
+ * @details Each write copies the rows changed since the last one into the
+ *  other buffer. If dirty tracking is off, it is turned on with 8
+ *  rectangles until lcd_frameDoubleDisable(), so that the whole frame is
+ *  not copied every time. Writes through lcd_getFrameBuffer() must then be
+ *  reported with lcd_markDirty().
+ * @note  Requires frame buffer to be enabled. The second buffer is the same
+ *  size as the first and must also be DMA capable.
+ */
+void lcd_frameDoubleEnable(void);
+
+/**
+ * @brief Deallocate the second frame buffer. Dirty tracking turned on by
+ *  lcd_frameDoubleEnable() is turned off again.
+ */
+void lcd_frameDoubleDisable(void);
+
+/**
+ * @brief Start writing the frame buffer to the display and return without
+ *  waiting for the transfer to finish.
+ * @details The frame is queued as DMA transactions from one buffer while
+ *  drawing continues in the other. Both buffers hold the same image after
+ *  the call, so drawing picks up where the submitted frame left off.
+ *  Without a second buffer, this is the same as lcd_writeFrame().
+ * @note  The address returned by lcd_getFrameBuffer() changes on each call.
+ */
+void lcd_writeFrameAsync(void);
+
+/**
+ * @brief Wait for an asynchronous frame write to complete.
+ * @note  Any other display access also waits for a frame in progress.
+ */
+void lcd_waitFrame(void);
+
+/**
+ * @brief Set a function called when an asynchronous frame write completes.
+ * @param cb  Callback function, or NULL for none. Runs in interrupt context.
+ * @param arg Argument passed to the callback.
+ */
+void lcd_setFrameCallback(lcd_frame_cb_t cb, void *arg);
+
+/**
+ * @brief Mark a region of the frame buffer as modified.
+ * @param x Top left corner X coordinate.
+ * @param y Top left corner Y coordinate.
+ * @param w Width in pixels.
+ * @param h Height in pixels.
+ * @note  Only needed with dirty tracking enabled, when writing through the
+ *  pointer from lcd_getFrameBuffer().
+ */
+void lcd_markDirty(coord_t x, coord_t y, coord_t w, coord_t h);
+
+/**
+ * @brief Enable dirty tracking and set the merge policy for its rectangles.
+ * @details Tracking is off by default, unless double buffered (see
+ *  lcd_frameDoubleEnable()), so pixels written through lcd_getFrameBuffer()
+ *  are always sent. With tracking on, such writes must be reported with
+ *  lcd_markDirty(). 8 rectangles and a coalesce of 256 pixels suit most
+ *  scenes. A policy set here stays after lcd_frameDoubleDisable().
+ * @param max_rects Rectangles kept before the closest pair is merged, up to
+ *  LCD_DIRTY_RECTS. Zero disables tracking and always sends full frames.
+ * @param coalesce  Two rectangles are merged when their bounding box adds at
+ *  most this many pixels not covered by either one.
+ * @note  The next frame after a policy change is sent in full.
+ */
+void lcd_setDirtyPolicy(uint8_t max_rects, uint32_t coalesce);
+
+/**
+ * @brief Get counters for partial frame writes.
+ * @param stats Pointer to the structure to receive the counters.
+ */
+void lcd_getDirtyStats(lcd_dirty_stats_t *stats);
+
+/**
+ * @brief Reset the counters for partial frame writes.
+ */
+void lcd_resetDirtyStats(void);
+
+/**
+ * @brief Enable tile mode (deferred rendering without a frame buffer).
+ * @details Draw calls are recorded into a command list. lcd_writeFrame()
+ *  rasterizes the frame one full-width band at a time into two small DMA
+ *  buffers, sending one band while the next is drawn. Bands not drawn in
+ *  this frame or the last are skipped when the fill color is unchanged.
+ *  With the defaults this uses about 28 KB instead of the 150 KB of a
+ *  frame buffer.
+ * @param cmd_bytes Size of the command list in bytes, 0 for the default.
+ *  Commands that do not fit are dropped with a warning.
+ * @param band_h    Rows per band, 0 for the default.
+ * @note  Each frame starts from the last lcd_fillScreen() color. Arrays
+ *  passed to lcd_drawHPixels() are referenced, not copied, so they must
+ *  remain valid until lcd_writeFrame(). Not available together with the
+ *  frame buffer.
+ */
+void lcd_tileEnable(size_t cmd_bytes, coord_t band_h);
+
+/**
+ * @brief Disable tile mode and deallocate its buffers.
+ */
+void lcd_tileDisable(void);
+
+/**
+ * @brief Rasterize tile mode frames on both cores.
+ * @details Two worker tasks, pinned to core 0 and core 1, share out the
+ *  changed bands of each frame and draw them into a full frame. The frame
+ *  is sent after both finish, so frames heavy in draw calls take about
+ *  half the time to rasterize. Costs a full frame of DMA memory.
+ * @note  Requires tile mode. Rasterizing waits until the previous frame has
+ *  been sent.
+ */
+void lcd_tileParallelEnable(void);
+
+/**
+ * @brief Stop the worker tasks and go back to rasterizing on the calling
+ *  task.
+ */
+void lcd_tileParallelDisable(void);
+
+/**
+ * @brief Use a tilemap as the background of tile mode.
+ * @details Each band starts from the map instead of the fill color, copied
+ *  tile row by tile row straight into the transfer buffer, so a full screen
+ *  background takes just the indices and the atlas. The map wraps around
+ *  at its edges. Draw calls recorded for the frame are drawn over it.
+ * @param map Tilemap, referenced, not copied. NULL to go back to the fill
+ *  color.
+ * @note  Requires tile mode. lcd_fillScreen() replaces the map with the
+ *  color.
+ */
+void lcd_tileMap(const lcd_tilemap_t *map);
+
+/**
+ * @brief Set the map position shown at the top left corner of the screen.
+ * @details The offset wraps around the map, so scrolling in any direction
+ *  never runs out. Every band is sent again on the next write.
+ * @param x Map X coordinate in pixels.
+ * @param y Map Y coordinate in pixels.
+ */
+void lcd_tileMapScroll(coord_t x, coord_t y);
+
+/**
+ * @brief Mark cells of the map as changed after writing their indices.
+ * @param col  First column.
+ * @param row  First row.
+ * @param cols Number of columns.
+ * @param rows Number of rows.
+ */
+void lcd_tileMapUpdate(uint16_t col, uint16_t row, uint16_t cols, uint16_t rows);
+
+/**
+ * @brief Enable palette mode (8-bit indexed frame buffer).
+ * @details The frame is stored as one palette index per pixel, half the
+ *  size of a frame buffer, and expanded to RGB565 through the palette as
+ *  lcd_writeFrame() sends it. Drawing still takes colors, each is stored
+ *  as the closest palette entry. Only regions modified since the last
+ *  write are sent, as with the frame buffer.
+ * @param colors Palette, copied. NULL for a default palette with 3 bits of
+ *  red and green and 2 of blue.
+ * @param n      Number of colors, up to 256.
+ * @note  Not available together with the frame buffer or tile mode. The
+ *  image starts out black. lcd_getFrameBuffer() returns NULL and scrolling
+ *  is not available. lcd_writeFrameAsync() returns once the last chunk is
+ *  queued.
+ */
+void lcd_paletteEnable(const color_t *colors, uint16_t n);
+
+/**
+ * @brief Disable palette mode and deallocate its buffers.
+ */
+void lcd_paletteDisable(void);
+
+/**
+ * @brief Replace palette entries.
+ * @details Pixels keep their index, so they change to the new colors on
+ *  the next frame write, which sends the whole frame. Changing a few
+ *  entries each frame fades or flashes everything drawn with them.
+ * @param first  First entry to replace.
+ * @param colors New colors.
+ * @param n      Number of entries.
+ */
+void lcd_setPalette(uint8_t first, const color_t *colors, uint16_t n);
+
+/** @} */
+
+/** @name Layers. */
+/** @{ */
+
+/** @brief Maximum number of dynamic layers. */
+#define LCD_LAYERS_MAX 4
+
+/** @brief Layer number of the background. */
+#define LCD_LAYER_BACK 0
+
+/** @brief Default transparent color of dynamic layers. */
+#define LCD_LAYER_KEY rgb565(255, 0, 255) // 0xf81f
+
+/**
+ * @brief Enable layers: a background plus dynamic layers composed on top.
+ * @details Each layer is a buffer in the frame format. The background
+ *  (LCD_LAYER_BACK) is opaque and starts as the current image, so it can be
+ *  drawn before or after this call and is then kept rather than redrawn.
+ *  Dynamic layers 1 to n start clear, their key color is transparent, and
+ *  higher numbers are on top. lcd_writeFrame() composes only the regions
+ *  any layer changed since the last write. A typical loop clears a dynamic
+ *  layer with lcd_layerClear() and redraws the moving objects in it, which
+ *  costs their area rather than the screen's.
+ * @param n Number of dynamic layers, up to LCD_LAYERS_MAX.
+ * @note  Requires the frame buffer (full or half resolution) or palette
+ *  mode, and no scrolling. Each layer takes as much memory as the frame.
+ *  The background is selected for drawing after the call.
+ */
+void lcd_layerEnable(uint8_t n);
+
+/**
+ * @brief Deallocate the layers. The frame keeps the last composed image.
+ */
+void lcd_layerDisable(void);
+
+/**
+ * @brief Select the layer that drawing goes to.
+ * @details lcd_getFrameBuffer() returns the selected layer's pixels, and
+ *  lcd_markDirty() marks regions of it.
+ * @param layer LCD_LAYER_BACK or a dynamic layer number.
+ */
+void lcd_layerSelect(uint8_t layer);
+
+/**
+ * @brief Make a dynamic layer transparent.
+ * @details Only the regions drawn since the last clear are filled with
+ *  the key color. A screen fill with the key color clears the layer too,
+ *  but touches every pixel.
+ * @param layer Dynamic layer number.
+ */
+void lcd_layerClear(uint8_t layer);
+
+/**
+ * @brief Set the transparent color of a dynamic layer and clear it.
+ * @param layer Dynamic layer number.
+ * @param key   Color that is not drawn over lower layers.
+ * @note  In palette mode, colors that map to the same palette entry as the
+ *  key are transparent too. Set the palette before enabling layers.
+ */
+void lcd_layerSetKey(uint8_t layer, color_t key);
+
+/** @} */
+
+/** @name Canvases.
+ * A canvas is an offscreen image of any size that the drawing functions
+ * can target in place of the screen. Static parts of a scene, such as a
+ * game board or a watch face, can be drawn into a canvas once and then
+ * copied to the screen, or into another canvas, every frame. Each canvas
+ * has its own clip rectangle and font settings. The drawing functions
+ * draw on the target selected by the calling task, the screen unless
+ * lcd_canvasSelect() chose a canvas. The lcd_canvas_ functions take the
+ * target as their first argument instead, so tasks can draw on their own
+ * canvases at the same time. */
+/** @{ */
+
+/** @brief Offscreen drawing target. */
+typedef struct lcd_canvas lcd_canvas_t;
+
+/**
+ * @brief Allocate a canvas, cleared to black.
+ * @param w Width in pixels.
+ * @param h Height in pixels.
+ * @returns Canvas, or NULL if out of memory.
+ */
+lcd_canvas_t *lcd_canvasCreate(coord_t w, coord_t h);
+
+/**
+ * @brief Free a canvas. If the calling task selected it, the screen is
+ *  selected again.
+ * @param canvas Canvas, not in use by another task.
+ */
+void lcd_canvasDelete(lcd_canvas_t *canvas);
+
+/**
+ * @brief Select the target of the drawing functions for the calling task.
+ * @details While a canvas is selected, the drawing, clipping and font
+ *  functions apply to it, and lcd_getFrameBuffer() returns its pixels in
+ *  CPU byte order, row by row. Other tasks keep their own target.
+ * @param canvas Canvas, or NULL for the screen.
+ * @note  Display, mode and frame functions log an error and do nothing
+ *  while a canvas is selected.
+ */
+void lcd_canvasSelect(lcd_canvas_t *canvas);
+
+/**
+ * @brief Copy a canvas to the selected target.
+ * @param canvas Canvas, must not be the selected one.
+ * @param x      Top left corner X coordinate.
+ * @param y      Top left corner Y coordinate.
+ * @note  In tile mode the pixels are read when the frame is written, so
+ *  leave the canvas unchanged until then.
+ */
+void lcd_canvasDraw(const lcd_canvas_t *canvas, coord_t x, coord_t y);
+
+/**
+ * @brief Copy part of a canvas to the selected target.
+ * @param canvas Canvas, must not be the selected one.
+ * @param x      Top left corner X coordinate on the target.
+ * @param y      Top left corner Y coordinate on the target.
+ * @param sx     Left column of the part in the canvas.
+ * @param sy     Top row of the part in the canvas.
+ * @param w      Width of the part.
+ * @param h      Height of the part.
+ */
+void lcd_canvasDrawRect(const lcd_canvas_t *canvas, coord_t x, coord_t y,
+	coord_t sx, coord_t sy, coord_t w, coord_t h);
+
+/** @} */
+
+/** @name Drawing on a given canvas.
+ * Each draws on the canvas passed, or on the screen if it is NULL, and
+ * leaves the target selected by the calling task as it was. Draws on
+ * canvases are not counted by lcd_getStats().
+ *
+ * These are thin entry points: each selects the canvas for the calling
+ * task, makes the call of the same name, and restores the previous target.
+ * The drawing code itself still reads the per task target, so:
+ * - A canvas must be drawn on by one task at a time, counting a task that
+ *   selected it with lcd_canvasSelect(). Nothing detects a second task.
+ * - Calls may nest on one task, as each restores the target it found, but
+ *   not from an interrupt handler.
+ *
+ * The display, mode, frame, dirty rectangle and glyph cache functions have
+ * no variant, as they act on the screen only. */
+/** @{ */
+
+/**
+ * @brief Copy a canvas to another canvas, see lcd_canvasDraw().
+ * @param canvas Target canvas, or NULL for the screen.
+ * @param src    Canvas copied, must not be the target.
+ * @param x      Top left corner X coordinate on the target.
+ * @param y      Top left corner Y coordinate on the target.
+ */
+void lcd_canvas_draw(lcd_canvas_t *canvas, const lcd_canvas_t *src, coord_t x, coord_t y);
+
+/**
+ * @brief Copy part of a canvas to another canvas, see lcd_canvasDrawRect().
+ * @param canvas Target canvas, or NULL for the screen.
+ * @param src    Canvas copied, must not be the target.
+ * @param x      Top left corner X coordinate on the target.
+ * @param y      Top left corner Y coordinate on the target.
+ * @param sx     Left column of the part in the source.
+ * @param sy     Top row of the part in the source.
+ * @param w      Width of the part.
+ * @param h      Height of the part.
+ */
+void lcd_canvas_drawPart(lcd_canvas_t *canvas, const lcd_canvas_t *src, coord_t x, coord_t y,
+	coord_t sx, coord_t sy, coord_t w, coord_t h);
+
+/**
+ * @brief Limit drawing on a canvas to a rectangle, see lcd_setClip().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x      X coordinate of the top left corner.
+ * @param y      Y coordinate of the top left corner.
+ * @param w      Width of the rectangle.
+ * @param h      Height of the rectangle.
+ */
+void lcd_canvas_setClip(lcd_canvas_t *canvas, coord_t x, coord_t y, coord_t w, coord_t h);
+
+/**
+ * @brief Allow drawing on the whole canvas again, see lcd_resetClip().
+ * @param canvas Canvas, or NULL for the screen.
+ */
+void lcd_canvas_resetClip(lcd_canvas_t *canvas);
+
+/**
+ * @brief Set the font direction of a canvas, see lcd_setFontDirection().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param dir    Font direction.
+ */
+void lcd_canvas_setFontDirection(lcd_canvas_t *canvas, direction_t dir);
+
+/**
+ * @brief Set the font size of a canvas, see lcd_setFontSize().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param size   Font size scale factor (1 or greater).
+ */
+void lcd_canvas_setFontSize(lcd_canvas_t *canvas, uint8_t size);
+
+/**
+ * @brief Set the font background color of a canvas, see
+ *  lcd_setFontBackground().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param color  Color value.
+ */
+void lcd_canvas_setFontBackground(lcd_canvas_t *canvas, color_t color);
+
+/**
+ * @brief Draw characters on a canvas without a background, see
+ *  lcd_noFontBackground().
+ * @param canvas Canvas, or NULL for the screen.
+ */
+void lcd_canvas_noFontBackground(lcd_canvas_t *canvas);
+
+/**
+ * @brief Fill a canvas, or its clip rectangle if one is set, see
+ *  lcd_fillScreen().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param color  Color value.
+ */
+void lcd_canvas_fillScreen(lcd_canvas_t *canvas, color_t color);
+
+/**
+ * @brief Draw a pixel on a canvas, see lcd_drawPixel().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x      X coordinate.
+ * @param y      Y coordinate.
+ * @param color  Color value.
+ */
+void lcd_canvas_drawPixel(lcd_canvas_t *canvas, coord_t x, coord_t y, color_t color);
+
+/**
+ * @brief Draw multiple pixels in a horizontal line on a canvas, see
+ *  lcd_drawHPixels().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x      X coordinate.
+ * @param y      Y coordinate.
+ * @param w      Width (extent) of line.
+ * @param colors Array of color values, one for each pixel, length = w.
+ */
+void lcd_canvas_drawHPixels(lcd_canvas_t *canvas, coord_t x, coord_t y, coord_t w, const color_t *colors);
+
+/**
+ * @brief Draw a horizontal line on a canvas, see lcd_drawHLine().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x      X coordinate.
+ * @param y      Y coordinate.
+ * @param w      Width (extent) of line.
+ * @param color  Color value.
+ */
+void lcd_canvas_drawHLine(lcd_canvas_t *canvas, coord_t x, coord_t y, coord_t w, color_t color);
+
+/**
+ * @brief Draw a vertical line on a canvas, see lcd_drawVLine().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x      X coordinate.
+ * @param y      Y coordinate.
+ * @param h      Height (extent) of line.
+ * @param color  Color value.
+ */
+void lcd_canvas_drawVLine(lcd_canvas_t *canvas, coord_t x, coord_t y, coord_t h, color_t color);
+
+/**
+ * @brief Draw a line on a canvas, see lcd_drawLine().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x0     X coordinate for Point 0.
+ * @param y0     Y coordinate for Point 0.
+ * @param x1     X coordinate for Point 1.
+ * @param y1     Y coordinate for Point 1.
+ * @param color  Color value.
+ */
+void lcd_canvas_drawLine(lcd_canvas_t *canvas, coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color);
+
+/**
+ * @brief Draw a rectangle outline on a canvas, see lcd_drawRect().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x      Top left corner X coordinate.
+ * @param y      Top left corner Y coordinate.
+ * @param w      Width in pixels.
+ * @param h      Height in pixels.
+ * @param color  Color value.
+ */
+void lcd_canvas_drawRect(lcd_canvas_t *canvas, coord_t x, coord_t y, coord_t w, coord_t h, color_t color);
+
+/**
+ * @brief Draw a filled rectangle on a canvas, see lcd_fillRect().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x      Top left corner X coordinate.
+ * @param y      Top left corner Y coordinate.
+ * @param w      Width in pixels.
+ * @param h      Height in pixels.
+ * @param color  Color value.
+ */
+void lcd_canvas_fillRect(lcd_canvas_t *canvas, coord_t x, coord_t y, coord_t w, coord_t h, color_t color);
+
+/**
+ * @brief Draw a triangle outline on a canvas, see lcd_drawTriangle().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x0     X coordinate for Vertex 0.
+ * @param y0     Y coordinate for Vertex 0.
+ * @param x1     X coordinate for Vertex 1.
+ * @param y1     Y coordinate for Vertex 1.
+ * @param x2     X coordinate for Vertex 2.
+ * @param y2     Y coordinate for Vertex 2.
+ * @param color  Color value.
+ */
+void lcd_canvas_drawTriangle(lcd_canvas_t *canvas, coord_t x0, coord_t y0, coord_t x1,
+	coord_t y1, coord_t x2, coord_t y2, color_t color);
+
+/**
+ * @brief Draw a filled triangle on a canvas, see lcd_fillTriangle().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x0     X coordinate for Vertex 0.
+ * @param y0     Y coordinate for Vertex 0.
+ * @param x1     X coordinate for Vertex 1.
+ * @param y1     Y coordinate for Vertex 1.
+ * @param x2     X coordinate for Vertex 2.
+ * @param y2     Y coordinate for Vertex 2.
+ * @param color  Color value.
+ */
+void lcd_canvas_fillTriangle(lcd_canvas_t *canvas, coord_t x0, coord_t y0, coord_t x1,
+	coord_t y1, coord_t x2, coord_t y2, color_t color);
+
+/**
+ * @brief Draw a circle outline on a canvas, see lcd_drawCircle().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param xc     Center-point X coordinate.
+ * @param yc     Center-point Y coordinate.
+ * @param r      Radius of circle.
+ * @param color  Color value.
+ */
+void lcd_canvas_drawCircle(lcd_canvas_t *canvas, coord_t xc, coord_t yc, coord_t r, color_t color);
+
+/**
+ * @brief Draw a filled circle on a canvas, see lcd_fillCircle().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param xc     Center-point X coordinate.
+ * @param yc     Center-point Y coordinate.
+ * @param r      Radius of circle.
+ * @param color  Color value.
+ */
+void lcd_canvas_fillCircle(lcd_canvas_t *canvas, coord_t xc, coord_t yc, coord_t r, color_t color);
+
+/**
+ * @brief Draw a rounded rectangle outline on a canvas, see
+ *  lcd_drawRoundRect().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x      Top left corner X coordinate.
+ * @param y      Top left corner Y coordinate.
+ * @param w      Width in pixels.
+ * @param h      Height in pixels.
+ * @param r      Radius of corner rounding.
+ * @param color  Color value.
+ */
+void lcd_canvas_drawRoundRect(lcd_canvas_t *canvas, coord_t x, coord_t y,
+	coord_t w, coord_t h, coord_t r, color_t color);
+
+/**
+ * @brief Draw a filled, rounded rectangle on a canvas, see
+ *  lcd_fillRoundRect().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x      Top left corner X coordinate.
+ * @param y      Top left corner Y coordinate.
+ * @param w      Width in pixels.
+ * @param h      Height in pixels.
+ * @param r      Radius of corner rounding.
+ * @param color  Color value.
+ */
+void lcd_canvas_fillRoundRect(lcd_canvas_t *canvas, coord_t x, coord_t y,
+	coord_t w, coord_t h, coord_t r, color_t color);
+
+/**
+ * @brief Draw an arrow outline on a canvas, see lcd_drawArrow().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x0     Begin X coordinate.
+ * @param y0     Begin Y coordinate.
+ * @param x1     End (arrow point) X coordinate.
+ * @param y1     End (arrow point) Y coordinate.
+ * @param w      Half width of the arrow head in pixels. Height is 3*w.
+ * @param color  Color value.
+ */
+void lcd_canvas_drawArrow(lcd_canvas_t *canvas, coord_t x0, coord_t y0,
+	coord_t x1, coord_t y1, coord_t w, color_t color);
+
+/**
+ * @brief Draw a filled arrow on a canvas, see lcd_fillArrow().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x0     Begin X coordinate.
+ * @param y0     Begin Y coordinate.
+ * @param x1     End (arrow point) X coordinate.
+ * @param y1     End (arrow point) Y coordinate.
+ * @param w      Half width of the arrow head in pixels. Height is 3*w.
+ * @param color  Color value.
+ */
+void lcd_canvas_fillArrow(lcd_canvas_t *canvas, coord_t x0, coord_t y0,
+	coord_t x1, coord_t y1, coord_t w, color_t color);
+
+/**
+ * @brief Draw a 1-bit image on a canvas, see lcd_drawBitmap().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x      Top left corner X coordinate.
+ * @param y      Top left corner Y coordinate.
+ * @param bitmap Byte array with monochrome bitmap, one bit for each pixel.
+ * @param w      Width of bitmap in pixels.
+ * @param h      Height of bitmap in pixels.
+ * @param color  Color value.
+ */
+void lcd_canvas_drawBitmap(lcd_canvas_t *canvas, coord_t x, coord_t y,
+	const uint8_t *bitmap, coord_t w, coord_t h, color_t color);
+
+/**
+ * @brief Draw a run-length encoded monochrome bitmap on a canvas, see
+ *  lcd_drawBitmapRLE().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x      Top left corner X coordinate.
+ * @param y      Top left corner Y coordinate.
+ * @param rle    Encoded bitmap.
+ * @param color  Color value.
+ */
+void lcd_canvas_drawBitmapRLE(lcd_canvas_t *canvas, coord_t x, coord_t y, const lcd_rle_t *rle, color_t color);
+
+/**
+ * @brief Draw a run-length encoded monochrome bitmap with a background on a
+ *  canvas, see lcd_drawBitmapRLEOpaque().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x      Top left corner X coordinate.
+ * @param y      Top left corner Y coordinate.
+ * @param rle    Encoded bitmap.
+ * @param color  Color value for set pixels.
+ * @param bg     Color value for unset pixels.
+ */
+void lcd_canvas_drawBitmapRLEOpaque(lcd_canvas_t *canvas, coord_t x, coord_t y,
+	const lcd_rle_t *rle, color_t color, color_t bg);
+
+/**
+ * @brief Draw a run-length encoded color image on a canvas, see
+ *  lcd_drawRGBBitmapRLE().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x      Top left corner X coordinate.
+ * @param y      Top left corner Y coordinate.
+ * @param rle    Encoded image.
+ */
+void lcd_canvas_drawRGBBitmapRLE(lcd_canvas_t *canvas, coord_t x, coord_t y, const lcd_rle_rgb_t *rle);
+
+/**
+ * @brief Draw an image on a canvas, see lcd_drawRGBBitmap().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x      Top left corner X coordinate.
+ * @param y      Top left corner Y coordinate.
+ * @param bitmap Array of color values, one for each pixel, length = w * h.
+ * @param w      Width of bitmap in pixels.
+ * @param h      Height of bitmap in pixels.
+ */
+void lcd_canvas_drawRGBBitmap(lcd_canvas_t *canvas, coord_t x, coord_t y,
+	const color_t *bitmap, coord_t w, coord_t h);
+
+/**
+ * @brief Draw part of an image on a canvas, see lcd_drawRGBBitmapRect().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x      Top left corner X coordinate on the canvas.
+ * @param y      Top left corner Y coordinate on the canvas.
+ * @param bitmap Array of color values for the whole source image.
+ * @param stride Width of the source image in pixels (row stride).
+ * @param sx     Left column of the source rectangle.
+ * @param sy     Top row of the source rectangle.
+ * @param w      Width of the source rectangle in pixels.
+ * @param h      Height of the source rectangle in pixels.
+ */
+void lcd_canvas_drawRGBBitmapRect(lcd_canvas_t *canvas, coord_t x, coord_t y, const color_t *bitmap,
+	coord_t stride, coord_t sx, coord_t sy, coord_t w, coord_t h);
+
+/**
+ * @brief Draw a rectangle based on two diagonal corners on a canvas, see
+ *  lcd_drawRect2().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x0     X coordinate for diagonal Corner 0.
+ * @param y0     Y coordinate for diagonal Corner 0.
+ * @param x1     X coordinate for diagonal Corner 1.
+ * @param y1     Y coordinate for diagonal Corner 1.
+ * @param color  Color value.
+ */
+void lcd_canvas_drawRect2(lcd_canvas_t *canvas, coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color);
+
+/**
+ * @brief Draw a filled rectangle based on two diagonal corners on a canvas,
+ *  see lcd_fillRect2().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x0     X coordinate for diagonal Corner 0.
+ * @param y0     Y coordinate for diagonal Corner 0.
+ * @param x1     X coordinate for diagonal Corner 1.
+ * @param y1     Y coordinate for diagonal Corner 1.
+ * @param color  Color value.
+ */
+void lcd_canvas_fillRect2(lcd_canvas_t *canvas, coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color);
+
+/**
+ * @brief Draw a rounded rectangle based on two diagonal corners on a canvas,
+ *  see lcd_drawRoundRect2().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x0     X coordinate for diagonal Corner 0.
+ * @param y0     Y coordinate for diagonal Corner 0.
+ * @param x1     X coordinate for diagonal Corner 1.
+ * @param y1     Y coordinate for diagonal Corner 1.
+ * @param r      Radius of rounded corners.
+ * @param color  Color value.
+ */
+void lcd_canvas_drawRoundRect2(lcd_canvas_t *canvas, coord_t x0, coord_t y0,
+	coord_t x1, coord_t y1, coord_t r, color_t color);
+
+/**
+ * @brief Draw a filled, rounded rectangle based on two diagonal corners on a
+ *  canvas, see lcd_fillRoundRect2().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x0     X coordinate for diagonal Corner 0.
+ * @param y0     Y coordinate for diagonal Corner 0.
+ * @param x1     X coordinate for diagonal Corner 1.
+ * @param y1     Y coordinate for diagonal Corner 1.
+ * @param r      Radius of rounded corners.
+ * @param color  Color value.
+ */
+void lcd_canvas_fillRoundRect2(lcd_canvas_t *canvas, coord_t x0, coord_t y0,
+	coord_t x1, coord_t y1, coord_t r, color_t color);
+
+/**
+ * @brief Draw a rectangle outline based on a center point on a canvas, see
+ *  lcd_drawRectC().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param xc     Center X coordinate.
+ * @param yc     Center Y coordinate.
+ * @param w      Width of rectangle.
+ * @param h      Height of rectangle.
+ * @param angle  Angle of rotation (degrees).
+ * @param color  Color value.
+ */
+void lcd_canvas_drawRectC(lcd_canvas_t *canvas, coord_t xc, coord_t yc,
+	coord_t w, coord_t h, angle_t angle, color_t color);
+
+/**
+ * @brief Draw a triangle outline based on a center point on a canvas, see
+ *  lcd_drawTriangleC().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param xc     Center X coordinate.
+ * @param yc     Center Y coordinate.
+ * @param w      Width of triangle.
+ * @param h      Height of triangle.
+ * @param angle  Angle of rotation (degrees).
+ * @param color  Color value.
+ */
+void lcd_canvas_drawTriangleC(lcd_canvas_t *canvas, coord_t xc, coord_t yc,
+	coord_t w, coord_t h, angle_t angle, color_t color);
+
+/**
+ * @brief Draw a regular polygon outline based on a center point on a canvas,
+ *  see lcd_drawRegularPolygonC().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param xc     Center X coordinate.
+ * @param yc     Center Y coordinate.
+ * @param n      Number of sides.
+ * @param r      Radius of polygon.
+ * @param angle  Angle of rotation (degrees).
+ * @param color  Color value.
+ */
+void lcd_canvas_drawRegularPolygonC(lcd_canvas_t *canvas, coord_t xc, coord_t yc,
+	coord_t n, coord_t r, angle_t angle, color_t color);
+
+/**
+ * @brief Draw a single character on a canvas, see lcd_drawChar().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x      Top left corner X coordinate.
+ * @param y      Top left corner Y coordinate.
+ * @param ascii  ASCII encoded character.
+ * @param color  Color value.
+ * @returns The coordinate (in X or Y) of a potential following character.
+ */
+coord_t lcd_canvas_drawChar(lcd_canvas_t *canvas, coord_t x, coord_t y, char ascii, color_t color);
+
+/**
+ * @brief Draw a string on a canvas, see lcd_drawString().
+ * @param canvas Canvas, or NULL for the screen.
+ * @param x      Top left corner X coordinate.
+ * @param y      Top left corner Y coordinate.
+ * @param ascii  ASCII encoded string, zero terminated.
+ * @param color  Color value.
+ * @returns The coordinate (in X or Y) of a potential following character.
+ */
+coord_t lcd_canvas_drawString(lcd_canvas_t *canvas, coord_t x, coord_t y, const char *ascii, color_t color);
+
 /** @} */
 
 #endif // LCD_H_
@@ -0,0 +1,171 @@
+// Pixel run kernels. Short runs are written one pixel at a time, longer
+// runs a vector or a word at a time after the destination is aligned.
+
+#include <stdint.h>
+#include <string.h> // memcpy, memmove
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "lcd_pix.h"
+
+#define SWAP16(c) ((color_t)(((c) << 8) | ((c) >> 8)))
+
+#define SHORT_RUN 8 // runs up to this length are not worth aligning
+
+typedef uint32_t __attribute__((may_alias)) pair_t; // two pixels
+typedef uint64_t __attribute__((may_alias)) quad4_t; // four pixels
+
+// Swap the bytes of both pixels in a word.
+#define SWAP_PAIR(w) ((((w) & 0x00FF00FFUL) << 8) | (((w) >> 8) & 0x00FF00FFUL))
+
+void lcd_pix_fill(color_t *dst, color_t color, size_t n)
+{
+	if (n <= SHORT_RUN) {
+		while (n--) *dst++ = color;
+		return;
+	}
+#if defined(__AVX2__)
+	__m256i v = _mm256_set1_epi16((short)color);
+	for (; n >= 16; n -= 16, dst += 16) _mm256_storeu_si256((__m256i *)dst, v);
+#elif defined(__SSE2__)
+	__m128i v = _mm_set1_epi16((short)color);
+	for (; n >= 8; n -= 8, dst += 8) _mm_storeu_si128((__m128i *)dst, v);
+#endif
+	if (n && ((uintptr_t)dst & 2)) {*dst++ = color; n--;}
+	pair_t c2 = (pair_t)color << 16 | color;
+	if (n >= 2 && ((uintptr_t)dst & 4)) {*(pair_t *)dst = c2; dst += 2; n -= 2;}
+	quad4_t c4 = (quad4_t)c2 << 32 | c2;
+	quad4_t *d4 = (quad4_t *)dst;
+	for (size_t i = n >> 3; i; i--) {d4[0] = c4; d4[1] = c4; d4 += 2;}
+	if (n & 4) *d4++ = c4;
+	pair_t *d2 = (pair_t *)d4;
+	if (n & 2) *d2++ = c2;
+	if (n & 1) *(color_t *)d2 = color;
+}
+
+void lcd_pix_copy(color_t *dst, const color_t *src, size_t n)
+{
+	memcpy(dst, src, n*sizeof(color_t));
+}
+
+void lcd_pix_move(color_t *dst, const color_t *src, size_t n)
+{
+	memmove(dst, src, n*sizeof(color_t));
+}
+
+void lcd_pix_copySwap(color_t *dst, const color_t *src, size_t n)
+{
+#if defined(__AVX2__)
+	for (; n >= 16; n -= 16, dst += 16, src += 16) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)src);
+		v = _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+		_mm256_storeu_si256((__m256i *)dst, v);
+	}
+#elif defined(__SSE2__)
+	for (; n >= 8; n -= 8, dst += 8, src += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)src);
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		_mm_storeu_si128((__m128i *)dst, v);
+	}
+#endif
+	// Two pixels per word when both runs can be word aligned together.
+	if (n > SHORT_RUN && !(((uintptr_t)dst ^ (uintptr_t)src) & 2)) {
+		if ((uintptr_t)dst & 2) {*dst++ = SWAP16(*src); src++; n--;}
+		pair_t *d2 = (pair_t *)dst;
+		const pair_t *s2 = (const pair_t *)src;
+		for (size_t i = n >> 1; i; i--) {pair_t w = *s2++; *d2++ = SWAP_PAIR(w);}
+		dst = (color_t *)d2;
+		src = (const color_t *)s2;
+		n &= 1;
+	}
+	while (n--) {*dst++ = SWAP16(*src); src++;}
+}
+
+void lcd_pix_lookup(color_t *dst, const uint8_t *src, const color_t *lut, size_t n)
+{
+	for (; n >= 4; n -= 4, dst += 4, src += 4) {
+		dst[0] = lut[src[0]];
+		dst[1] = lut[src[1]];
+		dst[2] = lut[src[2]];
+		dst[3] = lut[src[3]];
+	}
+	while (n--) *dst++ = lut[*src++];
+}
+
+void lcd_pix_double(color_t *dst, const color_t *src, size_t n)
+{
+#if defined(__SSE2__)
+	for (; n >= 8; n -= 8, dst += 16, src += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)src);
+		_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(v, v));
+		_mm_storeu_si128((__m128i *)(dst+8), _mm_unpackhi_epi16(v, v));
+	}
+#endif
+	if ((uintptr_t)dst & 2) {
+		while (n--) {dst[0] = dst[1] = *src++; dst += 2;}
+		return;
+	}
+	pair_t *d2 = (pair_t *)dst;
+	for (; n >= 4; n -= 4, src += 4, d2 += 4) {
+		d2[0] = (pair_t)src[0] << 16 | src[0];
+		d2[1] = (pair_t)src[1] << 16 | src[1];
+		d2[2] = (pair_t)src[2] << 16 | src[2];
+		d2[3] = (pair_t)src[3] << 16 | src[3];
+	}
+	while (n--) {*d2++ = (pair_t)*src << 16 | *src; src++;}
+}
+
+void lcd_pix_doubleSwap(color_t *dst, const color_t *src, size_t n)
+{
+#if defined(__SSE2__)
+	for (; n >= 8; n -= 8, dst += 16, src += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)src);
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(v, v));
+		_mm_storeu_si128((__m128i *)(dst+8), _mm_unpackhi_epi16(v, v));
+	}
+#endif
+	if ((uintptr_t)dst & 2) {
+		while (n--) {dst[0] = dst[1] = SWAP16(*src); src++; dst += 2;}
+		return;
+	}
+	pair_t *d2 = (pair_t *)dst;
+	for (; n; n--, src++) {
+		pair_t c = SWAP16(*src);
+		*d2++ = c << 16 | c;
+	}
+}
+
+void lcd_pix_copyKey(color_t *dst, const color_t *src, color_t key, size_t n)
+{
+#if defined(__SSE2__)
+	__m128i k = _mm_set1_epi16((short)key);
+	for (; n >= 8; n -= 8, dst += 8, src += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)src);
+		__m128i m = _mm_cmpeq_epi16(v, k); // set where transparent
+		__m128i d = _mm_loadu_si128((const __m128i *)dst);
+		_mm_storeu_si128((__m128i *)dst, _mm_or_si128(_mm_and_si128(m, d), _mm_andnot_si128(m, v)));
+	}
+#endif
+	for (; n; n--, dst++, src++) {
+		if (*src != key) *dst = *src;
+	}
+}
+
+void lcd_pix_copyKey8(uint8_t *dst, const uint8_t *src, uint8_t key, size_t n)
+{
+#if defined(__SSE2__)
+	__m128i k = _mm_set1_epi8((char)key);
+	for (; n >= 16; n -= 16, dst += 16, src += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)src);
+		__m128i m = _mm_cmpeq_epi8(v, k); // set where transparent
+		__m128i d = _mm_loadu_si128((const __m128i *)dst);
+		_mm_storeu_si128((__m128i *)dst, _mm_or_si128(_mm_and_si128(m, d), _mm_andnot_si128(m, v)));
+	}
+#endif
+	for (; n; n--, dst++, src++) {
+		if (*src != key) *dst = *src;
+	}
+}
@@ -0,0 +1,97 @@
+#ifndef LCD_PIX_H_
+#define LCD_PIX_H_
+/**
+ * @file
+ * @brief Pixel run kernels for frame buffer fills and copies.
+ * @details Runs are written a word or more at a time once the destination
+ * is aligned. On a host with SSE2 or AVX2 the vector units are used, so
+ * results on the simulator can be compared with the generic word loops
+ * used on the target. This module has no hardware dependencies.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "lcd.h"
+
+/**
+ * @brief Fill a run of pixels with one color.
+ * @param dst   First pixel, 16-bit aligned.
+ * @param color Color value, stored as is.
+ * @param n     Number of pixels.
+ */
+void lcd_pix_fill(color_t *dst, color_t color, size_t n);
+
+/**
+ * @brief Copy a run of pixels. The runs must not overlap.
+ * @param dst First destination pixel.
+ * @param src First source pixel.
+ * @param n   Number of pixels.
+ */
+void lcd_pix_copy(color_t *dst, const color_t *src, size_t n);
+
+/**
+ * @brief Copy a run of pixels that may overlap the source.
+ * @param dst First destination pixel.
+ * @param src First source pixel.
+ * @param n   Number of pixels.
+ */
+void lcd_pix_move(color_t *dst, const color_t *src, size_t n);
+
+/**
+ * @brief Copy a run of pixels, swapping the bytes of each one. Converts
+ *  between host and display (big-endian) byte order.
+ * @param dst First destination pixel. May equal src to swap in place,
+ *  otherwise the runs must not overlap.
+ * @param src First source pixel.
+ * @param n   Number of pixels.
+ */
+void lcd_pix_copySwap(color_t *dst, const color_t *src, size_t n);
+
+/**
+ * @brief Expand a run of 8-bit indices through a color table.
+ * @param dst First destination pixel.
+ * @param src First index.
+ * @param lut Color table with an entry for every index used.
+ * @param n   Number of pixels.
+ */
+void lcd_pix_lookup(color_t *dst, const uint8_t *src, const color_t *lut, size_t n);
+
+/**
+ * @brief Copy a run of pixels, writing each one twice.
+ * @param dst First destination pixel, room for 2*n pixels. The runs must
+ *  not overlap.
+ * @param src First source pixel.
+ * @param n   Number of source pixels.
+ */
+void lcd_pix_double(color_t *dst, const color_t *src, size_t n);
+
+/**
+ * @brief Copy a run of pixels, swapping the bytes of each one and writing
+ *  it twice.
+ * @param dst First destination pixel, room for 2*n pixels. The runs must
+ *  not overlap.
+ * @param src First source pixel.
+ * @param n   Number of source pixels.
+ */
+void lcd_pix_doubleSwap(color_t *dst, const color_t *src, size_t n);
+
+/**
+ * @brief Copy the pixels of a run that are not the key color, leaving the
+ *  destination as is where the source is transparent.
+ * @param dst First destination pixel. The runs must not overlap.
+ * @param src First source pixel.
+ * @param key Transparent color, as stored.
+ * @param n   Number of pixels.
+ */
+void lcd_pix_copyKey(color_t *dst, const color_t *src, color_t key, size_t n);
+
+/**
+ * @brief Copy the 8-bit indices of a run that are not the key index.
+ * @param dst First destination index. The runs must not overlap.
+ * @param src First source index.
+ * @param key Transparent index.
+ * @param n   Number of indices.
+ */
+void lcd_pix_copyKey8(uint8_t *dst, const uint8_t *src, uint8_t key, size_t n);
+
+#endif // LCD_PIX_H_
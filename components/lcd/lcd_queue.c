@@ -0,0 +1,336 @@
+// Draw command queue: a bounded ring that many tasks post to and one
+// render task takes from. Each slot carries a sequence number that tells
+// posters when it is free and the render task when it is filled, so the
+// only shared write is the compare and swap that claims a slot.
+
+#include <stdatomic.h>
+#include <string.h> // strncpy
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "lcd_queue.h"
+
+#define TASK_STACK 4096
+
+// Commands, a[] holds the arguments in the order of the LCD function.
+enum {
+	OP_CALL,
+	OP_SYNC,
+	OP_FILL_SCREEN,
+	OP_PIXEL,
+	OP_HLINE,
+	OP_VLINE,
+	OP_LINE,
+	OP_RECT,
+	OP_FILL_RECT,
+	OP_CIRCLE,
+	OP_FILL_CIRCLE,
+	OP_STRING,
+	OP_WRITE_FRAME,
+};
+
+typedef struct {
+	uint8_t op;
+	color_t color;
+	coord_t a[4];
+	lcd_queue_fn_t fn;
+	void *arg; // call argument
+	char text[LCD_QUEUE_TEXT];
+} cmd_t;
+
+typedef struct {
+	_Atomic uint32_t seq; // pos when free, pos+1 when filled
+	cmd_t cmd;
+} slot_t;
+
+static const char *TAG = "lcd_queue";
+
+static _Atomic(slot_t *) ring; // set once the render task runs
+static uint32_t mask; // slots-1
+static _Atomic uint32_t tail; // next slot to claim
+static uint32_t head; // next slot to run, render task only
+static SemaphoreHandle_t wake; // given after each post
+static SemaphoreHandle_t stopped; // given by the render task as it exits
+static SemaphoreHandle_t synced; // given by the render task at a sync, kept
+static _Atomic(SemaphoreHandle_t) lock; // one direct draw or sync at a time
+static atomic_bool closed; // set by lcd_queue_stop(), posts are refused
+static atomic_bool quit; // every accepted post is filled, render task exits
+static _Atomic uint32_t posting; // tasks between the ring load and the post
+
+typedef enum {
+	POST_DONE, // queued
+	POST_FULL, // queue full or stopping, dropped
+	POST_DIRECT, // no render task, caller draws
+} post_t;
+
+//----------------------------------------------------------------------------//
+// Helpers
+//----------------------------------------------------------------------------//
+
+// Run one command on the calling task.
+static void run(const cmd_t *c)
+{
+	const coord_t *a = c->a;
+
+	switch (c->op) {
+		case OP_CALL: c->fn(c->arg); break;
+		case OP_SYNC: xSemaphoreGive(synced); break;
+		case OP_FILL_SCREEN: lcd_fillScreen(c->color); break;
+		case OP_PIXEL: lcd_drawPixel(a[0], a[1], c->color); break;
+		case OP_HLINE: lcd_drawHLine(a[0], a[1], a[2], c->color); break;
+		case OP_VLINE: lcd_drawVLine(a[0], a[1], a[2], c->color); break;
+		case OP_LINE: lcd_drawLine(a[0], a[1], a[2], a[3], c->color); break;
+		case OP_RECT: lcd_drawRect(a[0], a[1], a[2], a[3], c->color); break;
+		case OP_FILL_RECT: lcd_fillRect(a[0], a[1], a[2], a[3], c->color); break;
+		case OP_CIRCLE: lcd_drawCircle(a[0], a[1], a[2], c->color); break;
+		case OP_FILL_CIRCLE: lcd_fillCircle(a[0], a[1], a[2], c->color); break;
+		case OP_STRING: lcd_drawString(a[0], a[1], c->text, c->color); break;
+		case OP_WRITE_FRAME: lcd_writeFrame(); break;
+		default: break;
+	}
+}
+
+// Get the lock, created by whichever task needs it first.
+static SemaphoreHandle_t get_lock(void)
+{
+	SemaphoreHandle_t m = atomic_load(&lock);
+	if (m != NULL) return m;
+	SemaphoreHandle_t n = xSemaphoreCreateMutex();
+	if (n == NULL) {
+		ESP_LOGE(TAG, "lock alloc fail");
+		return NULL;
+	}
+	if (atomic_compare_exchange_strong(&lock, &m, n)) return n;
+	vSemaphoreDelete(n); // another task created it first
+	return m;
+}
+
+// Claim a slot in ring r and fill it. Returns false if the queue was full.
+static bool push(slot_t *r, const cmd_t *c)
+{
+	uint32_t pos = atomic_load_explicit(&tail, memory_order_relaxed);
+	slot_t *s;
+	for (;;) {
+		s = &r[pos & mask];
+		uint32_t seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+		int32_t diff = (int32_t)(seq - pos);
+		if (diff == 0) {
+			// Slot is free, claim it unless another task got there first.
+			if (atomic_compare_exchange_weak_explicit(&tail, &pos, pos+1,
+				memory_order_relaxed, memory_order_relaxed)) break;
+		} else if (diff < 0) {
+			return false; // still holds a command from one lap ago
+		} else {
+			pos = atomic_load_explicit(&tail, memory_order_relaxed);
+		}
+	}
+	s->cmd = *c;
+	atomic_store_explicit(&s->seq, pos+1, memory_order_release);
+	xSemaphoreGive(wake);
+	return true;
+}
+
+// Queue a command for the render task, if there is one.
+static post_t enqueue(const cmd_t *c)
+{
+	post_t ret = POST_DIRECT;
+
+	// lcd_queue_stop() sets closed, then waits for posting to drop to zero
+	// before it ends the render task, so a task counted here either sees
+	// closed or fills its slot before then. Both sides are seq_cst.
+	atomic_fetch_add(&posting, 1);
+	slot_t *r = atomic_load_explicit(&ring, memory_order_acquire);
+	if (r != NULL) ret = (!atomic_load(&closed) && push(r, c)) ? POST_DONE : POST_FULL;
+	atomic_fetch_sub(&posting, 1);
+	return ret;
+}
+
+// Queue a command, or run it at once when there is no render task.
+// Returns false if the queue was full or stopping.
+static bool post(const cmd_t *c)
+{
+	post_t ret = enqueue(c);
+	if (ret != POST_DIRECT) return ret == POST_DONE;
+	SemaphoreHandle_t m = get_lock();
+	if (m == NULL) return false;
+	xSemaphoreTake(m, portMAX_DELAY);
+	// lcd_queue_start() publishes the ring holding the lock, so look again
+	// to never draw here while the render task runs.
+	ret = enqueue(c);
+	if (ret == POST_DIRECT) run(c);
+	xSemaphoreGive(m);
+	return ret != POST_FULL;
+}
+
+// Take the next command in order from ring r. Returns false if it is not
+// posted yet.
+static bool take(slot_t *r, cmd_t *c)
+{
+	slot_t *s = &r[head & mask];
+	if (atomic_load_explicit(&s->seq, memory_order_acquire) != head+1) return false;
+	*c = s->cmd;
+	atomic_store_explicit(&s->seq, head+mask+1, memory_order_release);
+	head++;
+	return true;
+}
+
+// Free a ring and the per run semaphores, whichever were allocated.
+static void release(slot_t *r)
+{
+	if (r != NULL) heap_caps_free(r);
+	if (wake != NULL) vSemaphoreDelete(wake);
+	if (stopped != NULL) vSemaphoreDelete(stopped);
+	wake = stopped = NULL;
+}
+
+// Run commands from ring arg until lcd_queue_stop().
+static void render_task(void *arg)
+{
+	slot_t *r = arg;
+	cmd_t c;
+
+	for (;;) {
+		xSemaphoreTake(wake, portMAX_DELAY);
+		// Read before draining: once quit is set, every slot is filled.
+		bool last = atomic_load(&quit);
+		while (take(r, &c)) run(&c);
+		if (last) break;
+	}
+	xSemaphoreGive(stopped);
+	vTaskDelete(NULL);
+}
+
+//----------------------------------------------------------------------------//
+// Public functions
+//----------------------------------------------------------------------------//
+
+bool lcd_queue_start(uint32_t slots, uint32_t prio, int32_t core)
+{
+	uint32_t n = 2;
+
+	if (atomic_load_explicit(&ring, memory_order_acquire) != NULL) return true;
+	while (n < slots) n <<= 1;
+	slot_t *r = heap_caps_malloc(n*sizeof(slot_t), MALLOC_CAP_8BIT);
+	wake = xSemaphoreCreateBinary();
+	stopped = xSemaphoreCreateBinary();
+	if (synced == NULL) synced = xSemaphoreCreateBinary();
+	SemaphoreHandle_t m = get_lock();
+	if (r == NULL || wake == NULL || stopped == NULL || synced == NULL || m == NULL) {
+		ESP_LOGE(TAG, "queue alloc fail");
+		release(r);
+		return false;
+	}
+	for (uint32_t i = 0; i < n; i++) atomic_init(&r[i].seq, i);
+	atomic_store(&tail, 0);
+	atomic_store(&closed, false);
+	atomic_store(&quit, false);
+	head = 0;
+	mask = n-1;
+	// Nothing is posted to r until it is published below, so a failed
+	// start drops no commands.
+	if (xTaskCreatePinnedToCore(render_task, "lcd_render", TASK_STACK, r, prio, NULL, core) != pdPASS) {
+		ESP_LOGE(TAG, "render task start fail");
+		release(r);
+		return false;
+	}
+	// Wait for the direct draw in progress, if any, then queue from here on.
+	xSemaphoreTake(m, portMAX_DELAY);
+	atomic_store_explicit(&ring, r, memory_order_release);
+	xSemaphoreGive(m);
+	return true;
+}
+
+void lcd_queue_stop(void)
+{
+	slot_t *r = atomic_load_explicit(&ring, memory_order_acquire);
+
+	if (r == NULL) return;
+	// Refuse new posts, and let the ones that got in fill their slots.
+	atomic_store(&closed, true);
+	while (atomic_load(&posting) != 0) taskYIELD();
+	atomic_store(&quit, true);
+	xSemaphoreGive(wake);
+	xSemaphoreTake(stopped, portMAX_DELAY);
+	atomic_store_explicit(&ring, NULL, memory_order_release);
+	release(r);
+}
+
+bool lcd_queue_sync(void)
+{
+	SemaphoreHandle_t m = atomic_load(&lock);
+
+	if (atomic_load_explicit(&ring, memory_order_acquire) == NULL || m == NULL) return true;
+	// One sync in flight, so the give is for this task. The render task
+	// runs a queued sync even while stopping, and synced is never freed.
+	xSemaphoreTake(m, portMAX_DELAY);
+	post_t ret = enqueue(&(cmd_t){.op = OP_SYNC});
+	if (ret == POST_DONE) xSemaphoreTake(synced, portMAX_DELAY);
+	xSemaphoreGive(m);
+	return ret != POST_FULL;
+}
+
+bool lcd_queue_call(lcd_queue_fn_t fn, void *arg)
+{
+	return post(&(cmd_t){.op = OP_CALL, .fn = fn, .arg = arg});
+}
+
+bool lcd_queue_fillScreen(color_t color)
+{
+	return post(&(cmd_t){.op = OP_FILL_SCREEN, .color = color});
+}
+
+bool lcd_queue_drawPixel(coord_t x, coord_t y, color_t color)
+{
+	return post(&(cmd_t){.op = OP_PIXEL, .color = color, .a = {x, y}});
+}
+
+bool lcd_queue_drawHLine(coord_t x, coord_t y, coord_t w, color_t color)
+{
+	return post(&(cmd_t){.op = OP_HLINE, .color = color, .a = {x, y, w}});
+}
+
+bool lcd_queue_drawVLine(coord_t x, coord_t y, coord_t h, color_t color)
+{
+	return post(&(cmd_t){.op = OP_VLINE, .color = color, .a = {x, y, h}});
+}
+
+bool lcd_queue_drawLine(coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color)
+{
+	return post(&(cmd_t){.op = OP_LINE, .color = color, .a = {x0, y0, x1, y1}});
+}
+
+bool lcd_queue_drawRect(coord_t x, coord_t y, coord_t w, coord_t h, color_t color)
+{
+	return post(&(cmd_t){.op = OP_RECT, .color = color, .a = {x, y, w, h}});
+}
+
+bool lcd_queue_fillRect(coord_t x, coord_t y, coord_t w, coord_t h, color_t color)
+{
+	return post(&(cmd_t){.op = OP_FILL_RECT, .color = color, .a = {x, y, w, h}});
+}
+
+bool lcd_queue_drawCircle(coord_t x, coord_t y, coord_t r, color_t color)
+{
+	return post(&(cmd_t){.op = OP_CIRCLE, .color = color, .a = {x, y, r}});
+}
+
+bool lcd_queue_fillCircle(coord_t x, coord_t y, coord_t r, color_t color)
+{
+	return post(&(cmd_t){.op = OP_FILL_CIRCLE, .color = color, .a = {x, y, r}});
+}
+
+bool lcd_queue_drawString(coord_t x, coord_t y, const char *str, color_t color)
+{
+	cmd_t c = {.op = OP_STRING, .color = color, .a = {x, y}};
+	strncpy(c.text, str, LCD_QUEUE_TEXT-1);
+	return post(&c);
+}
+
+bool lcd_queue_writeFrame(void)
+{
+	return post(&(cmd_t){.op = OP_WRITE_FRAME});
+}
@@ -0,0 +1,208 @@
+#ifndef LCD_QUEUE_H_
+#define LCD_QUEUE_H_
+/**
+ * @file
+ * @brief Draw command queue served by one render task.
+ * @details Any number of tasks post draw commands without blocking: a post
+ * claims a slot in a fixed ring with an atomic compare and swap, so there
+ * is no mutex to wait on and no task waits for the bus. One render task,
+ * started by lcd_queue_start(), takes the commands in order and is the only
+ * caller of the LCD functions, so address windows and the shared transfer
+ * buffers are never interleaved. Before lcd_queue_start(), and after
+ * lcd_queue_stop(), every post draws at once on the calling task. These
+ * direct draws are serialized by a mutex, so tasks may post before the
+ * render task runs, each waiting for the one drawing. Every post returns
+ * without waiting for the render task; only a direct draw blocks, for the
+ * mutex and the draw itself.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lcd.h"
+
+/** @brief Longest string, in bytes with the terminator, a post carries. */
+#define LCD_QUEUE_TEXT 32
+
+/** @brief Function run on the render task by lcd_queue_call(). */
+typedef void (*lcd_queue_fn_t)(void *arg);
+
+/**
+ * @brief Start the render task.
+ * @param slots Number of commands the queue holds, rounded up to a power
+ *  of two.
+ * @param prio  Priority of the render task.
+ * @param core  Core the render task is pinned to.
+ * @returns True if the task is running.
+ * @note  Call after lcd_init() and the mode setup. While the task runs,
+ *  draw only through this queue or lcd_queue_call().
+ */
+bool lcd_queue_start(uint32_t slots, uint32_t prio, int32_t core);
+
+/**
+ * @brief Run every command already posted, then stop the render task.
+ * @details Posts made while stopping are refused. Once stopped, posts
+ *  draw at once again.
+ * @note  Not to be called at the same time as lcd_queue_start().
+ */
+void lcd_queue_stop(void);
+
+/**
+ * @brief Wait until every command posted before this call has been run.
+ * @details Tasks syncing at the same time wait in turn. Nothing is
+ *  allocated per call.
+ * @returns False if the queue was full or stopping.
+ */
+bool lcd_queue_sync(void);
+
+/**
+ * @brief Run a function on the render task, in order with the draws.
+ * @details For anything without its own post, such as font settings or
+ *  a bitmap. The function may call any LCD function, but must not post or
+ *  sync, as a direct draw holds the mutex while it runs.
+ * @param fn  Function.
+ * @param arg Argument passed to the function.
+ * @returns False if the queue was full or stopping.
+ */
+bool lcd_queue_call(lcd_queue_fn_t fn, void *arg);
+
+/**
+ * @brief Post lcd_fillScreen().
+ * @details Returns at once while the render task runs, otherwise draws on
+ *  this task, waiting for any other direct draw.
+ * @param color Fill color.
+ * @returns True if queued or drawn, false if the queue was full or
+ *  stopping and the draw was dropped.
+ */
+bool lcd_queue_fillScreen(color_t color);
+
+/**
+ * @brief Post lcd_drawPixel().
+ * @details Returns at once while the render task runs, otherwise draws on
+ *  this task, waiting for any other direct draw.
+ * @param x     Column.
+ * @param y     Row.
+ * @param color Pixel color.
+ * @returns True if queued or drawn, false if the queue was full or
+ *  stopping and the draw was dropped.
+ */
+bool lcd_queue_drawPixel(coord_t x, coord_t y, color_t color);
+
+/**
+ * @brief Post lcd_drawHLine().
+ * @details Returns at once while the render task runs, otherwise draws on
+ *  this task, waiting for any other direct draw.
+ * @param x     Left column.
+ * @param y     Row.
+ * @param w     Width.
+ * @param color Line color.
+ * @returns True if queued or drawn, false if the queue was full or
+ *  stopping and the draw was dropped.
+ */
+bool lcd_queue_drawHLine(coord_t x, coord_t y, coord_t w, color_t color);
+
+/**
+ * @brief Post lcd_drawVLine().
+ * @details Returns at once while the render task runs, otherwise draws on
+ *  this task, waiting for any other direct draw.
+ * @param x     Column.
+ * @param y     Top row.
+ * @param h     Height.
+ * @param color Line color.
+ * @returns True if queued or drawn, false if the queue was full or
+ *  stopping and the draw was dropped.
+ */
+bool lcd_queue_drawVLine(coord_t x, coord_t y, coord_t h, color_t color);
+
+/**
+ * @brief Post lcd_drawLine().
+ * @details Returns at once while the render task runs, otherwise draws on
+ *  this task, waiting for any other direct draw.
+ * @param x0    Start column.
+ * @param y0    Start row.
+ * @param x1    End column.
+ * @param y1    End row.
+ * @param color Line color.
+ * @returns True if queued or drawn, false if the queue was full or
+ *  stopping and the draw was dropped.
+ */
+bool lcd_queue_drawLine(coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color);
+
+/**
+ * @brief Post lcd_drawRect().
+ * @details Returns at once while the render task runs, otherwise draws on
+ *  this task, waiting for any other direct draw.
+ * @param x     Left column.
+ * @param y     Top row.
+ * @param w     Width.
+ * @param h     Height.
+ * @param color Outline color.
+ * @returns True if queued or drawn, false if the queue was full or
+ *  stopping and the draw was dropped.
+ */
+bool lcd_queue_drawRect(coord_t x, coord_t y, coord_t w, coord_t h, color_t color);
+
+/**
+ * @brief Post lcd_fillRect().
+ * @details Returns at once while the render task runs, otherwise draws on
+ *  this task, waiting for any other direct draw.
+ * @param x     Left column.
+ * @param y     Top row.
+ * @param w     Width.
+ * @param h     Height.
+ * @param color Fill color.
+ * @returns True if queued or drawn, false if the queue was full or
+ *  stopping and the draw was dropped.
+ */
+bool lcd_queue_fillRect(coord_t x, coord_t y, coord_t w, coord_t h, color_t color);
+
+/**
+ * @brief Post lcd_drawCircle().
+ * @details Returns at once while the render task runs, otherwise draws on
+ *  this task, waiting for any other direct draw.
+ * @param x     Center column.
+ * @param y     Center row.
+ * @param r     Radius.
+ * @param color Outline color.
+ * @returns True if queued or drawn, false if the queue was full or
+ *  stopping and the draw was dropped.
+ */
+bool lcd_queue_drawCircle(coord_t x, coord_t y, coord_t r, color_t color);
+
+/**
+ * @brief Post lcd_fillCircle().
+ * @details Returns at once while the render task runs, otherwise draws on
+ *  this task, waiting for any other direct draw.
+ * @param x     Center column.
+ * @param y     Center row.
+ * @param r     Radius.
+ * @param color Fill color.
+ * @returns True if queued or drawn, false if the queue was full or
+ *  stopping and the draw was dropped.
+ */
+bool lcd_queue_fillCircle(coord_t x, coord_t y, coord_t r, color_t color);
+
+/**
+ * @brief Post lcd_drawString().
+ * @details Returns at once while the render task runs, otherwise draws on
+ *  this task, waiting for any other direct draw. The string is copied into
+ *  the command, cut to LCD_QUEUE_TEXT-1 characters, and drawn with the font
+ *  settings of the render task.
+ * @param x     Left column.
+ * @param y     Top row.
+ * @param str   String.
+ * @param color Text color.
+ * @returns True if queued or drawn, false if the queue was full or
+ *  stopping and the draw was dropped.
+ */
+bool lcd_queue_drawString(coord_t x, coord_t y, const char *str, color_t color);
+
+/**
+ * @brief Post lcd_writeFrame().
+ * @details Returns at once while the render task runs, otherwise draws on
+ *  this task, waiting for any other direct draw.
+ * @returns True if queued or written, false if the queue was full or
+ *  stopping and the write was dropped.
+ */
+bool lcd_queue_writeFrame(void);
+
+#endif // LCD_QUEUE_H_
@@ -0,0 +1,214 @@
+// Sprite table: records changes and redraws only the regions they affect.
+
+#include "lcd_sprite.h"
+
+#define DAMAGE_MAX (2*LCD_SPRITE_MAX) // old and new bounds of every sprite
+
+typedef struct {
+	coord_t x0, y0; // top left corner
+	coord_t x1, y1; // bottom right corner, inclusive
+} box_t;
+
+typedef struct {
+	const lcd_rle_rgb_t *const *frames;
+	uint16_t count;  // number of frames
+	uint16_t frame;  // current frame
+	coord_t x, y;    // top left corner
+	int8_t depth;
+	uint32_t seq;    // order added, breaks depth ties
+	bool used;       // entry holds a sprite
+	bool visible;
+	bool changed;    // differs from what was last drawn
+	bool shown;      // drawn at box by the last render
+	box_t box;       // bounds when last drawn
+} sprite_t;
+
+static sprite_t sprite[LCD_SPRITE_MAX];
+static uint32_t sprite_seq;
+static color_t back_color;
+static const color_t *back_image;
+static coord_t back_w, back_h;
+
+//----------------------------------------------------------------------------//
+// Helpers
+//----------------------------------------------------------------------------//
+
+// Look up a sprite number, NULL if it is not in use.
+static sprite_t *get(int32_t id)
+{
+	if (id < 0 || id >= LCD_SPRITE_MAX || !sprite[id].used) return NULL;
+	return &sprite[id];
+}
+
+static inline int32_t area(const box_t *b)
+{
+	return (int32_t)(b->x1-b->x0+1)*(b->y1-b->y0+1);
+}
+
+static inline bool overlap(const box_t *a, const box_t *b)
+{
+	return a->x0 <= b->x1 && b->x0 <= a->x1 && a->y0 <= b->y1 && b->y0 <= a->y1;
+}
+
+// Add a region to the damage list. A region is merged with one it overlaps
+// when their union is no larger than the two apart.
+static void damage_add(box_t *list, uint16_t *n, box_t b)
+{
+	for (uint16_t i = 0; i < *n; ) {
+		box_t u = list[i];
+		if (b.x0 < u.x0) u.x0 = b.x0;
+		if (b.y0 < u.y0) u.y0 = b.y0;
+		if (b.x1 > u.x1) u.x1 = b.x1;
+		if (b.y1 > u.y1) u.y1 = b.y1;
+		if (overlap(&list[i], &b) && area(&u) <= area(&list[i]) + area(&b)) {
+			b = u; // merged, the union may now overlap others
+			list[i] = list[--*n];
+			i = 0;
+		} else {
+			i++;
+		}
+	}
+	list[(*n)++] = b;
+}
+
+// Current bounds of a sprite.
+static box_t bounds(const sprite_t *s)
+{
+	const lcd_rle_rgb_t *f = s->frames[s->frame];
+	return (box_t){s->x, s->y, s->x+f->w-1, s->y+f->h-1};
+}
+
+static inline bool below(const sprite_t *a, const sprite_t *b)
+{
+	return a->depth < b->depth || (a->depth == b->depth && a->seq < b->seq);
+}
+
+//----------------------------------------------------------------------------//
+// Public functions
+//----------------------------------------------------------------------------//
+
+void lcd_sprite_init(void)
+{
+	for (uint16_t i = 0; i < LCD_SPRITE_MAX; i++) sprite[i].used = sprite[i].shown = false;
+	sprite_seq = 0;
+	lcd_sprite_background(BLACK, NULL, 0, 0);
+}
+
+void lcd_sprite_background(color_t color, const color_t *image, coord_t w, coord_t h)
+{
+	back_color = color;
+	back_image = image;
+	back_w = w;
+	back_h = h;
+}
+
+int32_t lcd_sprite_add(const lcd_rle_rgb_t *const *frames, uint16_t count, int8_t depth)
+{
+	if (frames == NULL || count == 0) return -1;
+	for (int32_t i = 0; i < LCD_SPRITE_MAX; i++) {
+		sprite_t *s = &sprite[i];
+		// A removed sprite keeps its entry until it has been erased.
+		if (s->used || s->shown) continue;
+		*s = (sprite_t){
+			.frames = frames, .count = count, .depth = depth,
+			.seq = sprite_seq++, .used = true, .visible = true, .changed = true,
+		};
+		return i;
+	}
+	return -1;
+}
+
+void lcd_sprite_remove(int32_t id)
+{
+	sprite_t *s = get(id);
+	if (s == NULL) return;
+	s->used = false;
+	s->changed = true;
+}
+
+void lcd_sprite_move(int32_t id, coord_t x, coord_t y)
+{
+	sprite_t *s = get(id);
+	if (s == NULL || (s->x == x && s->y == y)) return;
+	s->x = x;
+	s->y = y;
+	s->changed = true;
+}
+
+void lcd_sprite_frame(int32_t id, uint16_t frame)
+{
+	sprite_t *s = get(id);
+	if (s == NULL) return;
+	frame %= s->count;
+	if (s->frame == frame) return;
+	s->frame = frame;
+	s->changed = true;
+}
+
+void lcd_sprite_depth(int32_t id, int8_t depth)
+{
+	sprite_t *s = get(id);
+	if (s == NULL || s->depth == depth) return;
+	s->depth = depth;
+	s->changed = true;
+}
+
+void lcd_sprite_show(int32_t id, bool visible)
+{
+	sprite_t *s = get(id);
+	if (s == NULL || s->visible == visible) return;
+	s->visible = visible;
+	s->changed = true;
+}
+
+void lcd_sprite_refresh(void)
+{
+	for (uint16_t i = 0; i < LCD_SPRITE_MAX; i++) {
+		if (sprite[i].used && sprite[i].visible) sprite[i].changed = true;
+	}
+}
+
+void lcd_sprite_render(void)
+{
+	box_t damage[DAMAGE_MAX];
+	uint16_t n = 0;
+	sprite_t *order[LCD_SPRITE_MAX];
+	uint16_t m = 0;
+
+	// Regions to redraw: where changed sprites were and where they are now.
+	for (uint16_t i = 0; i < LCD_SPRITE_MAX; i++) {
+		sprite_t *s = &sprite[i];
+		if (!s->changed) continue;
+		if (s->shown) damage_add(damage, &n, s->box);
+		s->shown = s->used && s->visible;
+		if (s->shown) {
+			s->box = bounds(s);
+			damage_add(damage, &n, s->box);
+		}
+		s->changed = false;
+	}
+	if (n == 0) return;
+
+	// Visible sprites in depth order, by insertion.
+	for (uint16_t i = 0; i < LCD_SPRITE_MAX; i++) {
+		sprite_t *s = &sprite[i];
+		if (!s->shown) continue;
+		uint16_t j = m++;
+		for (; j > 0 && below(s, order[j-1]); j--) order[j] = order[j-1];
+		order[j] = s;
+	}
+
+	for (uint16_t i = 0; i < n; i++) {
+		const box_t *d = &damage[i];
+		lcd_setClip(d->x0, d->y0, d->x1-d->x0+1, d->y1-d->y0+1);
+		if (back_image == NULL || d->x1 >= back_w || d->y1 >= back_h) {
+			lcd_fillRect(d->x0, d->y0, d->x1-d->x0+1, d->y1-d->y0+1, back_color);
+		}
+		if (back_image != NULL) lcd_drawRGBBitmap(0, 0, back_image, back_w, back_h);
+		for (uint16_t k = 0; k < m; k++) {
+			if (!overlap(&order[k]->box, d)) continue;
+			lcd_drawRGBBitmapRLE(order[k]->x, order[k]->y, order[k]->frames[order[k]->frame]);
+		}
+	}
+	lcd_resetClip();
+}
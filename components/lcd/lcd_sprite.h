@@ -0,0 +1,101 @@
+#ifndef LCD_SPRITE_H_
+#define LCD_SPRITE_H_
+/**
+ * @file
+ * @brief Sprite table drawn on top of the LCD primitives.
+ * @details Each sprite has a position, a set of run-length encoded frames
+ * (see lcd_rleEncodeRGB()), a current frame and a depth. Changes are only
+ * recorded until lcd_sprite_render(), which restores the background under
+ * the bounds each changed sprite had when last drawn and where it is now,
+ * then redraws, within those regions and in depth order, every sprite
+ * that overlaps them. Only opaque sprite pixels are written, so sprites
+ * that did not change and lie elsewhere cost nothing. Use with the frame
+ * buffer to avoid flicker.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lcd.h"
+
+/** @brief Number of entries in the sprite table. */
+#define LCD_SPRITE_MAX 64
+
+/**
+ * @brief Empty the sprite table and set a black background.
+ * @note  Nothing is erased from the screen.
+ */
+void lcd_sprite_init(void);
+
+/**
+ * @brief Set what is restored under sprites when they move or change.
+ * @param color Background color, used where there is no image.
+ * @param image Screen background image at the top left corner, or NULL
+ *  for a plain color. Referenced, not copied.
+ * @param w     Width of the image in pixels.
+ * @param h     Height of the image in pixels.
+ * @note  With layers, sprites can be drawn into a dynamic layer and its key
+ *  color used as the background.
+ */
+void lcd_sprite_background(color_t color, const color_t *image, coord_t w, coord_t h);
+
+/**
+ * @brief Add a sprite to the table. It is shown at 0,0 with frame 0 from
+ *  the next render.
+ * @param frames Encoded frames, all referenced, not copied.
+ * @param count  Number of frames.
+ * @param depth  Depth, higher values are drawn on top. Sprites of equal
+ *  depth are drawn in the order they were added.
+ * @returns Sprite number, or -1 if the table is full.
+ */
+int32_t lcd_sprite_add(const lcd_rle_rgb_t *const *frames, uint16_t count, int8_t depth);
+
+/**
+ * @brief Remove a sprite. It is erased on the next render.
+ * @param id Sprite number.
+ */
+void lcd_sprite_remove(int32_t id);
+
+/**
+ * @brief Move a sprite.
+ * @param id Sprite number.
+ * @param x  Top left corner X coordinate.
+ * @param y  Top left corner Y coordinate.
+ */
+void lcd_sprite_move(int32_t id, coord_t x, coord_t y);
+
+/**
+ * @brief Select the frame a sprite shows.
+ * @param id    Sprite number.
+ * @param frame Frame index, taken modulo the number of frames.
+ */
+void lcd_sprite_frame(int32_t id, uint16_t frame);
+
+/**
+ * @brief Change the depth of a sprite.
+ * @param id    Sprite number.
+ * @param depth Depth, higher values are drawn on top.
+ */
+void lcd_sprite_depth(int32_t id, int8_t depth);
+
+/**
+ * @brief Show or hide a sprite.
+ * @param id      Sprite number.
+ * @param visible True to show the sprite.
+ */
+void lcd_sprite_show(int32_t id, bool visible);
+
+/**
+ * @brief Draw every visible sprite again on the next render, such as after
+ *  the background was redrawn.
+ */
+void lcd_sprite_refresh(void);
+
+/**
+ * @brief Bring the screen up to date with the sprite table.
+ * @details Only regions covered by changed sprites, before and after the
+ *  change, are drawn. Call before lcd_writeFrame().
+ * @note  Sets the clip rectangle while drawing and resets it afterwards.
+ */
+void lcd_sprite_render(void);
+
+#endif // LCD_SPRITE_H_
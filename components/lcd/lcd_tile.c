@@ -0,0 +1,267 @@
+// Deferred rendering: draw calls are recorded into a compact command list
+// and rasterized one band of rows at a time when the frame is written.
+
+#include <string.h> // memset, memcpy
+
+#include "lcd_pix.h"
+#include "lcd_tile.h"
+
+#define SWAP16(c) ((color_t)(((c) << 8) | ((c) >> 8)))
+
+// Command types, stored in the low byte of the first word.
+#define TILE_POINT  1 // 2 words: type|color, x|y
+#define TILE_RECT   2 // 3 words: type|color, x|y, w|h
+#define TILE_PIXELS 3 // 2 words + pointer: type|w, x|y, colors
+
+#define PTR_WORDS ((sizeof(const color_t *)+sizeof(uint32_t)-1)/sizeof(uint32_t))
+
+#define PACK(lo,hi) ((uint32_t)(uint16_t)(lo) | (uint32_t)(uint16_t)(hi) << 16)
+#define LO(w) ((coord_t)(int16_t)((w) & 0xFFFF))
+#define HI(w) ((coord_t)(int16_t)((w) >> 16))
+
+//----------------------------------------------------------------------------//
+// Helpers
+//----------------------------------------------------------------------------//
+
+// Mark the bands covered by rows y0 through y1 as touched.
+static void touch(lcd_tile_list_t *l, coord_t y0, coord_t y1)
+{
+	for (uint16_t b = y0/l->band_h; b <= y1/l->band_h; b++)
+		l->touched[b >> 5] |= 1UL << (b & 31);
+}
+
+// Reserve n words of command storage, or count the command as dropped.
+static uint32_t *reserve(lcd_tile_list_t *l, size_t n)
+{
+	if (l->used + n > l->size) {
+		l->dropped++;
+		return NULL;
+	}
+	uint32_t *p = l->cmd + l->used;
+	l->used += n;
+	l->count++;
+	return p;
+}
+
+// Wrap a coordinate into 0 through n-1.
+static inline coord_t wrap(coord_t v, coord_t n)
+{
+	v %= n;
+	return (v < 0) ? v+n : v;
+}
+
+// Fill a band from the map, one tile row segment at a time.
+static void map_raster(const lcd_tile_list_t *l, coord_t by0, coord_t rows, color_t *tile, bool swap)
+{
+	const lcd_tilemap_t *m = l->map;
+	uint8_t shift = (m->size == 16) ? 4 : 3;
+	coord_t size = m->size, map_w = m->cols << shift, map_h = m->rows << shift;
+	coord_t w = l->width;
+	coord_t my = wrap(by0 + l->map_y, map_h);
+
+	for (coord_t r = 0; r < rows; r++, tile += w) {
+		const uint8_t *idx = m->index + (size_t)(my >> shift)*m->cols;
+		const color_t *row = m->atlas + ((my & (size-1)) << shift);
+		coord_t mx = l->map_x;
+		for (coord_t x = 0; x < w; ) {
+			coord_t tx = mx & (size-1);
+			coord_t n = size - tx;
+			if (n > w-x) n = w-x;
+			const color_t *src = row + ((size_t)idx[mx >> shift] << (2*shift)) + tx;
+			if (swap) {
+				lcd_pix_copySwap(tile+x, src, n);
+			} else {
+				lcd_pix_copy(tile+x, src, n);
+			}
+			x += n;
+			if ((mx += n) == map_w) mx = 0;
+		}
+		if (++my == map_h) my = 0;
+	}
+}
+
+//----------------------------------------------------------------------------//
+// Public functions
+//----------------------------------------------------------------------------//
+
+void lcd_tile_init(lcd_tile_list_t *l, uint32_t *mem, size_t bytes,
+	coord_t width, coord_t height, coord_t band_h)
+{
+	l->cmd = mem;
+	l->size = bytes / sizeof(uint32_t);
+	l->clear = 0;
+	l->map = NULL;
+	l->map_x = l->map_y = 0;
+	l->width = width;
+	l->height = height;
+	l->band_h = (band_h < 1) ? 1 : band_h;
+	lcd_tile_reset(l);
+	// Nothing is known about the display contents yet.
+	l->recolor = true;
+}
+
+void lcd_tile_reset(lcd_tile_list_t *l)
+{
+	l->used = 0;
+	l->count = 0;
+	l->dropped = 0;
+	l->recolor = false;
+	memcpy(l->shown, l->touched, sizeof(l->shown));
+	memset(l->touched, 0, sizeof(l->touched));
+}
+
+void lcd_tile_clear(lcd_tile_list_t *l, color_t color)
+{
+	// Earlier commands are covered, but their bands stay marked so that
+	// they are sent if the fill color matches what was there before.
+	l->used = 0;
+	l->count = 0;
+	if (color != l->clear || l->map != NULL) l->recolor = true;
+	l->clear = color;
+	l->map = NULL;
+}
+
+void lcd_tile_map(lcd_tile_list_t *l, const lcd_tilemap_t *map)
+{
+	l->map = map;
+	l->recolor = true;
+	if (map != NULL) lcd_tile_map_scroll(l, l->map_x, l->map_y);
+}
+
+void lcd_tile_map_scroll(lcd_tile_list_t *l, coord_t x, coord_t y)
+{
+	if (l->map == NULL) {
+		l->map_x = x;
+		l->map_y = y;
+		return;
+	}
+	x = wrap(x, l->map->cols * l->map->size);
+	y = wrap(y, l->map->rows * l->map->size);
+	if (x == l->map_x && y == l->map_y) return;
+	l->map_x = x;
+	l->map_y = y;
+	l->recolor = true;
+}
+
+void lcd_tile_map_touch(lcd_tile_list_t *l, uint16_t col, uint16_t row, uint16_t cols, uint16_t rows)
+{
+	const lcd_tilemap_t *m = l->map;
+	(void)col; // bands are full width, only the rows matter
+	if (m == NULL || cols == 0 || rows == 0) return;
+	if (rows >= m->rows) {
+		touch(l, 0, l->height-1);
+		return;
+	}
+	// The map may show more than once down the screen, check every row.
+	coord_t map_h = m->rows * m->size;
+	coord_t my = l->map_y;
+	for (coord_t y = 0; y < l->height; y++) {
+		coord_t tr = my / m->size;
+		if (wrap(tr - row, m->rows) < rows) touch(l, y, y);
+		if (++my == map_h) my = 0;
+	}
+}
+
+bool lcd_tile_rect(lcd_tile_list_t *l, coord_t x, coord_t y, coord_t w, coord_t h, color_t color)
+{
+	uint32_t *p;
+
+	if (w <= 0 || h <= 0) return true;
+	if (w == 1 && h == 1) {
+		if ((p = reserve(l, 2)) == NULL) return false;
+		p[0] = PACK(TILE_POINT, color);
+		p[1] = PACK(x, y);
+	} else {
+		if ((p = reserve(l, 3)) == NULL) return false;
+		p[0] = PACK(TILE_RECT, color);
+		p[1] = PACK(x, y);
+		p[2] = PACK(w, h);
+	}
+	touch(l, y, y+h-1);
+	return true;
+}
+
+bool lcd_tile_pixels(lcd_tile_list_t *l, coord_t x, coord_t y, coord_t w, const color_t *colors)
+{
+	uint32_t *p;
+
+	if (w <= 0) return true;
+	if ((p = reserve(l, 2+PTR_WORDS)) == NULL) return false;
+	p[0] = PACK(TILE_PIXELS, w);
+	p[1] = PACK(x, y);
+	memcpy(p+2, &colors, sizeof(colors));
+	touch(l, y, y);
+	return true;
+}
+
+uint16_t lcd_tile_bands(const lcd_tile_list_t *l)
+{
+	return (l->height + l->band_h - 1) / l->band_h;
+}
+
+bool lcd_tile_changed(const lcd_tile_list_t *l, uint16_t band)
+{
+	uint32_t bit = 1UL << (band & 31);
+	return l->recolor ||
+		(l->touched[band >> 5] & bit) || (l->shown[band >> 5] & bit);
+}
+
+coord_t lcd_tile_raster(const lcd_tile_list_t *l, uint16_t band, color_t *tile, bool swap)
+{
+	coord_t by0 = band * l->band_h;
+	coord_t rows = l->height - by0;
+	if (rows > l->band_h) rows = l->band_h;
+	if (rows <= 0) return 0;
+	coord_t by1 = by0 + rows - 1;
+	coord_t w = l->width;
+
+	if (l->map != NULL) {
+		map_raster(l, by0, rows, tile, swap);
+	} else {
+		lcd_pix_fill(tile, swap ? SWAP16(l->clear) : l->clear, (size_t)w*rows);
+	}
+
+	// Replay every command in order, clipped to the band.
+	for (const uint32_t *p = l->cmd, *end = l->cmd + l->used; p < end; ) {
+		uint32_t w0 = p[0];
+		coord_t x = LO(p[1]), y = HI(p[1]);
+		switch (w0 & 0xFF) {
+			case TILE_POINT: {
+				p += 2;
+				if (y < by0 || y > by1) break;
+				color_t c = (color_t)(w0 >> 16);
+				tile[(y-by0)*w+x] = swap ? SWAP16(c) : c;
+				break;
+			}
+			case TILE_RECT: {
+				coord_t rw = LO(p[2]), rh = HI(p[2]);
+				p += 3;
+				coord_t y0 = (y < by0) ? by0 : y;
+				coord_t y1 = (y+rh-1 > by1) ? by1 : y+rh-1;
+				if (y0 > y1) break;
+				color_t c = (color_t)(w0 >> 16);
+				if (swap) c = SWAP16(c);
+				for (color_t *dst = tile+(y0-by0)*w+x; y0 <= y1; y0++, dst += w)
+					lcd_pix_fill(dst, c, rw);
+				break;
+			}
+			case TILE_PIXELS: {
+				coord_t n = HI(w0);
+				const color_t *src;
+				memcpy(&src, p+2, sizeof(src));
+				p += 2+PTR_WORDS;
+				if (y < by0 || y > by1) break;
+				color_t *dst = tile+(y-by0)*w+x;
+				if (swap) {
+					lcd_pix_copySwap(dst, src, n);
+				} else {
+					lcd_pix_copy(dst, src, n);
+				}
+				break;
+			}
+			default: // corrupt list, stop
+				return rows;
+		}
+	}
+	return rows;
+}
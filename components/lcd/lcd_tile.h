@@ -0,0 +1,142 @@
+#ifndef LCD_TILE_H_
+#define LCD_TILE_H_
+/**
+ * @file
+ * @brief Command list and band rasterizer for deferred (tiled) rendering.
+ * @details Draw calls are recorded as filled rectangles and pixel runs.
+ * At flush, the list is rasterized one full-width band of rows at a time
+ * into a small buffer that is sent to the display. This module has no
+ * hardware dependencies so it can be built and checked on a host.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "lcd.h"
+
+/** @brief Words in the touched-band bit masks (one bit per row at most). */
+#define LCD_TILE_MASK_WORDS ((LCD_H+31)/32)
+
+/** @brief Recorded draw commands for one frame. */
+typedef struct {
+	uint32_t *cmd;     /**< Command storage. */
+	size_t   size;     /**< Storage size in words. */
+	size_t   used;     /**< Storage words used. */
+	uint32_t count;    /**< Commands recorded this frame. */
+	uint32_t dropped;  /**< Commands that did not fit this frame. */
+	color_t  clear;    /**< Color every band starts from, without a map. */
+	bool     recolor;  /**< Clear color, map or map position changed this frame. */
+	const lcd_tilemap_t *map; /**< Background map, or NULL. */
+	coord_t  map_x;    /**< Map pixel at the left edge of the screen. */
+	coord_t  map_y;    /**< Map pixel at the top edge of the screen. */
+	coord_t  width;    /**< Screen width in pixels. */
+	coord_t  height;   /**< Screen height in pixels. */
+	coord_t  band_h;   /**< Rows per band. */
+	uint32_t touched[LCD_TILE_MASK_WORDS]; /**< Bands drawn this frame. */
+	uint32_t shown[LCD_TILE_MASK_WORDS];   /**< Bands drawn last frame. */
+} lcd_tile_list_t;
+
+/**
+ * @brief Initialize a command list.
+ * @param l      Command list.
+ * @param mem    Storage for commands, 32-bit aligned.
+ * @param bytes  Size of the storage in bytes.
+ * @param width  Screen width in pixels.
+ * @param height Screen height in pixels, up to LCD_H.
+ * @param band_h Rows per band (1 or more).
+ * @note  Every band is reported as changed after initialization.
+ */
+void lcd_tile_init(lcd_tile_list_t *l, uint32_t *mem, size_t bytes,
+	coord_t width, coord_t height, coord_t band_h);
+
+/**
+ * @brief Start a new frame. Commands are discarded, the clear color is kept.
+ * @param l Command list.
+ */
+void lcd_tile_reset(lcd_tile_list_t *l);
+
+/**
+ * @brief Set a tilemap as the background every band starts from.
+ * @param l   Command list.
+ * @param map Tilemap with 8 or 16 pixel tiles, or NULL for the clear color.
+ */
+void lcd_tile_map(lcd_tile_list_t *l, const lcd_tilemap_t *map);
+
+/**
+ * @brief Set the map position at the top left corner of the screen.
+ * @param l Command list.
+ * @param x Map X coordinate in pixels, wrapped to the map.
+ * @param y Map Y coordinate in pixels, wrapped to the map.
+ */
+void lcd_tile_map_scroll(lcd_tile_list_t *l, coord_t x, coord_t y);
+
+/**
+ * @brief Mark the bands showing a range of map cells as changed.
+ * @param l    Command list.
+ * @param col  First column.
+ * @param row  First row.
+ * @param cols Number of columns.
+ * @param rows Number of rows.
+ */
+void lcd_tile_map_touch(lcd_tile_list_t *l, uint16_t col, uint16_t row, uint16_t cols, uint16_t rows);
+
+/**
+ * @brief Record a full screen fill. Earlier commands are discarded since
+ *  they are covered. A tilemap is replaced by the color.
+ * @param l     Command list.
+ * @param color Color value.
+ */
+void lcd_tile_clear(lcd_tile_list_t *l, color_t color);
+
+/**
+ * @brief Record a filled rectangle, already clipped to the screen.
+ * @param l     Command list.
+ * @param x     Top left corner X coordinate.
+ * @param y     Top left corner Y coordinate.
+ * @param w     Width in pixels.
+ * @param h     Height in pixels.
+ * @param color Color value.
+ * @returns False if the command list is full.
+ */
+bool lcd_tile_rect(lcd_tile_list_t *l, coord_t x, coord_t y, coord_t w, coord_t h, color_t color);
+
+/**
+ * @brief Record a horizontal run of pixels, already clipped to the screen.
+ * @param l      Command list.
+ * @param x      X coordinate of the first pixel.
+ * @param y      Y coordinate.
+ * @param w      Width of the run.
+ * @param colors Array of color values. Referenced, not copied, so it must
+ *  remain valid until the list is rasterized.
+ * @returns False if the command list is full.
+ */
+bool lcd_tile_pixels(lcd_tile_list_t *l, coord_t x, coord_t y, coord_t w, const color_t *colors);
+
+/**
+ * @brief Get the number of bands covering the screen.
+ * @param l Command list.
+ * @returns Number of bands.
+ */
+uint16_t lcd_tile_bands(const lcd_tile_list_t *l);
+
+/**
+ * @brief Check if a band can differ from what was last sent.
+ * @details True if the band was drawn this frame or last frame, or if the
+ *  clear color changed this frame.
+ * @param l    Command list.
+ * @param band Band index.
+ * @returns True if the band needs to be sent.
+ */
+bool lcd_tile_changed(const lcd_tile_list_t *l, uint16_t band);
+
+/**
+ * @brief Rasterize one band of the recorded frame.
+ * @param l    Command list.
+ * @param band Band index.
+ * @param tile Destination, width*band_h pixels.
+ * @param swap Store pixels in display (big-endian) byte order.
+ * @returns Number of rows in the band.
+ */
+coord_t lcd_tile_raster(const lcd_tile_list_t *l, uint16_t band, color_t *tile, bool swap);
+
+#endif // LCD_TILE_H_
@@ -0,0 +1,66 @@
+#ifndef SPI_MASTER_H_
+#define SPI_MASTER_H_
+// Host build: SPI master calls used by the LCD component. Transfers are
+// decoded by the simulated panel in lcd_sim.c.
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef enum {
+	SPI1_HOST = 0,
+	SPI2_HOST = 1,
+	SPI3_HOST = 2,
+} spi_host_device_t;
+
+#define SPI_DMA_CH_AUTO      3
+#define SPI_DEVICE_NO_DUMMY  (1<<6)
+#define SPI_TRANS_USE_TXDATA (1<<3)
+#define SPI_MASTER_FREQ_40M  (80 * 1000 * 1000 / 2)
+
+typedef struct {
+	int mosi_io_num;
+	int miso_io_num;
+	int sclk_io_num;
+	int quadwp_io_num;
+	int quadhd_io_num;
+	int max_transfer_sz;
+	uint32_t flags;
+} spi_bus_config_t;
+
+struct spi_transaction_t;
+typedef void (*transaction_cb_t)(struct spi_transaction_t *trans);
+
+typedef struct {
+	uint8_t mode;
+	int clock_speed_hz;
+	int spics_io_num;
+	uint32_t flags;
+	int queue_size;
+	transaction_cb_t pre_cb;
+	transaction_cb_t post_cb;
+} spi_device_interface_config_t;
+
+typedef struct spi_transaction_t {
+	uint32_t flags;
+	size_t length; // bits
+	size_t rxlength;
+	void *user;
+	union {
+		const void *tx_buffer;
+		uint8_t tx_data[4];
+	};
+	void *rx_buffer;
+} spi_transaction_t;
+
+typedef struct spi_device_t *spi_device_handle_t;
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *cfg, int dma_chan);
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *cfg, spi_device_handle_t *handle);
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t *trans);
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *trans);
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans, TickType_t ticks);
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans, TickType_t ticks);
+
+#endif // SPI_MASTER_H_
@@ -0,0 +1,9 @@
+#ifndef ESP_ATTR_H_
+#define ESP_ATTR_H_
+// Host build: placement attributes have no meaning on the host.
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define DMA_ATTR
+
+#endif // ESP_ATTR_H_
@@ -0,0 +1,11 @@
+#ifndef ESP_ERR_H_
+#define ESP_ERR_H_
+// Host build: subset of esp_err.h used by the LCD component.
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_TIMEOUT 0x107
+
+#endif // ESP_ERR_H_
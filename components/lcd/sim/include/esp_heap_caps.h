@@ -0,0 +1,16 @@
+#ifndef ESP_HEAP_CAPS_H_
+#define ESP_HEAP_CAPS_H_
+// Host build: capability allocations come from the C heap.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_32BIT    (1<<1)
+#define MALLOC_CAP_8BIT     (1<<2)
+#define MALLOC_CAP_DMA      (1<<3)
+#define MALLOC_CAP_INTERNAL (1<<11)
+
+void *heap_caps_malloc(size_t size, uint32_t caps);
+void heap_caps_free(void *ptr);
+
+#endif // ESP_HEAP_CAPS_H_
@@ -0,0 +1,12 @@
+#ifndef ESP_LOG_H_
+#define ESP_LOG_H_
+// Host build: errors and warnings go to stderr, the rest is dropped.
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) ((void)(tag))
+#define ESP_LOGD(tag, fmt, ...) ((void)(tag))
+
+#endif // ESP_LOG_H_
@@ -0,0 +1,22 @@
+#ifndef FREERTOS_H_
+#define FREERTOS_H_
+// Host build: FreeRTOS types used by the LCD component.
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define portTICK_PERIOD_MS 10
+#define portMAX_DELAY 0xFFFFFFFFu
+#define pdMS_TO_TICKS(ms) ((ms)/portTICK_PERIOD_MS)
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdPASS  1
+
+#endif // FREERTOS_H_
@@ -0,0 +1,17 @@
+#ifndef SEMPHR_H_
+#define SEMPHR_H_
+// Host build: semaphores on POSIX threads. Takes always block until given.
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct sim_sem *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial);
+// A mutex is a binary semaphore given once, without priority inheritance.
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+
+#endif // SEMPHR_H_
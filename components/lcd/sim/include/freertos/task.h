@@ -0,0 +1,19 @@
+#ifndef TASK_H_
+#define TASK_H_
+// Host build: delays return at once, the simulated panel needs no settling.
+// Tasks are POSIX threads, the core they are pinned to is ignored.
+
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *arg);
+typedef struct sim_task *TaskHandle_t;
+
+void vTaskDelay(TickType_t ticks);
+// Gives the core to another thread.
+void taskYIELD(void);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+	uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *handle, BaseType_t core);
+// Only the calling task (NULL) can be deleted.
+void vTaskDelete(TaskHandle_t task);
+
+#endif // TASK_H_
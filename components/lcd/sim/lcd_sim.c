@@ -0,0 +1,443 @@
+// Host (Linux) stand-in for the SPI master and GPIO drivers used by the LCD
+// component. Display traffic is decoded into a virtual panel memory.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "driver/spi_master.h"
+#include "driver/gpio.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+#include "hw.h"
+#include "lcd_sim.h"
+
+// Panel memory covers the screen window and the rows used for scrolling.
+#define SIM_COLS (HW_LCD_OFFSETX+HW_LCD_W)
+#define SIM_ROWS ((HW_LCD_OFFSETY+HW_LCD_H > HW_LCD_SCROLL_LINES) ? \
+	HW_LCD_OFFSETY+HW_LCD_H : HW_LCD_SCROLL_LINES)
+
+#define SIM_QUEUE 128 // most queued transactions
+#define SIM_WRITES 256 // memory writes kept in the log
+#define SIM_DEF_TRANS_NS 2000 // rough driver cost per transaction on an ESP32
+
+// MADCTL bits
+#define MADCTL_MY 0x80 // row address order
+#define MADCTL_MX 0x40 // column address order
+#define MADCTL_MV 0x20 // row/column exchange
+
+struct spi_device_t {
+	spi_device_interface_config_t cfg;
+};
+
+static struct spi_device_t device;
+
+// Transactions queued and not yet collected.
+static spi_transaction_t *queue[SIM_QUEUE];
+static uint32_t queue_head, queue_tail;
+
+static lcd_sim_stats_t stats;
+static lcd_sim_write_t writes[SIM_WRITES];
+static uint32_t write_count; // memory writes since the last reset
+static uint32_t trans_ns = SIM_DEF_TRANS_NS;
+
+// Panel state
+static color_t gram[SIM_ROWS][SIM_COLS];
+static uint32_t dc_level; // 0: command, 1: data
+static uint8_t cmd;       // current command
+static uint8_t arg[6];    // parameters received so far
+static uint8_t argn;
+static uint8_t madctl;
+static uint16_t xs, xe, ys, ye; // address window
+static uint16_t cx, cy;         // memory write cursor
+static uint8_t hi;              // first byte of a pixel
+static bool half;               // a pixel byte is pending
+static bool scroll_on;
+static uint16_t tfa, vsa = SIM_ROWS, ssa; // vertical scroll definition
+
+//----------------------------------------------------------------------------//
+// Panel memory
+//----------------------------------------------------------------------------//
+
+// Map a logical column/page address to panel memory. Returns false if
+// outside the memory.
+static bool gram_addr(uint16_t c, uint16_t p, uint16_t *row, uint16_t *col)
+{
+	uint16_t r = p, k = c;
+
+	if (madctl & MADCTL_MV) {r = c; k = p;}
+	if (r >= SIM_ROWS || k >= SIM_COLS) return false;
+	if (madctl & MADCTL_MY) r = SIM_ROWS-1-r;
+	if (madctl & MADCTL_MX) k = SIM_COLS-1-k;
+	*row = r;
+	*col = k;
+	return true;
+}
+
+static void panel_pixel(color_t c)
+{
+	uint16_t r, k;
+
+	if (gram_addr(cx, cy, &r, &k)) gram[r][k] = c;
+	stats.pixels++;
+	if (write_count > 0 && write_count <= SIM_WRITES) writes[write_count-1].pixels++;
+	if (++cx > xe) {
+		cx = xs;
+		if (++cy > ye) cy = ys;
+	}
+}
+
+static void panel_command(uint8_t c)
+{
+	cmd = c;
+	argn = 0;
+	half = false;
+	stats.commands++;
+	switch (c) {
+		case 0x13: // NORON: Normal Display Mode On, leaves scroll mode
+			scroll_on = false;
+			break;
+		case 0x2C: // RAMWR: Memory Write
+			cx = xs;
+			cy = ys;
+			if (write_count < SIM_WRITES) {
+				writes[write_count] = (lcd_sim_write_t){
+					xs-HW_LCD_OFFSETX, ys-HW_LCD_OFFSETY,
+					xe-HW_LCD_OFFSETX, ye-HW_LCD_OFFSETY, 0,
+				};
+			}
+			write_count++;
+			break;
+		case 0x3C: // RAMWRC: Memory Write Continue
+			cmd = 0x2C;
+			break;
+	}
+}
+
+static void panel_data(uint8_t b)
+{
+	stats.data_bytes++;
+	switch (cmd) {
+		case 0x2A: // CASET: Column Address Set
+		case 0x2B: // RASET: Row Address Set
+			if (argn < 4) arg[argn++] = b;
+			if (argn == 4) {
+				uint16_t a0 = arg[0] << 8 | arg[1], a1 = arg[2] << 8 | arg[3];
+				if (cmd == 0x2A) {xs = a0; xe = a1;}
+				else {ys = a0; ye = a1;}
+				stats.windows++;
+			}
+			break;
+		case 0x2C: // RAMWR: Memory Write, RGB565 big-endian
+			if (!half) {hi = b; half = true;}
+			else {panel_pixel(hi << 8 | b); half = false;}
+			break;
+		case 0x33: // VSCRDEF: Vertical Scrolling Definition
+			if (argn < 6) arg[argn++] = b;
+			if (argn == 6) {
+				tfa = arg[0] << 8 | arg[1];
+				vsa = arg[2] << 8 | arg[3];
+			}
+			break;
+		case 0x36: // MADCTL: Memory Access Control
+			madctl = b;
+			break;
+		case 0x37: // VSCRSADD: Vertical Scrolling Start Address
+			if (argn < 2) arg[argn++] = b;
+			if (argn == 2) {
+				ssa = arg[0] << 8 | arg[1];
+				scroll_on = true;
+			}
+			break;
+	}
+}
+
+// Decode one transaction and account for its time on the bus.
+static void panel_transfer(spi_transaction_t *t)
+{
+	if (device.cfg.pre_cb != NULL) device.cfg.pre_cb(t);
+	const uint8_t *p = (t->flags & SPI_TRANS_USE_TXDATA) ? t->tx_data : t->tx_buffer;
+	size_t n = t->length/8;
+	for (size_t i = 0; i < n; i++) {
+		if (dc_level) panel_data(p[i]);
+		else panel_command(p[i]);
+	}
+	stats.transactions++;
+	stats.bus_ns += trans_ns;
+	if (device.cfg.clock_speed_hz > 0) {
+		stats.bus_ns += (uint64_t)t->length*1000000000ULL/device.cfg.clock_speed_hz;
+	}
+	if (device.cfg.post_cb != NULL) device.cfg.post_cb(t);
+}
+
+//----------------------------------------------------------------------------//
+// SPI, GPIO, heap and timer drivers
+//----------------------------------------------------------------------------//
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num)
+{
+	(void)gpio_num;
+	return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+	(void)gpio_num;
+	(void)mode;
+	return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+	if (gpio_num == HW_LCD_DC) dc_level = level;
+	return ESP_OK;
+}
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *cfg, int dma_chan)
+{
+	(void)host;
+	(void)cfg;
+	(void)dma_chan;
+	return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *cfg, spi_device_handle_t *handle)
+{
+	(void)host;
+	device.cfg = *cfg;
+	*handle = &device;
+	return ESP_OK;
+}
+
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t *trans)
+{
+	(void)handle;
+	if (queue_head != queue_tail) {
+		fprintf(stderr, "E lcd_sim: polling transfer with queued transactions\n");
+		return ESP_FAIL;
+	}
+	panel_transfer(trans);
+	return ESP_OK;
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *trans)
+{
+	return spi_device_polling_transmit(handle, trans);
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans, TickType_t ticks)
+{
+	(void)handle;
+	(void)ticks;
+	uint32_t limit = (device.cfg.queue_size > 0 && device.cfg.queue_size < SIM_QUEUE) ?
+		device.cfg.queue_size : SIM_QUEUE;
+	if (queue_tail - queue_head >= limit) return ESP_ERR_TIMEOUT;
+	queue[queue_tail++ % SIM_QUEUE] = trans;
+	return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans, TickType_t ticks)
+{
+	(void)handle;
+	(void)ticks;
+	if (queue_head == queue_tail) return ESP_ERR_TIMEOUT;
+	*trans = queue[queue_head++ % SIM_QUEUE];
+	// Data is read when the transfer completes, not when it is queued.
+	panel_transfer(*trans);
+	return ESP_OK;
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+	(void)caps;
+	return malloc(size);
+}
+
+void heap_caps_free(void *ptr)
+{
+	free(ptr);
+}
+
+int64_t esp_timer_get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+	(void)ticks;
+}
+
+void taskYIELD(void)
+{
+	sched_yield();
+}
+
+//----------------------------------------------------------------------------//
+// FreeRTOS tasks and semaphores
+//----------------------------------------------------------------------------//
+
+struct sim_sem {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	UBaseType_t count, max;
+};
+
+typedef struct {
+	TaskFunction_t fn;
+	void *arg;
+} task_start_t;
+
+static void *task_main(void *p)
+{
+	task_start_t start = *(task_start_t *)p;
+	free(p);
+	start.fn(start.arg);
+	return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+	uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *handle, BaseType_t core)
+{
+	(void)name;
+	(void)stack;
+	(void)prio;
+	(void)core;
+	pthread_t thread;
+	task_start_t *start = malloc(sizeof(*start));
+	if (start == NULL) return pdFALSE;
+	*start = (task_start_t){fn, arg};
+	if (pthread_create(&thread, NULL, task_main, start) != 0) {
+		free(start);
+		return pdFALSE;
+	}
+	pthread_detach(thread);
+	if (handle != NULL) *handle = NULL;
+	return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+	assert(task == NULL);
+	pthread_exit(NULL);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+	SemaphoreHandle_t sem = malloc(sizeof(*sem));
+	if (sem == NULL) return NULL;
+	pthread_mutex_init(&sem->lock, NULL);
+	pthread_cond_init(&sem->cond, NULL);
+	sem->count = initial;
+	sem->max = max;
+	return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+	return xSemaphoreCreateCounting(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+	return xSemaphoreCreateCounting(1, 1);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+	BaseType_t ret = pdFALSE;
+	pthread_mutex_lock(&sem->lock);
+	if (sem->count < sem->max) {
+		sem->count++;
+		pthread_cond_signal(&sem->cond);
+		ret = pdTRUE;
+	}
+	pthread_mutex_unlock(&sem->lock);
+	return ret;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+	(void)ticks;
+	pthread_mutex_lock(&sem->lock);
+	while (sem->count == 0) pthread_cond_wait(&sem->cond, &sem->lock);
+	sem->count--;
+	pthread_mutex_unlock(&sem->lock);
+	return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+	pthread_cond_destroy(&sem->cond);
+	pthread_mutex_destroy(&sem->lock);
+	free(sem);
+}
+
+//----------------------------------------------------------------------------//
+// Public functions
+//----------------------------------------------------------------------------//
+
+void lcd_sim_get_stats(lcd_sim_stats_t *s)
+{
+	*s = stats;
+}
+
+void lcd_sim_reset_stats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+	write_count = 0;
+}
+
+uint32_t lcd_sim_get_writes(lcd_sim_write_t *log, uint32_t max)
+{
+	uint32_t n = (write_count < SIM_WRITES) ? write_count : SIM_WRITES;
+	if (n > max) n = max;
+	memcpy(log, writes, n*sizeof(*log));
+	return write_count;
+}
+
+void lcd_sim_set_trans_ns(uint32_t ns)
+{
+	trans_ns = ns;
+}
+
+color_t lcd_sim_get_pixel(coord_t x, coord_t y)
+{
+	uint16_t r, k;
+
+	if (x < 0 || x >= HW_LCD_W || y < 0 || y >= HW_LCD_H) return 0;
+	if (!gram_addr(x+HW_LCD_OFFSETX, y+HW_LCD_OFFSETY, &r, &k)) return 0;
+	// The scroll area shows memory rows starting at the start address.
+	if (scroll_on && vsa && r >= tfa && r < tfa+vsa) {
+		r = tfa + (r-tfa + ssa-tfa + vsa) % vsa;
+	}
+	return gram[r][k];
+}
+
+bool lcd_sim_write_ppm(const char *path)
+{
+	FILE *f = fopen(path, "wb");
+	if (f == NULL) return false;
+	fprintf(f, "P6\n%d %d\n255\n", HW_LCD_W, HW_LCD_H);
+	for (coord_t y = 0; y < HW_LCD_H; y++) {
+		for (coord_t x = 0; x < HW_LCD_W; x++) {
+			color_t c = lcd_sim_get_pixel(x, y);
+			uint8_t rgb[3] = {
+				((c >> 11) & 0x1F) * 255 / 0x1F,
+				((c >> 5) & 0x3F) * 255 / 0x3F,
+				(c & 0x1F) * 255 / 0x1F,
+			};
+			fwrite(rgb, 1, sizeof(rgb), f);
+		}
+	}
+	return fclose(f) == 0;
+}
@@ -0,0 +1,79 @@
+#ifndef LCD_SIM_H_
+#define LCD_SIM_H_
+/**
+ * @file
+ * @brief Simulated display for host (Linux) builds of the LCD component.
+ * @details Stands in for the ESP-IDF SPI master and GPIO drivers. Bytes
+ * sent to the display are decoded by a model of the ILI9341/ST7789
+ * command set (CASET, RASET, RAMWR, RAMWRC, MADCTL, VSCRDEF, VSCRSADD)
+ * into a virtual panel memory. Traffic is counted and the bus time is
+ * estimated from the SPI clock the device was added with.
+ *
+ * Queued transactions reach the panel when their result is collected,
+ * so a buffer reused before the transfer completed shows up as corrupt
+ * pixels, the same as on the board.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lcd.h"
+
+/** @brief Traffic seen by the simulated display. */
+typedef struct {
+	uint32_t transactions; /**< SPI transactions. */
+	uint32_t commands;     /**< Command bytes. */
+	uint32_t windows;      /**< Column or page address sets. */
+	uint64_t data_bytes;   /**< Data bytes, including command parameters. */
+	uint64_t pixels;       /**< Pixels written to panel memory. */
+	uint64_t bus_ns;       /**< Estimated bus time in nanoseconds. */
+} lcd_sim_stats_t;
+
+/** @brief One memory write (RAMWR) as seen by the simulated display. */
+typedef struct {
+	coord_t x0, y0; /**< Top left corner of the address window. */
+	coord_t x1, y1; /**< Bottom right corner, inclusive. */
+	uint32_t pixels; /**< Pixels written, including any RAMWRC that followed. */
+} lcd_sim_write_t;
+
+/**
+ * @brief Get the traffic counters.
+ * @param stats Destination for the counters.
+ */
+void lcd_sim_get_stats(lcd_sim_stats_t *stats);
+
+/**
+ * @brief Clear the traffic counters and the memory write log.
+ */
+void lcd_sim_reset_stats(void);
+
+/**
+ * @brief Get the memory writes since the last lcd_sim_reset_stats().
+ * @details Windows are in screen coordinates. Up to 256 writes are kept.
+ * @param log Destination for the writes.
+ * @param max Most entries to copy.
+ * @returns Number of writes, which may be more than were copied.
+ */
+uint32_t lcd_sim_get_writes(lcd_sim_write_t *log, uint32_t max);
+
+/**
+ * @brief Set the fixed cost added to the bus time of every transaction.
+ * @param ns Nanoseconds per transaction for driver setup and DC switching.
+ */
+void lcd_sim_set_trans_ns(uint32_t ns);
+
+/**
+ * @brief Get a pixel as it is shown on the screen.
+ * @param x X coordinate.
+ * @param y Y coordinate.
+ * @returns Color value, 0 if off screen.
+ */
+color_t lcd_sim_get_pixel(coord_t x, coord_t y);
+
+/**
+ * @brief Save the screen as a binary PPM (P6) image.
+ * @param path File name.
+ * @returns False if the file could not be written.
+ */
+bool lcd_sim_write_ppm(const char *path);
+
+#endif // LCD_SIM_H_
@@ -2,6 +2,7 @@
 #include <stdlib.h> // abs
 #include <stdbool.h>
 
+#include "fixmath.h"
 #include "joy.h"
 #include "nav.h"
 #include "config.h"
@@ -15,9 +16,9 @@
 #define CLIP(x,lo,hi) ((x) < (lo) ? (lo) : ((x) > (hi) ? (hi) : (x)))
 
 static uint32_t uperiod; // Update period in milliseconds.
-static float sfactor; // Joystick sensitivity factor.
+static int64_t sfactor; // Joystick sensitivity factor in Q32.32.
 static uint32_t thresh; // Joystick displacement threshold.
-static float rloc, cloc; // Current navigator location as a float.
+static q16_t rloc, cloc; // Current navigator location in Q16.16.
 
 
 // Initialize the navigator. Must be called before use.
@@ -33,8 +34,8 @@ int32_t nav_init(uint32_t per)
 	nav_set_sensitivity(SEN_DEFAULT);
 	nav_set_threshold(THRESH_DEFAULT);
 	// Initialize the navigator location to the center of the grid.
-	rloc = GRID_R/2;
-	cloc = GRID_C/2;
+	rloc = q16_from_int(GRID_R/2);
+	cloc = q16_from_int(GRID_C/2);
 	return 0;
 }
 
@@ -49,8 +50,8 @@ void nav_tick(void)
 	// Get joystick position relative to the center in raw ADC values.
 	joy_get_displacement(&dcx, &dcy);
 	if (abs(dcx) < thresh && abs(dcy) < thresh) {
-		rloc = (int)(rloc+0.5f);
-		cloc = (int)(cloc+0.5f);
+		rloc = q16_from_int(q16_round(rloc));
+		cloc = q16_from_int(q16_round(cloc));
 		last_move = false;
 		return;
 	}
@@ -58,19 +59,19 @@ void nav_tick(void)
 	// Based on the joystick position relative to center,
 	// calculate a new location for the navigator.
 	if (last_move) {
-		rloc += dcy*sfactor;
-		cloc += dcx*sfactor;
+		rloc += (q16_t)((dcy*sfactor + Q16_HALF) >> 16);
+		cloc += (q16_t)((dcx*sfactor + Q16_HALF) >> 16);
 	} else {
 		// Provides bump on first move.
 		if (abs(dcy) >= thresh)
-			rloc += (dcy < 0) ? -0.5f : +0.5f;
+			rloc += (dcy < 0) ? -Q16_HALF : +Q16_HALF;
 		if (abs(dcx) >= thresh)
-			cloc += (dcx < 0) ? -0.5f : +0.5f;
+			cloc += (dcx < 0) ? -Q16_HALF : +Q16_HALF;
 	}
 
 	// Clip new location to grid.
-	rloc = CLIP(rloc, 0, GRID_R-1);
-	cloc = CLIP(cloc, 0, GRID_C-1);
+	rloc = CLIP(rloc, 0, q16_from_int(GRID_R-1));
+	cloc = CLIP(cloc, 0, q16_from_int(GRID_C-1));
 
 	last_move = true;
 }
@@ -82,7 +83,9 @@ void nav_tick(void)
 void nav_set_sensitivity(float sens)
 {
 	float rate = sens*GRID_C; // Convert to cells per second
-	sfactor = rate / JOY_MAX_DISP * uperiod / 1000;
+	// Cells per tick per ADC unit is small, around 2^-13, so it is kept
+	// in Q32.32 to hold enough significant bits.
+	sfactor = (int64_t)(rate / JOY_MAX_DISP * uperiod / 1000 * 4294967296.0f + 0.5f);
 }
 
 // Set the threshold of joystick displacement needed before moving the navigator.
@@ -101,8 +104,8 @@ void nav_set_threshold(float thr)
 // *c: pointer to column grid location.
 void nav_get_loc(int8_t *r, int8_t *c)
 {
-	*r = rloc+0.5f;
-	*c = cloc+0.5f;
+	*r = q16_round(rloc);
+	*c = q16_round(cloc);
 }
 
 // Set the navigator location.
@@ -112,6 +115,6 @@ void nav_get_loc(int8_t *r, int8_t *c)
 void nav_set_loc(int8_t r, int8_t c)
 {
 	// Clip new location to grid.
-	rloc = CLIP(r, 0, GRID_R-1);
-	cloc = CLIP(c, 0, GRID_C-1);
+	rloc = q16_from_int(CLIP(r, 0, GRID_R-1));
+	cloc = q16_from_int(CLIP(c, 0, GRID_C-1));
 }
@@ -0,0 +1,540 @@
+// Host benchmark: runs the lcd_test set against the simulated display in
+// direct, frame buffer, palette and half resolution modes, plus the 2x
+// scaler, the layer compositor, the sprite engine, the tilemap fill rate,
+// tile mode rasterization on one and two cores, the draw queue and canvas
+// copies on their own. Per test it reports the timed
+// section on the host, SPI traffic over the whole test (including its frame
+// write) and the estimated bus time, as CSV or JSON. Traffic counts do not
+// depend on the host, so a baseline file gives an exact diff for changes
+// to lcd.c.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h> // getopt
+
+#include "esp_timer.h"
+#include "lcd.h"
+#include "lcd_queue.h"
+#include "lcd_sim.h"
+#include "lcd_sprite.h"
+#include "lcd_test.h"
+#include "peppers.h"
+
+#define MAX_RESULTS 128
+#define NAME_LEN 48
+#define MODE_LEN 8
+
+typedef struct {
+	char mode[MODE_LEN];
+	char name[NAME_LEN];
+	int64_t time_us;       // timed section of the test
+	uint32_t transactions; // SPI transactions
+	uint64_t bytes;        // command and data bytes
+	uint64_t pixels;       // pixels written to panel memory
+	uint64_t bus_us;       // estimated bus time
+} result_t;
+
+static result_t results[MAX_RESULTS];
+static uint32_t result_count;
+static result_t baseline[MAX_RESULTS];
+static uint32_t baseline_count;
+
+// Run every test in one mode and append the results.
+static void run_mode(const char *mode)
+{
+	const lcd_test_t *t;
+	lcd_sim_stats_t stats;
+
+	for (uint32_t i = 0; (t = lcd_test_get(i)) != NULL && result_count < MAX_RESULTS; i++) {
+		result_t *r = &results[result_count++];
+		lcd_waitFrame();
+		lcd_sim_reset_stats();
+		r->time_us = t->func();
+		lcd_waitFrame();
+		lcd_sim_get_stats(&stats);
+		snprintf(r->mode, sizeof(r->mode), "%s", mode);
+		snprintf(r->name, sizeof(r->name), "%s", t->name);
+		r->transactions = stats.transactions;
+		r->bytes = stats.commands + stats.data_bytes;
+		r->pixels = stats.pixels;
+		r->bus_us = stats.bus_ns / 1000;
+	}
+}
+
+// Time full frame writes in half resolution mode, which are mostly the 2x
+// scaling of the frame on the host, and append the result.
+#define UPSCALE_FRAMES 100
+
+static void run_upscale(void)
+{
+	lcd_sim_stats_t stats;
+
+	if (result_count >= MAX_RESULTS) return;
+	result_t *r = &results[result_count++];
+	lcd_waitFrame();
+	lcd_sim_reset_stats();
+	int64_t start = esp_timer_get_time();
+	for (uint32_t i = 0; i < UPSCALE_FRAMES; i++) {
+		lcd_markDirty(0, 0, LCD_W/2, LCD_H/2);
+		lcd_writeFrame();
+	}
+	lcd_waitFrame();
+	r->time_us = esp_timer_get_time() - start;
+	lcd_sim_get_stats(&stats);
+	snprintf(r->mode, sizeof(r->mode), "half");
+	snprintf(r->name, sizeof(r->name), "upscale_%u_frames", UPSCALE_FRAMES);
+	r->transactions = stats.transactions;
+	r->bytes = stats.commands + stats.data_bytes;
+	r->pixels = stats.pixels;
+	r->bus_us = stats.bus_ns / 1000;
+}
+
+// Move a few objects over a photo background kept in a layer, and append
+// the result. Only the regions the objects covered are composed and sent.
+#define LAYER_FRAMES 100
+#define LAYER_OBJECTS 8
+
+static void run_layers(void)
+{
+	lcd_sim_stats_t stats;
+
+	if (result_count >= MAX_RESULTS) return;
+	result_t *r = &results[result_count++];
+	lcd_drawRGBBitmap(0, 0, peppers, PEPPERS_W, PEPPERS_H);
+	lcd_layerEnable(1);
+	lcd_writeFrame();
+	lcd_waitFrame();
+	lcd_sim_reset_stats();
+	int64_t start = esp_timer_get_time();
+	lcd_layerSelect(1);
+	for (uint32_t i = 0; i < LAYER_FRAMES; i++) {
+		lcd_layerClear(1);
+		for (coord_t k = 0; k < LAYER_OBJECTS; k++) {
+			coord_t x = (k*37 + i*(k+1)) % LCD_W;
+			coord_t y = (k*29 + i*2) % LCD_H;
+			lcd_fillCircle(x, y, 6, rgb565(255, k*32, 0));
+		}
+		lcd_writeFrame();
+	}
+	lcd_waitFrame();
+	r->time_us = esp_timer_get_time() - start;
+	lcd_layerDisable();
+	lcd_sim_get_stats(&stats);
+	snprintf(r->mode, sizeof(r->mode), "layer");
+	snprintf(r->name, sizeof(r->name), "objects_%u_frames", LAYER_FRAMES);
+	r->transactions = stats.transactions;
+	r->bytes = stats.commands + stats.data_bytes;
+	r->pixels = stats.pixels;
+	r->bus_us = stats.bus_ns / 1000;
+}
+
+// Animate sprites over a photo background with the sprite engine, and
+// append the result. Only the regions the sprites covered are redrawn.
+#define SPRITE_FRAMES 100
+#define SPRITE_COUNT 32
+#define SPRITE_SIZE 16
+
+static void run_sprites(void)
+{
+	static color_t ball[2][SPRITE_SIZE*SPRITE_SIZE];
+	lcd_rle_rgb_t *frames[2];
+	int32_t id[SPRITE_COUNT];
+	lcd_sim_stats_t stats;
+
+	if (result_count >= MAX_RESULTS) return;
+	result_t *r = &results[result_count++];
+	for (coord_t f = 0; f < 2; f++) {
+		for (coord_t j = 0; j < SPRITE_SIZE; j++) {
+			for (coord_t i = 0; i < SPRITE_SIZE; i++) {
+				coord_t dx = 2*i-SPRITE_SIZE+1, dy = 2*j-SPRITE_SIZE+1;
+				bool in = dx*dx + dy*dy < SPRITE_SIZE*SPRITE_SIZE;
+				ball[f][j*SPRITE_SIZE+i] = !in ? LCD_LAYER_KEY : ((i+j+f) & 4) ? WHITE : RED;
+			}
+		}
+		frames[f] = lcd_rleEncodeRGB(ball[f], SPRITE_SIZE, SPRITE_SIZE, LCD_LAYER_KEY);
+	}
+	lcd_drawRGBBitmap(0, 0, peppers, PEPPERS_W, PEPPERS_H);
+	lcd_sprite_init();
+	lcd_sprite_background(BLACK, peppers, PEPPERS_W, PEPPERS_H);
+	for (int32_t k = 0; k < SPRITE_COUNT; k++) {
+		id[k] = lcd_sprite_add((const lcd_rle_rgb_t *const *)frames, 2, k % 3);
+	}
+	lcd_writeFrame();
+	lcd_waitFrame();
+	lcd_sim_reset_stats();
+	int64_t start = esp_timer_get_time();
+	for (uint32_t i = 0; i < SPRITE_FRAMES; i++) {
+		for (int32_t k = 0; k < SPRITE_COUNT; k++) {
+			lcd_sprite_move(id[k], (k*53 + i*(k%5+1)) % LCD_W, (k*31 + i*(k%3+1)) % LCD_H);
+			lcd_sprite_frame(id[k], i/4);
+		}
+		lcd_sprite_render();
+		lcd_writeFrame();
+	}
+	lcd_waitFrame();
+	r->time_us = esp_timer_get_time() - start;
+	lcd_sprite_init();
+	for (coord_t f = 0; f < 2; f++) lcd_rleFreeRGB(frames[f]);
+	lcd_sim_get_stats(&stats);
+	snprintf(r->mode, sizeof(r->mode), "sprite");
+	snprintf(r->name, sizeof(r->name), "sprites_%u_frames", SPRITE_FRAMES);
+	r->transactions = stats.transactions;
+	r->bytes = stats.commands + stats.data_bytes;
+	r->pixels = stats.pixels;
+	r->bus_us = stats.bus_ns / 1000;
+}
+
+#define TILEMAP_FRAMES 100
+#define TILEMAP_TILES 64
+#define TILEMAP_COLS 48
+#define TILEMAP_ROWS 32
+
+// Scroll a 16x16 tilemap diagonally, every band is rasterized each frame.
+static void run_tilemap(void)
+{
+	static color_t atlas[TILEMAP_TILES*16*16];
+	static uint8_t index[TILEMAP_COLS*TILEMAP_ROWS];
+	lcd_sim_stats_t stats;
+
+	if (result_count >= MAX_RESULTS) return;
+	result_t *r = &results[result_count++];
+	// Tiles cut from the top rows of the test image.
+	for (uint32_t t = 0; t < TILEMAP_TILES; t++) {
+		for (coord_t j = 0; j < 16; j++) {
+			memcpy(atlas + t*16*16 + j*16,
+				peppers + ((t/(PEPPERS_W/16))*16 + j)*PEPPERS_W + (t%(PEPPERS_W/16))*16,
+				16*sizeof(color_t));
+		}
+	}
+	for (uint32_t i = 0; i < TILEMAP_COLS*TILEMAP_ROWS; i++) index[i] = (i*7 + i/TILEMAP_COLS) % TILEMAP_TILES;
+	const lcd_tilemap_t map = {atlas, index, TILEMAP_COLS, TILEMAP_ROWS, 16};
+	lcd_tileMap(&map);
+	lcd_writeFrame();
+	lcd_waitFrame();
+	lcd_sim_reset_stats();
+	int64_t start = esp_timer_get_time();
+	for (uint32_t i = 0; i < TILEMAP_FRAMES; i++) {
+		lcd_tileMapScroll(i*3, i*2);
+		lcd_writeFrame();
+	}
+	lcd_waitFrame();
+	r->time_us = esp_timer_get_time() - start;
+	lcd_tileMap(NULL);
+	lcd_sim_get_stats(&stats);
+	snprintf(r->mode, sizeof(r->mode), "tile");
+	snprintf(r->name, sizeof(r->name), "tilemap_%u_frames", TILEMAP_FRAMES);
+	r->transactions = stats.transactions;
+	r->bytes = stats.commands + stats.data_bytes;
+	r->pixels = stats.pixels;
+	r->bus_us = stats.bus_ns / 1000;
+}
+
+#define RASTER_FRAMES 100
+#define RASTER_SHAPES 200
+
+// Draw many overlapping shapes per frame, so writing is bound by
+// rasterizing the command list rather than by the bus.
+static void run_raster(const char *mode)
+{
+	lcd_sim_stats_t stats;
+	uint32_t seed = 1;
+
+	if (result_count >= MAX_RESULTS) return;
+	result_t *r = &results[result_count++];
+	lcd_sim_reset_stats();
+	int64_t start = esp_timer_get_time();
+	for (uint32_t i = 0; i < RASTER_FRAMES; i++) {
+		lcd_fillScreen(BLACK);
+		for (uint32_t k = 0; k < RASTER_SHAPES; k++) {
+			seed = seed*1103515245 + 12345;
+			coord_t x = (seed >> 8) % LCD_W, y = (seed >> 16) % LCD_H;
+			color_t c = seed >> 12;
+			if (k & 1) lcd_fillRect(x-40, y-30, 80, 60, c);
+			else lcd_fillCircle(x, y, 24, c);
+		}
+		lcd_writeFrame();
+	}
+	lcd_waitFrame();
+	r->time_us = esp_timer_get_time() - start;
+	lcd_sim_get_stats(&stats);
+	snprintf(r->mode, sizeof(r->mode), "%s", mode);
+	snprintf(r->name, sizeof(r->name), "raster_%u_frames", RASTER_FRAMES);
+	r->transactions = stats.transactions;
+	r->bytes = stats.commands + stats.data_bytes;
+	r->pixels = stats.pixels;
+	r->bus_us = stats.bus_ns / 1000;
+}
+
+#define CANVAS_FRAMES 100
+#define CANVAS_SIZE 160
+
+// Draw a watch face into a canvas once, then copy it and draw a moving
+// hand over it every frame.
+static void run_canvas(void)
+{
+	lcd_sim_stats_t stats;
+	coord_t c = CANVAS_SIZE/2;
+
+	if (result_count >= MAX_RESULTS) return;
+	result_t *r = &results[result_count++];
+	lcd_canvas_t *face = lcd_canvasCreate(CANVAS_SIZE, CANVAS_SIZE);
+	if (face == NULL) return;
+	lcd_canvasSelect(face);
+	lcd_fillCircle(c, c, c-1, BLUE);
+	// Hour ticks are the ends of rotated bars left outside the dial.
+	for (angle_t a = 0; a < 180; a += 30) lcd_drawRectC(c, c, 2, 2*c-8, a, WHITE);
+	lcd_fillCircle(c, c, c-14, GRAY);
+	lcd_drawCircle(c, c, c-1, WHITE);
+	lcd_drawString(c-12, c+24, "LCD", YELLOW);
+	lcd_canvasSelect(NULL);
+	lcd_fillScreen(BLACK);
+	lcd_writeFrame();
+	lcd_waitFrame();
+	lcd_sim_reset_stats();
+	int64_t start = esp_timer_get_time();
+	for (uint32_t i = 0; i < CANVAS_FRAMES; i++) {
+		coord_t x = (LCD_W-CANVAS_SIZE)/2, y = (LCD_H-CANVAS_SIZE)/2;
+		lcd_canvasDraw(face, x, y);
+		lcd_drawRectC(x+c, y+c, 2, 2*(c-20), i*6, RED);
+		lcd_writeFrame();
+	}
+	lcd_waitFrame();
+	r->time_us = esp_timer_get_time() - start;
+	lcd_canvasDelete(face);
+	lcd_sim_get_stats(&stats);
+	snprintf(r->mode, sizeof(r->mode), "canvas");
+	snprintf(r->name, sizeof(r->name), "canvas_%u_frames", CANVAS_FRAMES);
+	r->transactions = stats.transactions;
+	r->bytes = stats.commands + stats.data_bytes;
+	r->pixels = stats.pixels;
+	r->bus_us = stats.bus_ns / 1000;
+}
+
+#define QUEUE_FRAMES 100
+#define QUEUE_SHAPES 100
+#define QUEUE_SLOTS 128
+
+// Post shapes through the draw queue, one frame at a time. Run before
+// lcd_queue_start() it measures the synchronous fallback.
+static void run_queue(const char *mode)
+{
+	lcd_sim_stats_t stats;
+	uint32_t seed = 1;
+
+	if (result_count >= MAX_RESULTS) return;
+	result_t *r = &results[result_count++];
+	lcd_sim_reset_stats();
+	int64_t start = esp_timer_get_time();
+	for (uint32_t i = 0; i < QUEUE_FRAMES; i++) {
+		lcd_queue_fillScreen(BLACK);
+		for (uint32_t k = 0; k < QUEUE_SHAPES; k++) {
+			seed = seed*1103515245 + 12345;
+			coord_t x = (seed >> 8) % LCD_W, y = (seed >> 16) % LCD_H;
+			color_t c = seed >> 12;
+			if (k & 1) lcd_queue_fillRect(x-20, y-15, 40, 30, c);
+			else lcd_queue_fillCircle(x, y, 12, c);
+		}
+		lcd_queue_drawString(0, 0, "queue", WHITE);
+		lcd_queue_sync();
+	}
+	lcd_waitFrame();
+	r->time_us = esp_timer_get_time() - start;
+	lcd_sim_get_stats(&stats);
+	snprintf(r->mode, sizeof(r->mode), "%s", mode);
+	snprintf(r->name, sizeof(r->name), "queue_%u_frames", QUEUE_FRAMES);
+	r->transactions = stats.transactions;
+	r->bytes = stats.commands + stats.data_bytes;
+	r->pixels = stats.pixels;
+	r->bus_us = stats.bus_ns / 1000;
+}
+
+static void write_csv(FILE *f)
+{
+	fprintf(f, "mode,test,time_us,transactions,bytes,pixels,bus_us\n");
+	for (uint32_t i = 0; i < result_count; i++) {
+		const result_t *r = &results[i];
+		fprintf(f, "%s,%s,%"PRIi64",%"PRIu32",%"PRIu64",%"PRIu64",%"PRIu64"\n",
+			r->mode, r->name, r->time_us, r->transactions, r->bytes, r->pixels, r->bus_us);
+	}
+}
+
+static void write_json(FILE *f)
+{
+	fprintf(f, "[\n");
+	for (uint32_t i = 0; i < result_count; i++) {
+		const result_t *r = &results[i];
+		fprintf(f, "  {\"mode\": \"%s\", \"test\": \"%s\", \"time_us\": %"PRIi64
+			", \"transactions\": %"PRIu32", \"bytes\": %"PRIu64
+			", \"pixels\": %"PRIu64", \"bus_us\": %"PRIu64"}%s\n",
+			r->mode, r->name, r->time_us, r->transactions, r->bytes, r->pixels,
+			r->bus_us, (i+1 < result_count) ? "," : "");
+	}
+	fprintf(f, "]\n");
+}
+
+// Load a CSV file written by write_csv(). Returns false if it can't be read.
+static bool read_baseline(const char *path)
+{
+	char line[256];
+	FILE *f = fopen(path, "r");
+
+	if (f == NULL) return false;
+	while (fgets(line, sizeof(line), f) != NULL && baseline_count < MAX_RESULTS) {
+		result_t *r = &baseline[baseline_count];
+		if (sscanf(line, "%7[^,],%47[^,],%"SCNi64",%"SCNu32",%"SCNu64",%"SCNu64",%"SCNu64,
+			r->mode, r->name, &r->time_us, &r->transactions, &r->bytes,
+			&r->pixels, &r->bus_us) == 7) {
+			baseline_count++;
+		}
+	}
+	fclose(f);
+	return true;
+}
+
+static const result_t *find_baseline(const result_t *r)
+{
+	for (uint32_t i = 0; i < baseline_count; i++) {
+		if (!strcmp(baseline[i].mode, r->mode) && !strcmp(baseline[i].name, r->name)) {
+			return &baseline[i];
+		}
+	}
+	return NULL;
+}
+
+static double change(uint64_t base, uint64_t now)
+{
+	return base ? 100.0*((double)now-(double)base)/(double)base : 0.0;
+}
+
+// Print the tests whose traffic differs from the baseline, then the totals.
+// Returns the change of the total bus time in percent.
+static double report_diff(FILE *f)
+{
+	uint64_t base_bus = 0, now_bus = 0, base_trans = 0, now_trans = 0;
+
+	fprintf(f, "%-6s %-30s %17s %21s %17s\n", "mode", "test",
+		"transactions", "bytes", "bus_us");
+	for (uint32_t i = 0; i < result_count; i++) {
+		const result_t *r = &results[i];
+		const result_t *b = find_baseline(r);
+		if (b == NULL) {
+			fprintf(f, "%-6s %-30s (not in baseline)\n", r->mode, r->name);
+			continue;
+		}
+		base_bus += b->bus_us; now_bus += r->bus_us;
+		base_trans += b->transactions; now_trans += r->transactions;
+		if (b->transactions == r->transactions && b->bytes == r->bytes) continue;
+		fprintf(f, "%-6s %-30s %8"PRIu32" %+7.1f%% %12"PRIu64" %+7.1f%% %8"PRIu64" %+7.1f%%\n",
+			r->mode, r->name,
+			r->transactions, change(b->transactions, r->transactions),
+			r->bytes, change(b->bytes, r->bytes),
+			r->bus_us, change(b->bus_us, r->bus_us));
+	}
+	fprintf(f, "total transactions %"PRIu64" -> %"PRIu64" (%+.1f%%), bus_us %"PRIu64" -> %"PRIu64" (%+.1f%%)\n",
+		base_trans, now_trans, change(base_trans, now_trans),
+		base_bus, now_bus, change(base_bus, now_bus));
+	return change(base_bus, now_bus);
+}
+
+// Print the library's own counters for the whole run by primitive group.
+static void report_prims(FILE *f)
+{
+	lcd_stats_t stats;
+
+	lcd_getStats(&stats);
+	fprintf(f, "%-14s %8s %12s %8s %6s %10s %12s %10s %10s\n", "primitive", "calls",
+		"transactions", "windows", "skips", "cmd_bytes", "data_bytes", "pixels", "wait_us");
+	for (int i = 0; i <= LCD_STAT_COUNT; i++) {
+		const lcd_stat_counts_t *c = (i < LCD_STAT_COUNT) ? &stats.prim[i] : &stats.total;
+		if (c->calls == 0 && c->transactions == 0) continue;
+		fprintf(f, "%-14s %8"PRIu32" %12"PRIu32" %8"PRIu32" %6"PRIu32" %10"PRIu64" %12"PRIu64" %10"PRIu64" %10"PRIu64"\n",
+			(i < LCD_STAT_COUNT) ? lcd_statName(i) : "total",
+			c->calls, c->transactions, c->windows, c->window_skips,
+			c->cmd_bytes, c->data_bytes, c->pixels, c->wait_us);
+	}
+	fprintf(f, "frames %"PRIu32"\n", stats.frames);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-j] [-p] [-o file] [-b baseline.csv] [-t percent]\n"
+		"  -j  write JSON instead of CSV\n"
+		"  -p  print traffic by primitive to stderr\n"
+		"  -o  write results to file instead of stdout\n"
+		"  -b  compare with a CSV baseline, differences go to stderr\n"
+		"  -t  fail if total bus time grows more than percent over baseline\n",
+		prog);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *out_path = NULL, *base_path = NULL;
+	bool json = false, prims = false;
+	double threshold = -1.0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "jpo:b:t:h")) != -1) {
+		switch (opt) {
+			case 'j': json = true; break;
+			case 'p': prims = true; break;
+			case 'o': out_path = optarg; break;
+			case 'b': base_path = optarg; break;
+			case 't': threshold = atof(optarg); break;
+			default: usage(argv[0]); return 2;
+		}
+	}
+
+	lcd_init();
+	lcd_setDirtyPolicy(8, 256);
+	lcd_resetStats();
+	run_mode("direct");
+	run_queue("qsync");
+	lcd_queue_start(QUEUE_SLOTS, 5, 1);
+	run_queue("queue");
+	lcd_queue_stop();
+	lcd_frameEnable();
+	run_mode("frame");
+	run_layers();
+	run_sprites();
+	run_canvas();
+	lcd_frameDisable();
+	lcd_paletteEnable(NULL, 0);
+	run_mode("palette");
+	lcd_paletteDisable();
+	lcd_frameHalfEnable();
+	run_mode("half");
+	run_upscale();
+	lcd_frameHalfDisable();
+	lcd_tileEnable(0, 0);
+	run_tilemap();
+	lcd_tileDisable();
+	lcd_tileEnable(64*1024, 0);
+	run_raster("tile");
+	lcd_tileParallelEnable();
+	run_raster("tpar");
+	lcd_tileDisable();
+	if (prims) report_prims(stderr);
+
+	FILE *out = stdout;
+	if (out_path != NULL && (out = fopen(out_path, "w")) == NULL) {
+		perror(out_path);
+		return 2;
+	}
+	if (json) write_json(out);
+	else write_csv(out);
+	if (out != stdout) fclose(out);
+
+	if (base_path != NULL) {
+		if (!read_baseline(base_path)) {
+			perror(base_path);
+			return 2;
+		}
+		double bus = report_diff(stderr);
+		if (threshold >= 0.0 && bus > threshold) return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef CHECK_H_
+#define CHECK_H_
+// Checks for the host tests. Each test file keeps a failure count named
+// failures and returns CHECK_EXIT() from main.
+
+#include <stdio.h>
+
+// Count a failure and report where it happened.
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+// Compare two integer values and report both on a mismatch.
+#define CHECK_EQ(a, b) do { \
+	long long _a = (long long)(a), _b = (long long)(b); \
+	if (_a != _b) { \
+		fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", \
+			__FILE__, __LINE__, #a, #b, _a, _b); \
+		failures++; \
+	} \
+} while (0)
+
+// Print the result and give the process exit status.
+#define CHECK_EXIT() \
+	(printf("%s: %s\n", __FILE__, failures ? "FAIL" : "ok"), failures ? 1 : 0)
+
+#endif // CHECK_H_
@@ -0,0 +1,249 @@
+// Canvases: a scene drawn on a canvas and copied to the screen must match
+// the scene drawn on the screen in every mode, tasks must be able to draw
+// on their own canvases at once, and mode and frame functions must refuse
+// to run while a canvas is selected.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "lcd.h"
+#include "lcd_sim.h"
+#include "check.h"
+
+#define CW 100
+#define CH 80
+#define TASKS 3
+#define RUNS 200
+
+static uint32_t failures;
+static color_t img[LCD_W*LCD_H];
+
+// Scene through the drawing functions, on the selected target.
+static void scene(coord_t ox, coord_t oy)
+{
+	lcd_fillRect(ox+5, oy+5, 50, 20, RED);
+	lcd_fillCircle(ox+60, oy+40, 25, GREEN);
+	lcd_drawLine(ox, oy, ox+99, oy+79, WHITE);
+	lcd_setFontBackground(BLUE);
+	lcd_setFontSize(2);
+	lcd_drawString(ox+2, oy+60, "Hi!", YELLOW);
+	lcd_noFontBackground();
+	lcd_setFontSize(1);
+	lcd_drawString(ox+50, oy+2, "ab", CYAN);
+	lcd_fillArrow(ox+90, oy+70, ox+70, oy+50, 4, MAGENTA);
+	lcd_drawRoundRect2(ox+30, oy+30, ox+45, oy+50, 4, BLUE);
+	lcd_drawChar(ox+80, oy+10, 'z', WHITE);
+}
+
+// The same scene through the lcd_canvas_ functions.
+static void scene_on(lcd_canvas_t *c, coord_t ox, coord_t oy)
+{
+	lcd_canvas_fillRect(c, ox+5, oy+5, 50, 20, RED);
+	lcd_canvas_fillCircle(c, ox+60, oy+40, 25, GREEN);
+	lcd_canvas_drawLine(c, ox, oy, ox+99, oy+79, WHITE);
+	lcd_canvas_setFontBackground(c, BLUE);
+	lcd_canvas_setFontSize(c, 2);
+	lcd_canvas_drawString(c, ox+2, oy+60, "Hi!", YELLOW);
+	lcd_canvas_noFontBackground(c);
+	lcd_canvas_setFontSize(c, 1);
+	lcd_canvas_drawString(c, ox+50, oy+2, "ab", CYAN);
+	lcd_canvas_fillArrow(c, ox+90, oy+70, ox+70, oy+50, 4, MAGENTA);
+	lcd_canvas_drawRoundRect2(c, ox+30, oy+30, ox+45, oy+50, 4, BLUE);
+	lcd_canvas_drawChar(c, ox+80, oy+10, 'z', WHITE);
+}
+
+static void snap(void)
+{
+	lcd_writeFrame();
+	lcd_waitFrame();
+	for (coord_t y = 0; y < LCD_H; y++)
+		for (coord_t x = 0; x < LCD_W; x++) img[y*LCD_W+x] = lcd_sim_get_pixel(x, y);
+}
+
+static uint32_t diff(void)
+{
+	uint32_t bad = 0;
+	lcd_writeFrame();
+	lcd_waitFrame();
+	for (coord_t y = 0; y < LCD_H; y++)
+		for (coord_t x = 0; x < LCD_W; x++) bad += (img[y*LCD_W+x] != lcd_sim_get_pixel(x, y));
+	return bad;
+}
+
+// Canvases copied to the screen match drawing on the screen, clipped.
+static void test_modes(void)
+{
+	static const char *modes[] = {"direct", "frame", "native", "tile", "palette"};
+
+	for (int mode = 0; mode < 5; mode++) {
+		if (mode == 1) lcd_frameEnable();
+		if (mode == 2) lcd_frameNativeEnable();
+		if (mode == 3) {lcd_frameDisable(); lcd_tileEnable(0, 0);}
+		if (mode == 4) {lcd_tileDisable(); lcd_paletteEnable(NULL, 0);}
+
+		lcd_fillScreen(MAGENTA);
+		lcd_setClip(30, 40, CW, CH);
+		lcd_fillRect(30, 40, CW, CH, BLACK);
+		scene(30, 40);
+		lcd_setClip(200, 100, 40, 30);
+		lcd_fillRect(200, 100, 40, 30, BLACK);
+		scene(180, 90);
+		lcd_setClip(10, 150, CW, CH);
+		lcd_fillRect(10, 150, CW, CH, BLACK);
+		scene(10, 150);
+		lcd_resetClip();
+		snap();
+
+		lcd_canvas_t *c = lcd_canvasCreate(CW, CH), *d = lcd_canvasCreate(40, 30);
+		lcd_canvas_t *e = lcd_canvasCreate(CW, CH);
+		CHECK(c != NULL && d != NULL && e != NULL);
+		lcd_canvasSelect(c);
+		scene(0, 0);
+		lcd_canvasSelect(d);
+		lcd_canvasDrawRect(c, 0, 0, 20, 10, 40, 30); // canvas to canvas
+		lcd_canvasSelect(NULL);
+		scene_on(e, 0, 0);
+		lcd_fillScreen(MAGENTA);
+		lcd_canvasDraw(c, 30, 40);
+		lcd_canvasDraw(d, 200, 100);
+		lcd_canvas_draw(NULL, e, 10, 150);
+		uint32_t bad = diff();
+		if (bad) fprintf(stderr, "%s: %u pixels differ\n", modes[mode], bad);
+		CHECK_EQ(bad, 0);
+		lcd_canvasDelete(c);
+		lcd_canvasDelete(d);
+		lcd_canvasDelete(e);
+	}
+	lcd_paletteDisable();
+}
+
+static SemaphoreHandle_t finished;
+static lcd_canvas_t *task_canvas[TASKS];
+
+// Draw the scene over and over at shifting places, half of the tasks by
+// selecting their canvas, the others by passing it.
+static void painter(void *arg)
+{
+	uint32_t k = (uint32_t)(uintptr_t)arg;
+	lcd_canvas_t *c = task_canvas[k];
+
+	if (k & 1) lcd_canvasSelect(c);
+	for (uint32_t i = 0; i < RUNS; i++) {
+		coord_t o = (coord_t)(i % 7) - 3;
+		if (k & 1) {
+			lcd_fillScreen(BLACK);
+			scene(o, -o);
+		} else {
+			lcd_canvas_fillScreen(c, BLACK);
+			scene_on(c, o, -o);
+		}
+	}
+	xSemaphoreGive(finished);
+	vTaskDelete(NULL);
+}
+
+// Tasks draw on their own canvases while this one draws on the screen.
+static void test_tasks(void)
+{
+	lcd_canvas_t *ref = lcd_canvasCreate(CW, CH);
+
+	lcd_frameEnable();
+	finished = xSemaphoreCreateCounting(TASKS, 0);
+	for (uint32_t k = 0; k < TASKS; k++) {
+		task_canvas[k] = lcd_canvasCreate(CW, CH);
+		xTaskCreatePinnedToCore(painter, "painter", 4096, (void *)(uintptr_t)k, 5, NULL, k & 1);
+	}
+	for (uint32_t i = 0; i < RUNS; i++) {
+		lcd_fillScreen(GRAY);
+		scene(40+i%50, 50);
+		lcd_writeFrame();
+	}
+	for (uint32_t k = 0; k < TASKS; k++) xSemaphoreTake(finished, portMAX_DELAY);
+
+	// The screen is still the target here, and the last scene is shown.
+	CHECK(lcd_getFrameBuffer() != NULL);
+	lcd_fillScreen(GRAY);
+	scene(40+(RUNS-1)%50, 50);
+	snap();
+	CHECK_EQ(diff(), 0);
+
+	// Each canvas holds its task's last scene.
+	coord_t o = (coord_t)((RUNS-1) % 7) - 3;
+	lcd_canvas_fillScreen(ref, BLACK);
+	scene_on(ref, o, -o);
+	lcd_canvasSelect(ref);
+	const color_t *want = lcd_getFrameBuffer();
+	for (uint32_t k = 0; k < TASKS; k++) {
+		lcd_canvasSelect(task_canvas[k]);
+		CHECK(memcmp(lcd_getFrameBuffer(), want, CW*CH*sizeof(color_t)) == 0);
+		lcd_canvasSelect(ref);
+		lcd_canvasDelete(task_canvas[k]);
+	}
+	lcd_canvasSelect(NULL);
+	lcd_canvasDelete(ref);
+	vSemaphoreDelete(finished);
+	lcd_frameDisable();
+}
+
+// Mode and frame functions do nothing while a canvas is selected.
+static void test_guards(void)
+{
+	lcd_canvas_t *c = lcd_canvasCreate(CW, CH);
+	lcd_sim_write_t log[1];
+
+	lcd_frameEnable();
+	lcd_fillScreen(RED);
+	lcd_writeFrame();
+	lcd_waitFrame();
+	lcd_canvasSelect(c);
+	lcd_fillScreen(GREEN);
+	color_t *pix = lcd_getFrameBuffer();
+
+	lcd_sim_reset_stats();
+	lcd_writeFrame();
+	lcd_writeFrameAsync();
+	lcd_frameDoubleEnable();
+	lcd_frameDoubleDisable();
+	lcd_layerEnable(2);
+	lcd_layerDisable();
+	lcd_scrollEnable(0, CH-1);
+	lcd_scroll(5);
+	lcd_frameHalfEnable();
+	lcd_paletteDisable();
+	lcd_frameDisable();
+	lcd_frameNativeEnable();
+	lcd_waitFrame();
+	CHECK_EQ(lcd_sim_get_writes(log, 1), 0);
+
+	// The canvas is intact and still a frame buffer target.
+	CHECK(lcd_getFrameBuffer() == pix);
+	uint32_t green = 0;
+	for (uint32_t i = 0; i < CW*CH; i++) green += (pix[i] == GREEN);
+	CHECK_EQ(green, CW*CH);
+	lcd_fillRect(0, 0, 4, 4, BLUE);
+	CHECK_EQ(pix[0], BLUE);
+
+	// The screen mode is unchanged.
+	lcd_canvasSelect(NULL);
+	color_t *fb = lcd_getFrameBuffer();
+	CHECK(fb != NULL && fb != pix);
+	lcd_writeFrame();
+	lcd_waitFrame();
+	CHECK_EQ(lcd_sim_get_pixel(0, 0), RED);
+	CHECK_EQ(lcd_sim_get_pixel(LCD_W-1, LCD_H-1), RED);
+	lcd_canvasDelete(c);
+	lcd_frameDisable();
+	CHECK(lcd_getFrameBuffer() == NULL);
+}
+
+int main(void)
+{
+	lcd_init();
+	test_modes();
+	test_tasks();
+	test_guards();
+	return CHECK_EXIT();
+}
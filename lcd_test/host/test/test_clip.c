@@ -0,0 +1,121 @@
+// Clipping: every primitive drawn with a clip rectangle must match the
+// same primitive drawn on the whole screen, masked by the rectangle.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lcd.h"
+#include "check.h"
+
+#define RUNS 9000
+#define INK 0xFFFF
+
+static uint32_t failures;
+static uint32_t seed = 2;
+static color_t ref[LCD_W*LCD_H];
+
+static int32_t rnd(int32_t lo, int32_t hi)
+{
+	seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+	return lo + (int32_t)(seed % (uint32_t)(hi-lo+1));
+}
+
+typedef void (*draw_fn)(const coord_t *a);
+
+static void line(const coord_t *a) {lcd_drawLine(a[0], a[1], a[2], a[3], INK);}
+static void triangle(const coord_t *a) {lcd_drawTriangle(a[0], a[1], a[2], a[3], a[4], a[5], INK);}
+static void fill_triangle(const coord_t *a) {lcd_fillTriangle(a[0], a[1], a[2], a[3], a[4], a[5], INK);}
+static void circle(const coord_t *a) {lcd_drawCircle(a[0], a[1], abs(a[4])%80, INK);}
+static void fill_circle(const coord_t *a) {lcd_fillCircle(a[0], a[1], abs(a[4])%80, INK);}
+static void round_rect(const coord_t *a)
+{
+	lcd_drawRoundRect(a[0], a[1], abs(a[2])%200+10, abs(a[3])%200+10, abs(a[4])%5+1, INK);
+}
+static void rect_c(const coord_t *a)
+{
+	lcd_drawRectC(a[0], a[1], abs(a[2])%200+10, abs(a[3])%200+10, a[4], INK);
+}
+static void polygon(const coord_t *a)
+{
+	lcd_drawRegularPolygonC(a[0], a[1], abs(a[2])%8+3, abs(a[3])%100, a[4], INK);
+}
+static void string(const coord_t *a)
+{
+	lcd_setFontBackground(0x1234);
+	lcd_drawString(a[0], a[1], "Hello clip", INK);
+}
+
+static const struct {
+	const char *name;
+	draw_fn fn;
+} prims[] = {
+	{"line", line},
+	{"triangle", triangle},
+	{"fillTriangle", fill_triangle},
+	{"circle", circle},
+	{"fillCircle", fill_circle},
+	{"roundRect", round_rect},
+	{"rectC", rect_c},
+	{"polygon", polygon},
+	{"string", string},
+};
+
+#define PRIMS (sizeof(prims)/sizeof(prims[0]))
+
+int main(void)
+{
+	uint32_t bad[PRIMS] = {0};
+
+	lcd_init();
+	lcd_frameEnable();
+	color_t *fb = lcd_getFrameBuffer();
+
+	for (uint32_t run = 0; run < RUNS; run++) {
+		uint32_t k = run % PRIMS;
+		coord_t a[6];
+		// Mostly near the screen, some far off it.
+		for (int i = 0; i < 6; i++)
+			a[i] = (run % 3 == 0) ? rnd(-600, 800) : rnd(-100, 400);
+		coord_t cx = rnd(-20, LCD_W-21), cy = rnd(-20, LCD_H-21);
+		coord_t cw = rnd(0, LCD_W-1), ch = rnd(0, LCD_H-1);
+
+		lcd_resetClip();
+		lcd_fillScreen(BLACK);
+		prims[k].fn(a);
+		memcpy(ref, fb, sizeof(ref));
+		lcd_fillScreen(BLACK);
+		lcd_setClip(cx, cy, cw, ch);
+		prims[k].fn(a);
+
+		for (coord_t y = 0; y < LCD_H; y++) {
+			for (coord_t x = 0; x < LCD_W; x++) {
+				bool in = x >= cx && x < cx+cw && y >= cy && y < cy+ch;
+				if (fb[y*LCD_W+x] != (in ? ref[y*LCD_W+x] : BLACK)) {
+					if (bad[k]++ == 0) {
+						fprintf(stderr, "%s %d %d %d %d %d %d clip %d %d %d %d: pixel %d,%d\n",
+							prims[k].name, a[0], a[1], a[2], a[3], a[4], a[5], cx, cy, cw, ch, x, y);
+					}
+					y = LCD_H;
+					break;
+				}
+			}
+		}
+	}
+	for (uint32_t k = 0; k < PRIMS; k++) CHECK_EQ(bad[k], 0);
+
+	// A fill covers only the clip rectangle.
+	lcd_resetClip();
+	lcd_fillScreen(BLACK);
+	lcd_setClip(10, 20, 30, 40);
+	lcd_fillScreen(INK);
+	lcd_resetClip();
+	uint32_t n = 0;
+	for (uint32_t i = 0; i < LCD_W*LCD_H; i++) n += (fb[i] == INK);
+	CHECK_EQ(n, 30*40);
+	CHECK_EQ(fb[20*LCD_W+10], INK);
+	CHECK_EQ(fb[59*LCD_W+39], INK);
+
+	lcd_frameDisable();
+	return CHECK_EXIT();
+}
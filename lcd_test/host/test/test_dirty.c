@@ -0,0 +1,133 @@
+// Dirty tracking: the simulator's memory write log must hold exactly the
+// regions changed since the last frame write.
+
+#include <stdint.h>
+
+#include "lcd.h"
+#include "lcd_sim.h"
+#include "check.h"
+
+#define LOG_MAX 64
+#define FILL BLUE
+
+static uint32_t failures;
+
+typedef struct {
+	coord_t x, y, w, h;
+} box_t;
+
+// Write a frame with a write function and check the windows sent against
+// the expected boxes, in any order.
+static void expect_writes_by(void (*write)(void), const box_t *exp, uint32_t n)
+{
+	lcd_sim_write_t log[LOG_MAX];
+
+	lcd_sim_reset_stats();
+	write();
+	lcd_waitFrame();
+	uint32_t count = lcd_sim_get_writes(log, LOG_MAX);
+	CHECK_EQ(count, n);
+	for (uint32_t i = 0; i < n; i++) {
+		bool found = false;
+		for (uint32_t k = 0; k < count && k < LOG_MAX; k++) {
+			const lcd_sim_write_t *w = &log[k];
+			if (w->x0 == exp[i].x && w->y0 == exp[i].y &&
+				w->x1 == exp[i].x+exp[i].w-1 && w->y1 == exp[i].y+exp[i].h-1) {
+				CHECK_EQ(w->pixels, (uint32_t)exp[i].w*exp[i].h);
+				found = true;
+			}
+		}
+		if (!found) {
+			fprintf(stderr, "missing write %d,%d %dx%d\n", exp[i].x, exp[i].y, exp[i].w, exp[i].h);
+			failures++;
+		}
+	}
+}
+
+static void expect_writes(const box_t *exp, uint32_t n)
+{
+	expect_writes_by(lcd_writeFrame, exp, n);
+}
+
+// Asynchronous writes send full-width row bands.
+static void expect_async(const box_t *exp, uint32_t n)
+{
+	expect_writes_by(lcd_writeFrameAsync, exp, n);
+}
+
+// The panel must show the frame buffer.
+static void expect_screen(void)
+{
+	const color_t *fb = lcd_getFrameBuffer();
+	uint32_t bad = 0;
+	for (coord_t y = 0; y < LCD_H; y++) {
+		for (coord_t x = 0; x < LCD_W; x++) {
+			if (lcd_sim_get_pixel(x, y) != fb[y*LCD_W+x]) bad++;
+		}
+	}
+	CHECK_EQ(bad, 0);
+}
+
+int main(void)
+{
+	const box_t full = {0, 0, LCD_W, LCD_H};
+	const box_t a = {10, 20, 30, 5}, b = {200, 100, 16, 16}, c = {50, 150, 10, 10};
+
+	lcd_init();
+	lcd_frameEnable();
+
+	// Off by default: writes through the pointer reach the panel.
+	lcd_fillScreen(FILL);
+	expect_writes(&full, 1);
+	lcd_getFrameBuffer()[5*LCD_W+5] = RED;
+	expect_writes(&full, 1);
+	expect_screen();
+
+	// Enabled: the first frame is sent whole, then only changes.
+	lcd_setDirtyPolicy(8, 256);
+	expect_writes(&full, 1);
+	expect_writes(NULL, 0);
+
+	lcd_fillRect(a.x, a.y, a.w, a.h, RED);
+	lcd_fillRect(b.x, b.y, b.w, b.h, GREEN);
+	expect_writes((box_t[]){a, b}, 2);
+	expect_screen();
+
+	// A fill with the same color only restores what was drawn on it.
+	lcd_fillScreen(FILL);
+	expect_writes(&full, 1); // the last fill was before tracking started
+	lcd_fillRect(a.x, a.y, a.w, a.h, RED);
+	lcd_fillRect(b.x, b.y, b.w, b.h, GREEN);
+	lcd_writeFrame();
+	lcd_fillScreen(FILL);
+	lcd_fillRect(c.x, c.y, c.w, c.h, WHITE);
+	expect_writes((box_t[]){a, b, c}, 3);
+	expect_screen();
+
+	// Writes through the pointer are sent once marked.
+	lcd_getFrameBuffer()[7*LCD_W+9] = YELLOW;
+	lcd_markDirty(9, 7, 1, 1);
+	expect_writes((box_t[]){{9, 7, 1, 1}}, 1);
+	expect_screen();
+
+	// Zero rectangles turns tracking off again.
+	lcd_setDirtyPolicy(0, 0);
+	expect_writes(&full, 1);
+	expect_writes(&full, 1);
+
+	// Double buffering turns it on, so frames are not copied whole.
+	lcd_frameDoubleEnable();
+	expect_async(&full, 1);
+	lcd_fillRect(a.x, a.y, a.w, a.h, RED);
+	expect_async((box_t[]){{0, a.y, LCD_W, a.h}}, 1);
+	expect_screen();
+	lcd_fillRect(c.x, c.y, c.w, c.h, GREEN);
+	expect_async((box_t[]){{0, c.y, LCD_W, c.h}}, 1);
+	expect_screen();
+	lcd_frameDoubleDisable();
+	expect_writes(&full, 1);
+	expect_writes(&full, 1);
+
+	lcd_frameDisable();
+	return CHECK_EXIT();
+}
@@ -0,0 +1,113 @@
+// Pixel kernels against plain loops, over every start alignment and run
+// lengths around the vector widths, with guards on both sides.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "lcd_pix.h"
+#include "check.h"
+
+#define LEN 600 // pixels in a buffer
+#define OFS 300 // start of the source runs in src
+#define RUNS 40000
+
+#define SWAP16(c) ((color_t)((c) << 8 | (c) >> 8))
+
+static uint32_t failures;
+static uint32_t seed = 1;
+
+static color_t src[2*LEN], dst[LEN], ref[LEN];
+static uint8_t idx[LEN], dst8[LEN], ref8[LEN];
+static color_t lut[256];
+
+enum {K_FILL, K_COPY, K_MOVE, K_SWAP, K_SWAP_IN, K_LOOKUP, K_DOUBLE, K_DOUBLE_SWAP,
+	K_KEY, K_KEY8, K_COUNT};
+
+static const char *names[K_COUNT] = {
+	"fill", "copy", "move", "copySwap", "copySwap in place", "lookup",
+	"double", "doubleSwap", "copyKey", "copyKey8",
+};
+
+static uint32_t rnd(void)
+{
+	seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+	return seed;
+}
+
+int main(void)
+{
+	uint32_t bad[K_COUNT] = {0};
+
+	for (int i = 0; i < 256; i++) lut[i] = (color_t)(i*0x0101 ^ 0x5AA5);
+	for (uint32_t run = 0; run < RUNS; run++) {
+		uint32_t k = run % K_COUNT;
+		size_t o = rnd() % 16, o2 = rnd() % 16;
+		// Short runs cover the scalar heads and tails, long ones the loops.
+		size_t n = rnd() % ((run/K_COUNT) % 2 ? 40 : 260);
+		color_t c = (color_t)rnd(), key = (color_t)rnd();
+		uint8_t key8 = (uint8_t)rnd();
+
+		for (size_t i = 0; i < 2*LEN; i++) src[i] = (color_t)rnd();
+		// Enough key colors to make both paths of the key copies common.
+		for (size_t i = 0; i < 2*LEN; i += 1 + rnd() % 3) src[i] = key;
+		for (size_t i = 0; i < LEN; i++) {
+			dst[i] = ref[i] = src[i];
+			idx[i] = (uint8_t)src[LEN+i];
+			if (rnd() % 3 == 0) idx[i] = key8;
+			dst8[i] = ref8[i] = (uint8_t)src[i];
+		}
+		const color_t *s = src+OFS+o2;
+
+		switch (k) {
+			case K_FILL:
+				lcd_pix_fill(dst+o, c, n);
+				for (size_t i = 0; i < n; i++) ref[o+i] = c;
+				break;
+			case K_COPY:
+				lcd_pix_copy(dst+o, s, n);
+				for (size_t i = 0; i < n; i++) ref[o+i] = s[i];
+				break;
+			case K_MOVE: {
+				// Overlapping, forward or back by up to 15 pixels.
+				size_t from = 16 + o2, to = 16 + o;
+				lcd_pix_move(dst+to, dst+from, n);
+				memmove(ref+to, ref+from, n*sizeof(color_t));
+				break;
+			}
+			case K_SWAP:
+				lcd_pix_copySwap(dst+o, s, n);
+				for (size_t i = 0; i < n; i++) ref[o+i] = SWAP16(s[i]);
+				break;
+			case K_SWAP_IN:
+				lcd_pix_copySwap(dst+o, dst+o, n);
+				for (size_t i = 0; i < n; i++) ref[o+i] = SWAP16(ref[o+i]);
+				break;
+			case K_LOOKUP:
+				lcd_pix_lookup(dst+o, idx+o2, lut, n);
+				for (size_t i = 0; i < n; i++) ref[o+i] = lut[idx[o2+i]];
+				break;
+			case K_DOUBLE:
+				lcd_pix_double(dst+o, s, n);
+				for (size_t i = 0; i < 2*n; i++) ref[o+i] = s[i/2];
+				break;
+			case K_DOUBLE_SWAP:
+				lcd_pix_doubleSwap(dst+o, s, n);
+				for (size_t i = 0; i < 2*n; i++) ref[o+i] = SWAP16(s[i/2]);
+				break;
+			case K_KEY:
+				lcd_pix_copyKey(dst+o, s, key, n);
+				for (size_t i = 0; i < n; i++) if (s[i] != key) ref[o+i] = s[i];
+				break;
+			case K_KEY8:
+				lcd_pix_copyKey8(dst8+o, idx+o2, key8, n);
+				for (size_t i = 0; i < n; i++) if (idx[o2+i] != key8) ref8[o+i] = idx[o2+i];
+				break;
+		}
+		if (memcmp(dst, ref, sizeof(dst)) || memcmp(dst8, ref8, sizeof(dst8))) {
+			if (bad[k]++ == 0)
+				fprintf(stderr, "%s: dst+%zu src+%zu n %zu\n", names[k], o, o2, n);
+		}
+	}
+	for (uint32_t k = 0; k < K_COUNT; k++) CHECK_EQ(bad[k], 0);
+	return CHECK_EXIT();
+}
@@ -0,0 +1,112 @@
+// Draw queue: tasks posting at once, before and after the render task is
+// started, and while it stops, must each get their own rows drawn, and a
+// sync must wait for the commands of the task that asked for it.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "lcd.h"
+#include "lcd_sim.h"
+#include "lcd_queue.h"
+#include "check.h"
+
+#define TASKS 4
+#define ROWS (LCD_H/TASKS) // rows drawn by each task
+#define COLS (LCD_W/8) // 8 pixel segments in a row
+#define SYNCS 50
+
+static uint32_t failures;
+static SemaphoreHandle_t finished;
+static _Atomic uint32_t full; // posts refused
+static _Atomic uint32_t marks[TASKS];
+static _Atomic uint32_t late; // syncs that returned before their mark
+
+static color_t seg_color(uint32_t task, uint32_t col)
+{
+	return (color_t)(task*1000 + col + 1);
+}
+
+static void mark(void *arg)
+{
+	atomic_fetch_add((_Atomic uint32_t *)arg, 1);
+}
+
+// Draw this task's rows in 8 pixel segments, syncing now and then.
+static void producer(void *arg)
+{
+	uint32_t k = (uint32_t)(uintptr_t)arg;
+	uint32_t n = 0;
+
+	for (uint32_t i = 0; i < ROWS*COLS; i++) {
+		coord_t x = (i % COLS)*8, y = k*ROWS + i/COLS;
+		while (!lcd_queue_drawHLine(x, y, 8, seg_color(k, i % COLS))) atomic_fetch_add(&full, 1);
+		if (i % (ROWS*COLS/SYNCS) == 0) {
+			while (!lcd_queue_call(mark, &marks[k])) atomic_fetch_add(&full, 1);
+			n++;
+			while (!lcd_queue_sync()) atomic_fetch_add(&full, 1);
+			if (atomic_load(&marks[k]) != n) atomic_fetch_add(&late, 1);
+		}
+	}
+	xSemaphoreGive(finished);
+	vTaskDelete(NULL);
+}
+
+// Optionally stop the render task half way, while the tasks still post.
+static void run_producers(bool stop)
+{
+	lcd_fillScreen(BLACK);
+	atomic_store(&late, 0);
+	for (uint32_t k = 0; k < TASKS; k++) {
+		atomic_store(&marks[k], 0);
+		xTaskCreatePinnedToCore(producer, "producer", 4096, (void *)(uintptr_t)k, 5, NULL, 0);
+	}
+	if (stop) {
+		while (atomic_load(&marks[0]) < SYNCS/2) taskYIELD();
+		lcd_queue_stop();
+	}
+	for (uint32_t k = 0; k < TASKS; k++) xSemaphoreTake(finished, portMAX_DELAY);
+	CHECK(lcd_queue_sync());
+	lcd_waitFrame();
+
+	uint32_t bad = 0;
+	for (uint32_t k = 0; k < TASKS; k++)
+		for (coord_t y = (coord_t)(k*ROWS); y < (coord_t)((k+1)*ROWS); y++)
+			for (coord_t x = 0; x < COLS*8; x++)
+				bad += (lcd_sim_get_pixel(x, y) != seg_color(k, x/8));
+	CHECK_EQ(bad, 0);
+	CHECK_EQ(atomic_load(&late), 0);
+	for (uint32_t k = 0; k < TASKS; k++) CHECK(atomic_load(&marks[k]) > 0);
+}
+
+int main(void)
+{
+	lcd_init();
+	finished = xSemaphoreCreateCounting(TASKS, 0);
+
+	// Drawn at once on each task, one at a time.
+	run_producers(false);
+
+	// Through the render task, with a queue small enough to fill.
+	for (int rep = 0; rep < 3; rep++) {
+		CHECK(lcd_queue_start(16, 5, 1));
+		run_producers(false);
+		lcd_queue_stop();
+	}
+
+	// Posts refused while stopping are retried and drawn at once.
+	for (int rep = 0; rep < 3; rep++) {
+		CHECK(lcd_queue_start(16, 5, 1));
+		run_producers(true);
+	}
+	CHECK(atomic_load(&full) > 0);
+
+	// Drawn at once again after the stop.
+	run_producers(false);
+
+	vSemaphoreDelete(finished);
+	return CHECK_EXIT();
+}
@@ -0,0 +1,176 @@
+// Command list and band rasterizer: band edges, a short last band, full
+// lists, the clear color and the changed band masks.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "lcd_tile.h"
+#include "check.h"
+
+#define W 16
+#define H 10
+#define BAND 4
+
+static uint32_t failures;
+static color_t ref[H][W];
+
+static void ref_rect(coord_t x, coord_t y, coord_t w, coord_t h, color_t c)
+{
+	for (coord_t j = y; j < y+h; j++)
+		for (coord_t i = x; i < x+w; i++) ref[j][i] = c;
+}
+
+// Rasterize every band and compare with the reference, byte swapped or not.
+static void expect_raster(const lcd_tile_list_t *l, bool swap)
+{
+	color_t tile[BAND*W];
+	uint16_t bands = lcd_tile_bands(l);
+	coord_t y = 0;
+
+	for (uint16_t b = 0; b < bands; b++) {
+		memset(tile, 0xAA, sizeof(tile));
+		coord_t rows = lcd_tile_raster(l, b, tile, swap);
+		CHECK_EQ(rows, (b == bands-1) ? H-(bands-1)*BAND : BAND);
+		for (coord_t r = 0; r < rows; r++, y++) {
+			for (coord_t x = 0; x < W; x++) {
+				color_t c = ref[y][x];
+				if (swap) c = (color_t)(c << 8 | c >> 8);
+				if (tile[r*W+x] != c) {
+					fprintf(stderr, "band %u pixel %d,%d\n", b, x, y);
+					failures++;
+					return;
+				}
+			}
+		}
+	}
+	CHECK_EQ(y, H);
+	CHECK_EQ(lcd_tile_raster(l, bands, tile, swap), 0);
+}
+
+static void test_bands(void)
+{
+	uint32_t mem[64];
+	lcd_tile_list_t l;
+	const color_t px[3] = {0x1234, 0x5678, 0x9ABC};
+
+	lcd_tile_init(&l, mem, sizeof(mem), W, H, BAND);
+	CHECK_EQ(lcd_tile_bands(&l), 3);
+
+	lcd_tile_clear(&l, 0x0841);
+	ref_rect(0, 0, W, H, 0x0841);
+	// Across the first band edge, along the last row and in the short band.
+	CHECK(lcd_tile_rect(&l, 2, BAND-1, 5, 2, 0xF800));
+	ref_rect(2, BAND-1, 5, 2, 0xF800);
+	CHECK(lcd_tile_rect(&l, 0, H-1, W, 1, 0x07E0));
+	ref_rect(0, H-1, W, 1, 0x07E0);
+	CHECK(lcd_tile_rect(&l, W-1, 2*BAND, 1, 1, 0x001F));
+	ref_rect(W-1, 2*BAND, 1, 1, 0x001F);
+	CHECK(lcd_tile_pixels(&l, 5, 2*BAND-1, 3, px));
+	memcpy(&ref[2*BAND-1][5], px, sizeof(px));
+	// A later command covers an earlier one.
+	CHECK(lcd_tile_rect(&l, 3, 0, 2, H, 0xFFFF));
+	ref_rect(3, 0, 2, H, 0xFFFF);
+
+	expect_raster(&l, false);
+	expect_raster(&l, true);
+
+	// A band height that divides the screen has no short band.
+	lcd_tile_init(&l, mem, sizeof(mem), W, 8, BAND);
+	CHECK_EQ(lcd_tile_bands(&l), 2);
+}
+
+static void test_dropped(void)
+{
+	uint32_t mem[5];
+	lcd_tile_list_t l;
+
+	lcd_tile_init(&l, mem, sizeof(mem), W, H, BAND);
+	CHECK(lcd_tile_rect(&l, 0, 0, 2, 2, 1)); // 3 words
+	CHECK(!lcd_tile_rect(&l, 0, 0, 2, 2, 2));
+	CHECK(lcd_tile_rect(&l, 0, 0, 1, 1, 3)); // 2 words, fills the list
+	CHECK(!lcd_tile_rect(&l, 1, 1, 1, 1, 4));
+	CHECK(lcd_tile_rect(&l, 0, 0, 0, 5, 5)); // empty, nothing stored
+	CHECK_EQ(l.count, 2);
+	CHECK_EQ(l.dropped, 2);
+	CHECK_EQ(l.used, 5);
+
+	lcd_tile_reset(&l);
+	CHECK_EQ(l.count, 0);
+	CHECK_EQ(l.dropped, 0);
+	CHECK_EQ(l.used, 0);
+}
+
+static void test_clear(void)
+{
+	uint32_t mem[16];
+	lcd_tile_list_t l;
+
+	lcd_tile_init(&l, mem, sizeof(mem), W, H, BAND);
+	CHECK(l.recolor);
+	lcd_tile_reset(&l);
+	CHECK(!l.recolor);
+	CHECK(!lcd_tile_changed(&l, 0));
+
+	// The same color again changes nothing.
+	lcd_tile_clear(&l, 0);
+	CHECK(!l.recolor);
+	CHECK(!lcd_tile_changed(&l, 1));
+
+	// Commands before a clear are discarded, but their band stays marked.
+	CHECK(lcd_tile_rect(&l, 0, BAND, 4, 1, 0xFFFF));
+	lcd_tile_clear(&l, 0);
+	CHECK_EQ(l.used, 0);
+	CHECK_EQ(l.count, 0);
+	CHECK(!l.recolor);
+	CHECK(lcd_tile_changed(&l, 1));
+	CHECK(!lcd_tile_changed(&l, 0));
+
+	// A new color changes every band, and is kept across frames.
+	lcd_tile_clear(&l, 0xF800);
+	CHECK(l.recolor);
+	for (uint16_t b = 0; b < lcd_tile_bands(&l); b++) CHECK(lcd_tile_changed(&l, b));
+	lcd_tile_reset(&l);
+	CHECK_EQ(l.clear, 0xF800);
+	ref_rect(0, 0, W, H, 0xF800);
+	expect_raster(&l, false);
+}
+
+static void test_masks(void)
+{
+	uint32_t mem[16];
+	lcd_tile_list_t l;
+
+	lcd_tile_init(&l, mem, sizeof(mem), W, H, BAND);
+	lcd_tile_reset(&l);
+
+	// Frame 1 draws in band 0.
+	CHECK(lcd_tile_rect(&l, 0, 1, 2, 2, 1));
+	CHECK(lcd_tile_changed(&l, 0));
+	CHECK(!lcd_tile_changed(&l, 1));
+	CHECK(!lcd_tile_changed(&l, 2));
+	lcd_tile_reset(&l);
+
+	// Frame 2 draws in band 2, band 0 still has to be cleared.
+	CHECK(lcd_tile_changed(&l, 0));
+	CHECK(lcd_tile_pixels(&l, 0, H-1, 1, (const color_t[]){2}));
+	CHECK(lcd_tile_changed(&l, 0));
+	CHECK(!lcd_tile_changed(&l, 1));
+	CHECK(lcd_tile_changed(&l, 2));
+	lcd_tile_reset(&l);
+
+	// Frame 3 draws nothing, only band 2 is left to clear.
+	CHECK(!lcd_tile_changed(&l, 0));
+	CHECK(!lcd_tile_changed(&l, 1));
+	CHECK(lcd_tile_changed(&l, 2));
+	lcd_tile_reset(&l);
+	CHECK(!lcd_tile_changed(&l, 2));
+}
+
+int main(void)
+{
+	test_bands();
+	test_dropped();
+	test_clear();
+	test_masks();
+	return CHECK_EXIT();
+}
@@ -0,0 +1,144 @@
+// Filled triangles against an edge function reference with the top-left
+// rule, on random triangles that are partly off screen.
+//
+// The rasterizer steps edges with an exact remainder, not a Q16 fraction:
+// Q16 error grows by up to 2^-16 per row, which puts pixel centers on the
+// wrong side of edges from about 256 rows tall, and the edges here reach
+// twice the screen height. Coverage differs from the old inclusive spans:
+// pixels on right and bottom edges are no longer filled, and triangles
+// with no area draw nothing.
+
+#include <stdint.h>
+
+#include "lcd.h"
+#include "lcd_sim.h"
+#include "check.h"
+
+#define MARGIN 100
+
+static uint32_t failures;
+static uint32_t seed = 1;
+
+static coord_t rnd(coord_t lo, coord_t hi)
+{
+	seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+	return lo + (coord_t)(seed % (uint32_t)(hi-lo+1));
+}
+
+// Side of (px,py) from the edge a-b, scaled by its height: positive if
+// left of it. Both sides of a horizontal edge give 0.
+static int64_t side(const coord_t *a, const coord_t *b, coord_t px, coord_t py)
+{
+	return (int64_t)(b[0]-a[0])*(py-a[1]) - (int64_t)(px-a[0])*(b[1]-a[1]);
+}
+
+// Pixel centers inside are covered, and those on an edge only if it is a
+// left or top edge.
+static bool covered(const coord_t v[3][2], coord_t px, coord_t py)
+{
+	for (int i = 0; i < 3; i++) {
+		const coord_t *a = v[i], *b = v[(i+1)%3], *c = v[(i+2)%3];
+		if (a[1] == b[1]) {
+			if (c[1] > a[1] ? py < a[1] : py >= a[1]) return false;
+			continue;
+		}
+		if (a[1] > b[1]) {const coord_t *t = a; a = b; b = t;}
+		int64_t s = side(a, b, px, py);
+		bool left = side(a, b, c[0], c[1]) < 0;
+		if (left ? s > 0 : s <= 0) return false;
+	}
+	return true;
+}
+
+// Draw one triangle over black, clipped to a box, and check every pixel
+// on the screen.
+static uint32_t check_triangle(const coord_t v[3][2], const coord_t *box, bool frame)
+{
+	const color_t *fb = lcd_getFrameBuffer();
+	uint32_t bad = 0;
+	int64_t area = side(v[0], v[1], v[2][0], v[2][1]);
+
+	lcd_fillScreen(BLACK);
+	lcd_setClip(box[0], box[1], box[2], box[3]);
+	lcd_fillTriangle(v[0][0], v[0][1], v[1][0], v[1][1], v[2][0], v[2][1], WHITE);
+	lcd_resetClip();
+	if (!frame) lcd_waitFrame();
+	for (coord_t y = 0; y < LCD_H; y++) {
+		for (coord_t x = 0; x < LCD_W; x++) {
+			color_t c = frame ? fb[y*LCD_W+x] : lcd_sim_get_pixel(x, y);
+			bool in = area != 0 && covered(v, x, y) &&
+				x >= box[0] && x < box[0]+box[2] && y >= box[1] && y < box[1]+box[3];
+			if (c != (in ? WHITE : BLACK)) bad++;
+		}
+	}
+	if (bad) {
+		fprintf(stderr, "%s: (%d,%d) (%d,%d) (%d,%d) %u pixels wrong\n",
+			frame ? "frame" : "direct", v[0][0], v[0][1], v[1][0], v[1][1], v[2][0], v[2][1], bad);
+	}
+	return bad;
+}
+
+static void test_random(uint32_t count, bool frame)
+{
+	uint32_t bad = 0;
+
+	for (uint32_t i = 0; i < count; i++) {
+		coord_t v[3][2];
+		coord_t box[4] = {0, 0, LCD_W, LCD_H};
+		for (int k = 0; k < 3; k++) {
+			v[k][0] = rnd(-MARGIN, LCD_W+MARGIN);
+			v[k][1] = rnd(-MARGIN, LCD_H+MARGIN);
+		}
+		// Some with shared rows, columns or no area.
+		if (i % 8 == 1) v[1][1] = v[0][1];
+		if (i % 8 == 2) v[2][1] = v[1][1];
+		if (i % 8 == 3) v[2][0] = v[0][0];
+		if (i % 16 == 4) {v[2][0] = 2*v[1][0]-v[0][0]; v[2][1] = 2*v[1][1]-v[0][1];}
+		if (i % 4 == 0) {
+			box[0] = rnd(0, LCD_W-1);
+			box[1] = rnd(0, LCD_H-1);
+			box[2] = rnd(1, LCD_W-box[0]);
+			box[3] = rnd(1, LCD_H-box[1]);
+		}
+		if (check_triangle((const coord_t (*)[2])v, box, frame)) bad++;
+		if (bad >= 4) break;
+	}
+	CHECK_EQ(bad, 0);
+}
+
+// Count the pixels of a color in the frame buffer.
+static uint32_t count(color_t color)
+{
+	const color_t *fb = lcd_getFrameBuffer();
+	uint32_t n = 0;
+
+	for (uint32_t i = 0; i < LCD_W*LCD_H; i++) n += (fb[i] == color);
+	return n;
+}
+
+// Triangles sharing an edge neither overlap nor leave a gap.
+static void test_shared(void)
+{
+	const coord_t q[4][2] = {{10, 10}, {200, 37}, {31, 290}, {223, 301}};
+
+	lcd_fillScreen(BLACK);
+	lcd_fillTriangle(q[0][0], q[0][1], q[1][0], q[1][1], q[2][0], q[2][1], WHITE);
+	uint32_t a = count(WHITE);
+	lcd_fillScreen(BLACK);
+	lcd_fillTriangle(q[1][0], q[1][1], q[2][0], q[2][1], q[3][0], q[3][1], WHITE);
+	uint32_t b = count(WHITE);
+	lcd_fillTriangle(q[0][0], q[0][1], q[1][0], q[1][1], q[2][0], q[2][1], WHITE);
+	CHECK_EQ(count(WHITE), a+b);
+	CHECK(a > 0 && b > 0);
+}
+
+int main(void)
+{
+	lcd_init();
+	test_random(300, false);
+	lcd_frameEnable();
+	test_random(3000, true);
+	test_shared();
+	lcd_frameDisable();
+	return CHECK_EXIT();
+}
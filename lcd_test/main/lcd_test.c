@@ -10,16 +10,47 @@
 #include "esp_timer.h" // esp_timer_get_time
 
 #include "lcd.h"
+#include "lcd_test.h"
 #include "crosshair.h"
 #include "peppers.h"
 
 // Time support
 #define TICKS_SEC 1000000LL
 #define PRINT_TIME(ticks) \
-	ESP_LOGI(__FUNCTION__, "elapsed time[us]:%"PRIi64,(ticks))
+	ESP_LOGI(__FUNCTION__, "elapsed time[us]:%"PRIi64" spi trans:%"PRIu32,(ticks),spi_trans)
+
+static uint32_t spi_trans; // SPI transactions in the last timed section
+static uint32_t spi_start; // SPI transactions before the timed section
+
+// Start a timed section once queued display traffic has drained.
+static int64_t start_time(void)
+{
+	lcd_stats_t stats;
+	lcd_waitFrame();
+	lcd_getStats(&stats);
+	spi_start = stats.total.transactions;
+	return esp_timer_get_time();
+}
+
+// End a timed section, including the time to drain queued display traffic.
+static int64_t end_time(void)
+{
+	lcd_stats_t stats;
+	lcd_waitFrame();
+	int64_t ticks = esp_timer_get_time();
+	lcd_getStats(&stats);
+	spi_trans = stats.total.transactions - spi_start;
+	return ticks;
+}
 
 #define WAIT vTaskDelay(200)
 
+// Seed for tests that draw at random positions. Host benchmarks set a
+// fixed seed so runs can be compared.
+#ifndef TEST_SEED
+#define TEST_SEED ((unsigned int)time(NULL))
+#endif
+
 #define RAND_COLOR() ((color_t)rand())
 
 static const coord_t width = LCD_W;
@@ -33,11 +64,11 @@ int64_t lcd_test_colorBar(void) {
 	x1 = width/3;
 	x2 = width*2/3;
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	lcd_fillRect( 0, 0,    x1   , height, RED);
 	lcd_fillRect(x1, 0,    x2-x1, height, GREEN);
 	lcd_fillRect(x2, 0, width-x2, height, BLUE);
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -53,13 +84,13 @@ int64_t lcd_test_colorBand(void) {
 	coord_t ypos = 0;
 	lcd_fillScreen(BLACK);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (int32_t i = 0; i < 16; i++) {
 		lcd_fillRect(0, ypos, width, delta, color);
 		color = color >> 1;
 		ypos += delta;
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -76,11 +107,11 @@ int64_t lcd_test_fillScreen(void) {
 
 	color_t ctab[] = {RED,GREEN,BLUE,BLACK,GRAY,YELLOW,CYAN,MAGENTA};
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (int32_t i = 0; i < 16; i++) {
 		lcd_fillScreen(ctab[i%8]);
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -98,14 +129,14 @@ int64_t lcd_test_drawHVLine(void) {
 	color_t color = RED;
 	lcd_fillScreen(BLACK);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (coord_t ypos=0 ; ypos < height; ypos += 10) {
 		lcd_drawHLine(0, ypos, width, color);
 	}
 	for (coord_t xpos = 0; xpos < width; xpos += 10) {
 		lcd_drawVLine(xpos, 0, height, color);
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -117,9 +148,9 @@ int64_t lcd_test_drawLine(void) {
 	int64_t startTick, endTick, diffTick;
 
 	lcd_fillScreen(BLACK);
-	srand((unsigned int)time(NULL));
+	srand(TEST_SEED);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (int32_t i = 0; i < 100; i++) {
 		coord_t x0 = rand() % width;
 		coord_t y0 = rand() % height;
@@ -127,7 +158,7 @@ int64_t lcd_test_drawLine(void) {
 		coord_t y1 = rand() % height;
 		lcd_drawLine(x0, y0, x1, y1, RAND_COLOR());
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -144,11 +175,11 @@ int64_t lcd_test_drawRect(void) {
 	limit /= 2;
 	lcd_fillScreen(BLACK);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (coord_t i = 0; i < limit; i += 5) {
 		lcd_drawRect(i, i, width-2*i, height-2*i, color);
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -160,16 +191,16 @@ int64_t lcd_test_fillRect(void) {
 	int64_t startTick, endTick, diffTick;
 
 	lcd_fillScreen(CYAN);
-	srand((unsigned int)time(NULL));
+	srand(TEST_SEED);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (int32_t i = 0; i < 100; i++) {
 		coord_t xpos = rand() % width;
 		coord_t ypos = rand() % height;
 		coord_t size = rand() % (width/5)+1;
 		lcd_fillRect(xpos, ypos, size, size, RAND_COLOR());
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -181,9 +212,9 @@ int64_t lcd_test_drawTriangle(void) {
 	int64_t startTick, endTick, diffTick;
 
 	lcd_fillScreen(BLACK);
-	srand((unsigned int)time(NULL));
+	srand(TEST_SEED);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (int32_t i = 0; i < 100; i++) {
 		coord_t x0 = rand() % width;
 		coord_t y0 = rand() % height;
@@ -193,7 +224,7 @@ int64_t lcd_test_drawTriangle(void) {
 		coord_t y2 = rand() % height;
 		lcd_drawTriangle(x0, y0, x1, y1, x2, y2, RAND_COLOR());
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -205,9 +236,9 @@ int64_t lcd_test_fillTriangle(void) {
 	int64_t startTick, endTick, diffTick;
 
 	lcd_fillScreen(CYAN);
-	srand((unsigned int)time(NULL));
+	srand(TEST_SEED);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (int32_t i = 0; i < 100; i++) {
 		coord_t x0 = rand() % width;
 		coord_t y0 = rand() % height;
@@ -217,7 +248,7 @@ int64_t lcd_test_fillTriangle(void) {
 		coord_t y2 = rand() % height;
 		lcd_fillTriangle(x0, y0, x1, y1, x2, y2, RAND_COLOR());
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -236,11 +267,11 @@ int64_t lcd_test_drawCircle(void) {
 	coord_t xpos = width/2;
 	coord_t ypos = height/2;
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (coord_t i = 5; i < limit; i += 5) {
 		lcd_drawCircle(xpos, ypos, i, color);
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -252,9 +283,9 @@ int64_t lcd_test_fillCircle(void) {
 	int64_t startTick, endTick, diffTick;
 
 	lcd_fillScreen(CYAN);
-	srand((unsigned int)time(NULL));
+	srand(TEST_SEED);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (int32_t i = 0; i < 100; i++) {
 		coord_t radius = rand() % (width/5);
 		coord_t xpos = rand() % width;
@@ -265,7 +296,7 @@ int64_t lcd_test_fillCircle(void) {
 		else if (ypos > height-1-radius) ypos = height-1-radius;
 		lcd_fillCircle(xpos, ypos, radius, RAND_COLOR());
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -282,11 +313,11 @@ int64_t lcd_test_drawRoundRect(void) {
 	limit /= 2;
 	lcd_fillScreen(BLACK);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (coord_t i = 0; i < limit; i += 5) {
 		lcd_drawRoundRect(i, i, width-2*i, height-2*i, 30, color);
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -304,11 +335,11 @@ int64_t lcd_test_fillRoundRect(void) {
 	limit /= 2;
 	lcd_fillScreen(BLACK);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (coord_t i = 0; i < limit; i += 5) {
 		lcd_fillRoundRect(i, i, width-2*i, height-2*i, 30, ctab[c++%2]);
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -324,11 +355,11 @@ int64_t lcd_test_drawArrow(void) {
 	coord_t y0 = height/2;
 	lcd_fillScreen(BLACK);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (coord_t x1 = 0; x1 < width; x1 += 20) {
 		lcd_drawArrow(x0, y0, x1, 0, 5, color);
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -357,7 +388,7 @@ int64_t lcd_test_fillArrow(void) {
 	lcd_setFontSize(fontSize);
 	lcd_setFontDirection(DIRECTION0);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	strcpy(ascii, "LCD");
 	color = WHITE;
 	ypos = ((height - fontHeight) / 2) - 1;
@@ -389,7 +420,7 @@ int64_t lcd_test_fillArrow(void) {
 	stlen = strlen(ascii);
 	xpos = (width-1) - (fontWidth*stlen);
 	lcd_drawString(xpos, ypos, ascii, color);
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -403,7 +434,7 @@ int64_t lcd_test_drawBitmap(void) {
 	color_t ctab[] = {RED,GREEN,BLUE,BLACK,GRAY,YELLOW,CYAN,MAGENTA};
 	lcd_fillScreen(rgb565(4, 16, 64));
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (coord_t y = 0; y < LCD_H; y += CROSSHAIR_H+1) {
 		coord_t x;
 		uint8_t c;
@@ -411,7 +442,7 @@ int64_t lcd_test_drawBitmap(void) {
 			lcd_drawBitmap(x, y, crosshair, CROSSHAIR_W, CROSSHAIR_H, ctab[c%8]);
 		}
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -423,7 +454,7 @@ int64_t lcd_test_drawRGBBitmap(void) {
 	int64_t startTick, endTick, diffTick;
 	coord_t x = 0, y = 0;
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (; y < 10; y++)
 		lcd_drawRGBBitmap(x, y, peppers, PEPPERS_W, PEPPERS_H);
 	for (; x < 10; x++)
@@ -432,7 +463,7 @@ int64_t lcd_test_drawRGBBitmap(void) {
 		lcd_drawRGBBitmap(x, y, peppers, PEPPERS_W, PEPPERS_H);
 	for (; x > 0; x--)
 		lcd_drawRGBBitmap(x, y, peppers, PEPPERS_W, PEPPERS_H);
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -448,9 +479,9 @@ int64_t lcd_test_drawRect2(void) {
 	int64_t startTick, endTick, diffTick;
 
 	lcd_fillScreen(BLACK);
-	srand((unsigned int)time(NULL));
+	srand(TEST_SEED);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (int32_t i = 0; i < 100; i++) {
 		coord_t x0 = rand() % width;
 		coord_t y0 = rand() % height;
@@ -458,7 +489,7 @@ int64_t lcd_test_drawRect2(void) {
 		coord_t y1 = rand() % height;
 		lcd_drawRect2(x0, y0, x1, y1, RAND_COLOR());
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -470,9 +501,9 @@ int64_t lcd_test_fillRect2(void) {
 	int64_t startTick, endTick, diffTick;
 
 	lcd_fillScreen(CYAN);
-	srand((unsigned int)time(NULL));
+	srand(TEST_SEED);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (int32_t i = 0; i < 100; i++) {
 		coord_t x0 = rand() % width;
 		coord_t y0 = rand() % height;
@@ -480,7 +511,7 @@ int64_t lcd_test_fillRect2(void) {
 		coord_t y1 = rand() % height;
 		lcd_fillRect2(x0, y0, x1, y1, RAND_COLOR());
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -497,11 +528,11 @@ int64_t lcd_test_drawRoundRect2(void) {
 	limit /= 2;
 	lcd_fillScreen(BLACK);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (coord_t i = 0; i < limit; i += 5) {
 		lcd_drawRoundRect2(i, i, width-i-1, height-i-1, 20, color);
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -519,11 +550,11 @@ int64_t lcd_test_fillRoundRect2(void) {
 	limit /= 2;
 	lcd_fillScreen(BLACK);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (coord_t i = 0; i < limit; i += 5) {
 		lcd_fillRoundRect2(i, i, width-i-1, height-i-1, 20, ctab[c++%2]);
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -546,7 +577,7 @@ int64_t lcd_test_drawRectC(void) {
 	coord_t w = h * 0.5;
 	angle_t angle;
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (angle = 0; angle < (360*3); angle += 30) {
 		lcd_drawRectC(xpos, ypos, w, h, angle, color);
 		lcd_drawRectC(xpos, ypos, w, h, angle, BLACK);
@@ -554,7 +585,7 @@ int64_t lcd_test_drawRectC(void) {
 	for (angle = 0; angle < 180; angle += 30) {
 		lcd_drawRectC(xpos, ypos, w, h, angle, color);
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -573,7 +604,7 @@ int64_t lcd_test_drawTriangleC(void) {
 	coord_t w = h * 0.7;
 	angle_t angle;
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (angle = 0; angle < (360*3); angle += 30) {
 		lcd_drawTriangleC(xpos, ypos, w, h, angle, color);
 		lcd_drawTriangleC(xpos, ypos, w, h, angle, BLACK);
@@ -581,7 +612,7 @@ int64_t lcd_test_drawTriangleC(void) {
 	for (angle = 0; angle < 360; angle += 30) {
 		lcd_drawTriangleC(xpos, ypos, w, h, angle, color);
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -600,14 +631,14 @@ int64_t lcd_test_drawRegularPolygonC(void) {
 	limit /= 2;
 	lcd_fillScreen(BLACK);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (coord_t n = 3; ; n++) {
 		coord_t radius = n*15-35;
 		angle_t angle = n*10;
 		if (radius >= limit) break;
 		lcd_drawRegularPolygonC(xpos, ypos, n, radius, angle, color);
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -631,9 +662,9 @@ int64_t lcd_test_drawString(void) {
 	char text[] = "Carpe Diem!";
 	size_t tlen = strlen(text);
 	color_t bgtab[] = {RED,GREEN,BLUE,BLACK,GRAY,YELLOW,CYAN,MAGENTA};
-	srand((unsigned int)time(NULL));
+	srand(TEST_SEED);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (int32_t i = 0; i < 100; i++) {
 		size = (i&0x3)+1;
 		coord_t xpos = rand() % (width-LCD_CHAR_W*size*tlen+1);
@@ -642,7 +673,7 @@ int64_t lcd_test_drawString(void) {
 		lcd_setFontBackground(bgtab[i%8]);
 		lcd_drawString(xpos, ypos, text, RAND_COLOR());
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -666,7 +697,7 @@ int64_t lcd_test_setFontDirection(void) {
 	lcd_fillScreen(BLACK);
 	lcd_setFontSize(fontSize);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	color = RED;
 	strcpy(ascii, "Direction=0");
 	lcd_setFontDirection(DIRECTION0);
@@ -688,7 +719,7 @@ int64_t lcd_test_setFontDirection(void) {
 	lcd_setFontDirection(DIRECTION270);
 	lcd_drawString(0, height-1, ascii, color);
 #endif
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -706,7 +737,7 @@ int64_t lcd_test_setFontSize(void) {
 	lcd_fillScreen(BLACK);
 	lcd_setFontDirection(DIRECTION0);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (xpos = 0, ypos = 0, i = 1; ; xpos += 5, ypos += LCD_CHAR_H*i, i++) {
 		lcd_setFontSize(i);
 		lcd_setFontBackground(ctab[(i+1)%9]);
@@ -714,7 +745,7 @@ int64_t lcd_test_setFontSize(void) {
 		if (strlen(ascii)*LCD_CHAR_W*i+xpos > LCD_W) break;
 		lcd_drawString(xpos, ypos, ascii, ctab[i%9]);
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_noFontBackground();
 	lcd_writeFrame();
@@ -752,7 +783,7 @@ int64_t lcd_test_wrapAround(void) {
 	if (lcd_getFrameBuffer() == NULL) return 0;
 	lcd_drawRGBBitmap(0, 0, peppers, PEPPERS_W, PEPPERS_H);
 
-	startTick = esp_timer_get_time();
+	startTick = start_time();
 	for (coord_t i = 0; i < width/8; i++) {
 		lcd_wrapAround(SCROLL_RIGHT, height/4, height/4*3-1); lcd_writeFrame();
 	}
@@ -765,7 +796,7 @@ int64_t lcd_test_wrapAround(void) {
 	for (coord_t i = 0; i < height/8; i++) {
 		lcd_wrapAround(SCROLL_UP, width/4, width/4*3-1); lcd_writeFrame();
 	}
-	endTick = esp_timer_get_time();
+	endTick = end_time();
 
 	lcd_writeFrame();
 	diffTick = endTick - startTick;
@@ -779,38 +810,53 @@ int64_t lcd_test_wrapAround(void) {
 // Test all
 //----------------------------------------------------------------------------//
 
+#define TEST(name) {#name, name}
+
+static const lcd_test_t tests[] = {
+	TEST(lcd_test_colorBar),
+	TEST(lcd_test_colorBand),
+	TEST(lcd_test_fillScreen),
+	TEST(lcd_test_drawHVLine),
+	TEST(lcd_test_drawLine),
+	TEST(lcd_test_drawRect),
+	TEST(lcd_test_fillRect),
+	TEST(lcd_test_drawTriangle),
+	TEST(lcd_test_fillTriangle),
+	TEST(lcd_test_drawCircle),
+	TEST(lcd_test_fillCircle),
+	TEST(lcd_test_drawRoundRect),
+	TEST(lcd_test_fillRoundRect),
+	TEST(lcd_test_drawArrow),
+	TEST(lcd_test_fillArrow),
+	TEST(lcd_test_drawBitmap),
+	TEST(lcd_test_drawRGBBitmap),
+	TEST(lcd_test_drawRect2),
+	TEST(lcd_test_fillRect2),
+	TEST(lcd_test_drawRoundRect2),
+	TEST(lcd_test_fillRoundRect2),
+	TEST(lcd_test_drawRectC),
+	TEST(lcd_test_drawTriangleC),
+	TEST(lcd_test_drawRegularPolygonC),
+	TEST(lcd_test_drawString),
+	TEST(lcd_test_setFontDirection),
+	TEST(lcd_test_setFontSize),
+	TEST(lcd_test_wrapAround),
+};
+
+#define TEST_COUNT (sizeof(tests)/sizeof(tests[0]))
+
+const lcd_test_t *lcd_test_get(uint32_t index)
+{
+	return (index < TEST_COUNT) ? &tests[index] : NULL;
+}
+
 void lcd_test_all(void *pvParameters)
 {
 	lcd_init();
 	for (;;) {
-		lcd_test_colorBar(); WAIT;
-		lcd_test_colorBand(); WAIT;
-		lcd_test_fillScreen(); WAIT;
-		lcd_test_drawHVLine(); WAIT;
-		lcd_test_drawLine(); WAIT;
-		lcd_test_drawRect(); WAIT;
-		lcd_test_fillRect(); WAIT;
-		lcd_test_drawTriangle(); WAIT;
-		lcd_test_fillTriangle(); WAIT;
-		lcd_test_drawCircle(); WAIT;
-		lcd_test_fillCircle(); WAIT;
-		lcd_test_drawRoundRect(); WAIT;
-		lcd_test_fillRoundRect(); WAIT;
-		lcd_test_drawArrow(); WAIT;
-		lcd_test_fillArrow(); WAIT;
-		lcd_test_drawBitmap(); WAIT;
-		lcd_test_drawRGBBitmap(); WAIT;
-		lcd_test_drawRect2(); WAIT;
-		lcd_test_fillRect2(); WAIT;
-		lcd_test_drawRoundRect2(); WAIT;
-		lcd_test_fillRoundRect2(); WAIT;
-		lcd_test_drawRectC(); WAIT;
-		lcd_test_drawTriangleC(); WAIT;
-		lcd_test_drawRegularPolygonC(); WAIT;
-		lcd_test_drawString(); WAIT;
-		lcd_test_setFontDirection(); WAIT;
-		lcd_test_setFontSize(); WAIT;
-		lcd_test_wrapAround(); WAIT;
+		for (uint32_t i = 0; i < TEST_COUNT; i++) {
+			tests[i].func(); WAIT;
+		}
 		if (lcd_getFrameBuffer() == NULL) lcd_frameEnable();
 		else lcd_frameDisable();
 	}
@@ -7,6 +7,22 @@
 
 #include <stdint.h>
 
+/** @brief A timed test. Returns the elapsed time in microseconds. */
+typedef int64_t (*lcd_test_func_t)(void);
+
+/** @brief Test table entry. */
+typedef struct {
+	const char *name;     /**< Function name. */
+	lcd_test_func_t func; /**< Test function. */
+} lcd_test_t;
+
+/**
+ * @brief Get a test from the table run by lcd_test_all().
+ * @param index Test index, from 0.
+ * @returns Pointer to the test or NULL past the last test.
+ */
+const lcd_test_t *lcd_test_get(uint32_t index);
+
 /**
  * @brief Calls all the tests in a forever loop.
  * @param pvParameters Not used.